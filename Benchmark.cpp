@@ -0,0 +1,132 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+Benchmark::Benchmark()
+{
+}
+
+void Benchmark::Init(int newMeasuredFrames, int newWarmupFrames)
+{
+	measuredFrames = newMeasuredFrames;
+	warmupFrames = newWarmupFrames;
+	framesSeen = 0;
+
+	// Reserve up front so recording a frame never allocates
+	cpuFrameTimes.reserve(measuredFrames);
+	fenceWaitTimes.reserve(measuredFrames);
+	acquireTimes.reserve(measuredFrames);
+	presentTimes.reserve(measuredFrames);
+	frameIntervals.reserve(measuredFrames);
+	recordTimes.reserve(measuredFrames);
+}
+
+void Benchmark::AddFrame(const FrameTimings& timings)
+{
+	framesSeen++;
+
+	// Ignore warm up frames (pipeline creation, first uploads, driver caches, etc)
+	if (framesSeen <= warmupFrames || IsComplete())
+	{
+		return;
+	}
+
+	cpuFrameTimes.push_back(timings.cpuFrameTime);
+	fenceWaitTimes.push_back(timings.fenceWaitTime);
+	acquireTimes.push_back(timings.acquireTime);
+	recordTimes.push_back(timings.recordTime);
+	presentTimes.push_back(timings.presentTime);
+	frameIntervals.push_back(timings.frameInterval);
+}
+
+bool Benchmark::IsComplete()
+{
+	return static_cast<int>(cpuFrameTimes.size()) >= measuredFrames;
+}
+
+std::string Benchmark::ToJson(const VkPhysicalDeviceProperties& deviceProperties)
+{
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"device\": \"" << deviceProperties.deviceName << "\",\n";
+	json << "  \"vendorID\": " << deviceProperties.vendorID << ",\n";
+	json << "  \"deviceID\": " << deviceProperties.deviceID << ",\n";
+	json << "  \"driverVersion\": " << deviceProperties.driverVersion << ",\n";
+	json << "  \"apiVersion\": \"" << VK_VERSION_MAJOR(deviceProperties.apiVersion) << "." << VK_VERSION_MINOR(deviceProperties.apiVersion) << "." << VK_VERSION_PATCH(deviceProperties.apiVersion) << "\",\n";
+	json << "  \"warmupFrames\": " << warmupFrames << ",\n";
+	json << "  \"frames\": " << cpuFrameTimes.size() << ",\n";
+	json << "  \"unit\": \"ms\",\n";
+	json << SummaryToJson("cpuFrameTime", Summarise(cpuFrameTimes)) << ",\n";
+	json << SummaryToJson("fenceWaitTime", Summarise(fenceWaitTimes)) << ",\n";
+	json << SummaryToJson("acquireTime", Summarise(acquireTimes)) << ",\n";
+	json << SummaryToJson("recordTime", Summarise(recordTimes)) << ",\n";
+	json << SummaryToJson("presentTime", Summarise(presentTimes)) << ",\n";
+	json << SummaryToJson("frameInterval", Summarise(frameIntervals)) << ",\n";
+	json << "  \"frameIntervalJitter\": " << StandardDeviation(frameIntervals) << "\n";
+	json << "}\n";
+
+	return json.str();
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+Benchmark::Summary Benchmark::Summarise(std::vector<double> samples)
+{
+	Summary summary;
+	if (samples.empty())
+	{
+		return summary;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	// Nearest-rank percentile of sorted samples
+	auto percentile = [&samples](double p)
+	{
+		size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+		return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+	};
+
+	summary.min = samples.front();
+	summary.avg = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	summary.p50 = percentile(50.0);
+	summary.p95 = percentile(95.0);
+	summary.p99 = percentile(99.0);
+
+	return summary;
+}
+
+double Benchmark::StandardDeviation(const std::vector<double>& samples)
+{
+	if (samples.size() < 2)
+	{
+		return 0.0;
+	}
+
+	double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	double sumSquares = 0.0;
+	for (double sample : samples)
+	{
+		sumSquares += (sample - mean) * (sample - mean);
+	}
+
+	return std::sqrt(sumSquares / (samples.size() - 1));
+}
+
+std::string Benchmark::SummaryToJson(const std::string& name, const Summary& summary)
+{
+	std::ostringstream json;
+	json << "  \"" << name << "\": { "
+		<< "\"min\": " << summary.min << ", "
+		<< "\"avg\": " << summary.avg << ", "
+		<< "\"p50\": " << summary.p50 << ", "
+		<< "\"p95\": " << summary.p95 << ", "
+		<< "\"p99\": " << summary.p99 << " }";
+
+	return json.str();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "Utilities.h"
+
+// Collects per frame timings over a fixed number of frames (after a warm up) and reports them as JSON
+class Benchmark
+{
+public:
+	Benchmark();
+
+	void Init(int newMeasuredFrames, int newWarmupFrames);
+
+	void AddFrame(const FrameTimings& timings);
+	bool IsComplete();
+
+	std::string ToJson(const VkPhysicalDeviceProperties& deviceProperties);
+
+	~Benchmark();
+
+private:
+	// Summary statistics of one metric (milliseconds)
+	struct Summary
+	{
+		double min = 0.0;
+		double avg = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+	};
+
+	int measuredFrames = 0;
+	int warmupFrames = 0;
+	int framesSeen = 0;
+
+	std::vector<double> cpuFrameTimes;
+	std::vector<double> fenceWaitTimes;
+	std::vector<double> acquireTimes;
+	std::vector<double> recordTimes;
+	std::vector<double> presentTimes;
+	std::vector<double> frameIntervals;
+
+	Summary Summarise(std::vector<double> samples);
+	double StandardDeviation(const std::vector<double>& samples);
+	std::string SummaryToJson(const std::string& name, const Summary& summary);
+};
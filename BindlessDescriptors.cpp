@@ -0,0 +1,257 @@
+#include "BindlessDescriptors.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+
+BindlessDescriptors::BindlessDescriptors()
+{
+}
+
+void BindlessDescriptors::Init(VkPhysicalDevice physicalDevice, VkDevice newDevice, uint32_t storageBufferCapacity, uint32_t textureCapacity)
+{
+	device = newDevice;
+
+	// Arrays can't be larger than device lets a stage see of update-after-bind descriptors
+	VkPhysicalDeviceVulkan12Properties vulkan12Properties = {};
+	vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	VkPhysicalDeviceProperties2 deviceProperties2 = {};
+	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProperties2.pNext = &vulkan12Properties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+
+	storageBufferSlots.capacity = std::min(storageBufferCapacity, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+	textureSlots.capacity = std::min(textureCapacity, std::min(vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers));
+
+	// -- SET LAYOUT --
+	// Storage buffers (binding 0) and combined image samplers (binding 1), both visible to every graphics and compute stage
+	std::array<VkDescriptorSetLayoutBinding, 2> layoutBindings = {};
+	layoutBindings[0].binding = BINDLESS_STORAGE_BUFFER_BINDING;
+	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[0].descriptorCount = storageBufferSlots.capacity;
+	layoutBindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	layoutBindings[1].binding = BINDLESS_TEXTURE_BINDING;
+	layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	layoutBindings[1].descriptorCount = textureSlots.capacity;		// Upper bound, actual count is given when set is allocated
+	layoutBindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// PARTIALLY_BOUND				: Unused slots can be left unwritten (or point at destroyed resources)
+	// UPDATE_AFTER_BIND			: Slots can be written after set is bound, up until command buffer is submitted
+	// UPDATE_UNUSED_WHILE_PENDING	: Slots a pending command buffer doesn't use can be written while it executes
+	// VARIABLE_DESCRIPTOR_COUNT	: Size of last binding's array is picked when the set is allocated
+	VkDescriptorBindingFlags commonFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	std::array<VkDescriptorBindingFlags, 2> bindingFlags = { commonFlags, commonFlags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {};
+	bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsCreateInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+	layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+	layoutCreateInfo.pBindings = layoutBindings.data();
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Bindless Descriptor Set Layout!");
+	}
+
+	// -- POOL --
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = storageBufferSlots.capacity;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = textureSlots.capacity;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolCreateInfo.maxSets = 1;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Bindless Descriptor Pool!");
+	}
+
+	// -- SET --
+	VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo = {};
+	variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	variableCountInfo.descriptorSetCount = 1;
+	variableCountInfo.pDescriptorCounts = &textureSlots.capacity;
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.pNext = &variableCountInfo;
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &setLayout;
+
+	result = vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Bindless Descriptor Set!");
+	}
+}
+
+uint32_t BindlessDescriptors::AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	uint32_t index = storageBufferSlots.Allocate();
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	VkWriteDescriptorSet setWrite = {};
+	setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrite.dstSet = descriptorSet;
+	setWrite.dstBinding = BINDLESS_STORAGE_BUFFER_BINDING;
+	setWrite.dstArrayElement = index;							// Slot is the index shaders use
+	setWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	setWrite.descriptorCount = 1;
+	setWrite.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(device, 1, &setWrite, 0, nullptr);
+
+	return index;
+}
+
+uint32_t BindlessDescriptors::AddTexture(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout)
+{
+	uint32_t index = textureSlots.Allocate();
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = imageView;
+	imageInfo.sampler = sampler;
+	imageInfo.imageLayout = imageLayout;
+
+	VkWriteDescriptorSet setWrite = {};
+	setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrite.dstSet = descriptorSet;
+	setWrite.dstBinding = BINDLESS_TEXTURE_BINDING;
+	setWrite.dstArrayElement = index;
+	setWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	setWrite.descriptorCount = 1;
+	setWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(device, 1, &setWrite, 0, nullptr);
+
+	return index;
+}
+
+void BindlessDescriptors::RemoveStorageBuffer(uint32_t index, uint64_t frameNumber)
+{
+	// Slot is left as it is (partially bound), just not handed out again until frames that may use it are done
+	storageBufferSlots.Free(index, frameNumber);
+}
+
+void BindlessDescriptors::RemoveTexture(uint32_t index, uint64_t frameNumber)
+{
+	textureSlots.Free(index, frameNumber);
+}
+
+void BindlessDescriptors::ReleaseFinished(uint64_t frameNumber, bool force)
+{
+	storageBufferSlots.ReleaseFinished(frameNumber, force);
+	textureSlots.ReleaseFinished(frameNumber, force);
+}
+
+VkDescriptorSetLayout BindlessDescriptors::GetSetLayout()
+{
+	return setLayout;
+}
+
+VkDescriptorSet BindlessDescriptors::GetSet()
+{
+	return descriptorSet;
+}
+
+void BindlessDescriptors::Destroy()
+{
+	// Set is freed along with its pool
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+}
+
+BindlessDescriptors::~BindlessDescriptors()
+{
+}
+
+bool BindlessDescriptors::CheckFeatureSupport(const VkPhysicalDeviceFeatures& coreFeatures, const VkPhysicalDeviceVulkan12Features& features)
+{
+	// Shaders index the storage buffer and texture arrays with values that aren't compile time constants
+	return coreFeatures.shaderStorageBufferArrayDynamicIndexing == VK_TRUE
+		&& coreFeatures.shaderSampledImageArrayDynamicIndexing == VK_TRUE
+		&& features.runtimeDescriptorArray == VK_TRUE
+		&& features.descriptorBindingPartiallyBound == VK_TRUE
+		&& features.descriptorBindingVariableDescriptorCount == VK_TRUE
+		&& features.descriptorBindingUpdateUnusedWhilePending == VK_TRUE
+		&& features.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE
+		&& features.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE
+		&& features.shaderSampledImageArrayNonUniformIndexing == VK_TRUE;
+}
+
+void BindlessDescriptors::EnableFeatures(VkPhysicalDeviceFeatures* coreFeatures, VkPhysicalDeviceVulkan12Features* features)
+{
+	// Only the individual features checked above are enabled (descriptorIndexing would also demand ones the set doesn't use)
+	coreFeatures->shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+	coreFeatures->shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+	features->runtimeDescriptorArray = VK_TRUE;
+	features->descriptorBindingPartiallyBound = VK_TRUE;
+	features->descriptorBindingVariableDescriptorCount = VK_TRUE;
+	features->descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	features->descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	features->descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	features->shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+}
+
+uint32_t BindlessDescriptors::SlotAllocator::Allocate()
+{
+	// Reuse a released slot first, so indices stay small
+	if (!freeSlots.empty())
+	{
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	if (nextSlot >= capacity)
+	{
+		throw std::runtime_error("Failed to allocate a Bindless Descriptor, array is full!");
+	}
+
+	return nextSlot++;
+}
+
+void BindlessDescriptors::SlotAllocator::Free(uint32_t slot, uint64_t frameNumber)
+{
+	pendingFrees.push_back({ slot, frameNumber });
+}
+
+void BindlessDescriptors::SlotAllocator::ReleaseFinished(uint64_t frameNumber, bool force)
+{
+	// A slot freed on frame N may be used by frames up to N - 1, and those are all done
+	// once the fence of frame N - 1 + MAX_FRAME_DRAWS has been waited on
+	for (size_t i = 0; i < pendingFrees.size();)
+	{
+		if (force || frameNumber >= pendingFrees[i].frameNumber + MAX_FRAME_DRAWS)
+		{
+			freeSlots.push_back(pendingFrees[i].slot);
+			pendingFrees.erase(pendingFrees.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "Utilities.h"
+
+const uint32_t BINDLESS_STORAGE_BUFFER_BINDING = 0;
+const uint32_t BINDLESS_TEXTURE_BINDING = 1;			// Last binding, so its array can have a variable count
+const uint32_t MAX_BINDLESS_STORAGE_BUFFERS = 1024;
+const uint32_t MAX_BINDLESS_TEXTURES = 16384;			// Clamped to what device allows
+
+// One global descriptor set holding large arrays of storage buffers and sampled textures (descriptor indexing, Vulkan 1.2)
+// Shaders reach resources by index, so draws never bind per draw descriptor sets
+// Sets are update-after-bind and partially bound: slots are written while recorded command buffers still use the set,
+// and slots nothing points at never have to be valid
+class BindlessDescriptors
+{
+public:
+	BindlessDescriptors();
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice newDevice,
+		uint32_t storageBufferCapacity = MAX_BINDLESS_STORAGE_BUFFERS, uint32_t textureCapacity = MAX_BINDLESS_TEXTURES);
+
+	uint32_t AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	uint32_t AddTexture(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void RemoveStorageBuffer(uint32_t index, uint64_t frameNumber);
+	void RemoveTexture(uint32_t index, uint64_t frameNumber);
+	void ReleaseFinished(uint64_t frameNumber, bool force);
+
+	VkDescriptorSetLayout GetSetLayout();
+	VkDescriptorSet GetSet();
+
+	void Destroy();
+
+	~BindlessDescriptors();
+
+	// Checks every descriptor indexing feature the set needs (features of device are already queried)
+	// Dynamic indexing of the arrays is a core feature, the rest are Vulkan 1.2 ones
+	static bool CheckFeatureSupport(const VkPhysicalDeviceFeatures& coreFeatures, const VkPhysicalDeviceVulkan12Features& features);
+	static void EnableFeatures(VkPhysicalDeviceFeatures* coreFeatures, VkPhysicalDeviceVulkan12Features* features);
+
+private:
+	// Hands out array indices, holding freed ones back until no frame in flight can still read them
+	struct SlotAllocator
+	{
+		uint32_t capacity = 0;
+		uint32_t nextSlot = 0;						// Slots at and past this have never been used
+		std::vector<uint32_t> freeSlots;
+
+		struct PendingFree
+		{
+			uint32_t slot;
+			uint64_t frameNumber;					// Frame slot was removed on
+		};
+		std::vector<PendingFree> pendingFrees;
+
+		uint32_t Allocate();
+		void Free(uint32_t slot, uint64_t frameNumber);
+		void ReleaseFinished(uint64_t frameNumber, bool force);
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+	SlotAllocator storageBufferSlots;
+	SlotAllocator textureSlots;
+};
@@ -0,0 +1,483 @@
+#include "DeviceAllocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+
+#include "Utilities.h"
+
+const char* GetMemoryTagName(MemoryTag tag)
+{
+	switch (tag)
+	{
+	case MEMORY_TAG_MESH_VERTEX:
+		return "mesh vertex";
+	case MEMORY_TAG_MESH_INDEX:
+		return "mesh index";
+	case MEMORY_TAG_STAGING:
+		return "staging";
+	case MEMORY_TAG_SWAPCHAIN:
+		return "swapchain";
+	case MEMORY_TAG_UNIFORM:
+		return "uniform";
+	case MEMORY_TAG_DRAW_DATA:
+		return "draw data";
+	case MEMORY_TAG_TEXTURE:
+		return "texture";
+	case MEMORY_TAG_OTHER:
+	default:
+		return "other";
+	}
+}
+
+RangeAllocator::RangeAllocator()
+{
+}
+
+RangeAllocator::RangeAllocator(VkDeviceSize newCapacity)
+{
+	capacity = newCapacity;
+	freeSize = newCapacity;
+
+	// Whole range starts off free
+	freeRanges.push_back({ 0, newCapacity });
+}
+
+bool RangeAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+	if (alignment == 0)
+	{
+		alignment = 1;
+	}
+
+	// First fit: find first free range that can hold the size after aligning its start
+	for (size_t i = 0; i < freeRanges.size(); i++)
+	{
+		FreeRange range = freeRanges[i];
+		VkDeviceSize alignedOffset = (range.offset + alignment - 1) / alignment * alignment;
+		VkDeviceSize padding = alignedOffset - range.offset;
+
+		if (range.size < padding + size)
+		{
+			continue;
+		}
+
+		// Remove the range, then give back what is left either side of the allocation
+		freeRanges.erase(freeRanges.begin() + i);
+
+		VkDeviceSize remainder = range.size - padding - size;
+		if (remainder > 0)
+		{
+			freeRanges.insert(freeRanges.begin() + i, { alignedOffset + size, remainder });
+		}
+		if (padding > 0)
+		{
+			freeRanges.insert(freeRanges.begin() + i, { range.offset, padding });
+		}
+
+		freeSize -= size;
+		*offset = alignedOffset;
+		return true;
+	}
+
+	return false;
+}
+
+void RangeAllocator::Free(VkDeviceSize offset, VkDeviceSize size)
+{
+	// Find where range belongs to keep list sorted by offset
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset,
+		[](const FreeRange& range, VkDeviceSize value) { return range.offset < value; });
+	auto current = freeRanges.insert(next, { offset, size });
+	freeSize += size;
+
+	// Merge with following range if they touch
+	auto following = current + 1;
+	if (following != freeRanges.end() && current->offset + current->size == following->offset)
+	{
+		current->size += following->size;
+		current = freeRanges.erase(following) - 1;
+	}
+
+	// Merge with previous range if they touch
+	if (current != freeRanges.begin())
+	{
+		auto previous = current - 1;
+		if (previous->offset + previous->size == current->offset)
+		{
+			previous->size += current->size;
+			freeRanges.erase(current);
+		}
+	}
+}
+
+VkDeviceSize RangeAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+VkDeviceSize RangeAllocator::GetFreeSize()
+{
+	return freeSize;
+}
+
+VkDeviceSize RangeAllocator::GetLargestFreeRange()
+{
+	VkDeviceSize largest = 0;
+	for (const auto& range : freeRanges)
+	{
+		largest = std::max(largest, range.size);
+	}
+	return largest;
+}
+
+bool RangeAllocator::IsEmpty()
+{
+	return freeSize == capacity;
+}
+
+RangeAllocator::~RangeAllocator()
+{
+}
+
+DeviceAllocator::DeviceAllocator()
+{
+}
+
+void DeviceAllocator::Init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, bool newMemoryBudgetSupported, VkDeviceSize newBlockSize)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	memoryBudgetSupported = newMemoryBudgetSupported;
+	blockSize = newBlockSize;
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	heapAllocations.assign(memoryProperties.memoryHeapCount, MemoryUsage());
+	heapBlocks.assign(memoryProperties.memoryHeapCount, MemoryUsage());
+	typeAllocations.assign(memoryProperties.memoryTypeCount, MemoryUsage());
+	typeBlockBytes.assign(memoryProperties.memoryTypeCount, 0);
+
+	// One linear and one non-linear pool for every memory type
+	pools.resize(memoryProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		pools[GetPoolIndex(i, true)].memoryTypeIndex = i;
+		pools[GetPoolIndex(i, true)].linear = true;
+		pools[GetPoolIndex(i, false)].memoryTypeIndex = i;
+		pools[GetPoolIndex(i, false)].linear = false;
+	}
+}
+
+Allocation DeviceAllocator::Allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, MemoryTag tag, bool linearResource)
+{
+	uint32_t memoryTypeIndex = FindMemoryTypeIndex(physicalDevice, memRequirements.memoryTypeBits, properties);
+	uint32_t poolIndex = GetPoolIndex(memoryTypeIndex, linearResource);
+	MemoryPool& pool = pools[poolIndex];
+
+	Allocation allocation = {};
+	allocation.poolIndex = poolIndex;
+	allocation.tag = tag;
+
+	// Try to fit allocation in an existing block
+	bool allocated = false;
+	for (uint32_t i = 0; i < pool.blocks.size() && !allocated; i++)
+	{
+		allocated = pool.blocks[i].memory != VK_NULL_HANDLE && AllocateFromBlock(pool, i, memRequirements, &allocation);
+	}
+
+	// No room, so create a new block (large resources get a block of their own size)
+	if (!allocated)
+	{
+		uint32_t blockIndex = CreateBlock(pool, memRequirements.size);
+		if (!AllocateFromBlock(pool, blockIndex, memRequirements, &allocation))
+		{
+			throw std::runtime_error("Failed to sub-allocate from a new Memory Block!");
+		}
+	}
+
+	// Count allocation against its heap, memory type and tag
+	AddUsage(heapAllocations[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex], allocation.size);
+	AddUsage(typeAllocations[memoryTypeIndex], allocation.size);
+	AddUsage(tagAllocations[tag], allocation.size);
+	AddUsage(totalAllocations, allocation.size);
+
+	return allocation;
+}
+
+void DeviceAllocator::Free(Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	MemoryPool& pool = pools[allocation.poolIndex];
+	MemoryBlock& block = pool.blocks[allocation.blockIndex];
+	block.ranges.Free(allocation.offset, allocation.size);
+
+	RemoveUsage(heapAllocations[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex], allocation.size);
+	RemoveUsage(typeAllocations[pool.memoryTypeIndex], allocation.size);
+	RemoveUsage(tagAllocations[allocation.tag], allocation.size);
+	RemoveUsage(totalAllocations, allocation.size);
+
+	// Release block back to driver once it's empty, but keep at least one block per pool to avoid thrashing
+	if (block.ranges.IsEmpty())
+	{
+		size_t liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+			[](const MemoryBlock& b) { return b.memory != VK_NULL_HANDLE; });
+
+		if (liveBlocks > 1)
+		{
+			FreeBlock(pool, block);
+		}
+	}
+
+	allocation = Allocation();
+}
+
+MemoryStatistics DeviceAllocator::GetStatistics()
+{
+	MemoryStatistics statistics;
+
+	statistics.heaps.resize(memoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		statistics.heaps[i].size = memoryProperties.memoryHeaps[i].size;
+		statistics.heaps[i].flags = memoryProperties.memoryHeaps[i].flags;
+		statistics.heaps[i].allocations = heapAllocations[i];
+		statistics.heaps[i].blocks = heapBlocks[i];
+	}
+
+	statistics.types.resize(memoryProperties.memoryTypeCount);
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		statistics.types[i].heapIndex = memoryProperties.memoryTypes[i].heapIndex;
+		statistics.types[i].propertyFlags = memoryProperties.memoryTypes[i].propertyFlags;
+		statistics.types[i].allocations = typeAllocations[i];
+		statistics.types[i].blockBytes = typeBlockBytes[i];
+	}
+
+	for (uint32_t i = 0; i < MEMORY_TAG_COUNT; i++)
+	{
+		statistics.tags[i] = tagAllocations[i];
+	}
+	statistics.total = totalAllocations;
+
+	// Free space left inside each heap's blocks, and how much of it a single allocation could use
+	for (auto& pool : pools)
+	{
+		MemoryHeapStatistics& heap = statistics.heaps[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex];
+		for (auto& block : pool.blocks)
+		{
+			if (block.memory == VK_NULL_HANDLE)
+			{
+				continue;
+			}
+
+			heap.freeBytes += block.ranges.GetFreeSize();
+			heap.largestFreeRange = std::max(heap.largestFreeRange, block.ranges.GetLargestFreeRange());
+		}
+	}
+
+	for (auto& heap : statistics.heaps)
+	{
+		if (heap.freeBytes > 0)
+		{
+			heap.fragmentation = 1.0f - static_cast<float>(heap.largestFreeRange) / static_cast<float>(heap.freeBytes);
+		}
+	}
+
+	// What driver says process is using and may use, which includes memory allocated outside allocator (e.g. swapchain images)
+	if (memoryBudgetSupported)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			statistics.heaps[i].budgetSupported = true;
+			statistics.heaps[i].budget = budgetProperties.heapBudget[i];
+			statistics.heaps[i].usage = budgetProperties.heapUsage[i];
+		}
+	}
+
+	return statistics;
+}
+
+void DeviceAllocator::LogStatistics()
+{
+	const double MiB = 1024.0 * 1024.0;
+	MemoryStatistics statistics = GetStatistics();
+
+	printf("Device memory: %.2f MiB live (peak %.2f MiB) in %u allocations\n",
+		statistics.total.liveBytes / MiB, statistics.total.peakBytes / MiB, statistics.total.allocationCount);
+
+	for (size_t i = 0; i < statistics.heaps.size(); i++)
+	{
+		const MemoryHeapStatistics& heap = statistics.heaps[i];
+		if (heap.blocks.totalAllocations == 0 && !heap.budgetSupported)
+		{
+			continue;
+		}
+
+		printf("  Heap %zu (%s, %.0f MiB): %.2f MiB live (peak %.2f MiB), %u blocks %.2f MiB (peak %.2f MiB), %.2f MiB free, fragmentation %.1f%%\n",
+			i, (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device local" : "host", heap.size / MiB,
+			heap.allocations.liveBytes / MiB, heap.allocations.peakBytes / MiB,
+			heap.blocks.allocationCount, heap.blocks.liveBytes / MiB, heap.blocks.peakBytes / MiB,
+			heap.freeBytes / MiB, heap.fragmentation * 100.0f);
+
+		// Compare against what driver allows, usage also counts memory of other allocators in process
+		if (heap.budgetSupported)
+		{
+			printf("    Budget %.2f MiB, process usage %.2f MiB (%.1f%%)%s\n",
+				heap.budget / MiB, heap.usage / MiB, heap.budget > 0 ? 100.0 * heap.usage / heap.budget : 0.0,
+				heap.usage > heap.budget ? " OVER BUDGET" : "");
+		}
+	}
+
+	for (size_t i = 0; i < statistics.types.size(); i++)
+	{
+		const MemoryTypeStatistics& type = statistics.types[i];
+		if (type.allocations.totalAllocations == 0)
+		{
+			continue;
+		}
+
+		printf("  Type %zu (heap %u, flags 0x%x): %.2f MiB live (peak %.2f MiB) in %u allocations, %.2f MiB of blocks\n",
+			i, type.heapIndex, type.propertyFlags, type.allocations.liveBytes / MiB, type.allocations.peakBytes / MiB,
+			type.allocations.allocationCount, type.blockBytes / MiB);
+	}
+
+	for (uint32_t i = 0; i < MEMORY_TAG_COUNT; i++)
+	{
+		const MemoryUsage& tag = statistics.tags[i];
+		if (tag.totalAllocations == 0)
+		{
+			continue;
+		}
+
+		printf("  %-12s %10.2f MiB live (peak %.2f MiB) in %u allocations\n",
+			GetMemoryTagName(static_cast<MemoryTag>(i)), tag.liveBytes / MiB, tag.peakBytes / MiB, tag.allocationCount);
+	}
+}
+
+void DeviceAllocator::Destroy()
+{
+	for (auto& pool : pools)
+	{
+		for (auto& block : pool.blocks)
+		{
+			if (block.memory != VK_NULL_HANDLE)
+			{
+				FreeBlock(pool, block);
+			}
+		}
+		pool.blocks.clear();
+	}
+}
+
+DeviceAllocator::~DeviceAllocator()
+{
+}
+
+uint32_t DeviceAllocator::GetPoolIndex(uint32_t memoryTypeIndex, bool linearResource)
+{
+	return memoryTypeIndex * 2 + (linearResource ? 0 : 1);
+}
+
+bool DeviceAllocator::AllocateFromBlock(MemoryPool& pool, uint32_t blockIndex, const VkMemoryRequirements& memRequirements, Allocation* allocation)
+{
+	MemoryBlock& block = pool.blocks[blockIndex];
+
+	VkDeviceSize offset;
+	if (!block.ranges.Allocate(memRequirements.size, memRequirements.alignment, &offset))
+	{
+		return false;
+	}
+
+	allocation->memory = block.memory;
+	allocation->offset = offset;
+	allocation->size = memRequirements.size;
+	allocation->blockIndex = blockIndex;
+	allocation->mappedData = block.mappedData != nullptr ? static_cast<char*>(block.mappedData) + offset : nullptr;
+
+	return true;
+}
+
+uint32_t DeviceAllocator::CreateBlock(MemoryPool& pool, VkDeviceSize requestSize)
+{
+	// Don't let one block take more than an eighth of a small heap (e.g. 256 MiB device local + host visible heaps)
+	// Block is never smaller than the request though, so it can always hold the allocation it was created for
+	VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex].size;
+	VkDeviceSize size = std::max(std::min(blockSize, heapSize / 8), requestSize);
+
+	VkMemoryAllocateInfo memoryAllocInfo = {};
+	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocInfo.allocationSize = size;
+	memoryAllocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+	MemoryBlock block;
+	VkResult result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, &block.memory);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate a Memory Block!");
+	}
+
+	// Host visible blocks stay mapped for their whole lifetime, so allocations can be written without map/unmap
+	if (memoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		result = vkMapMemory(device, block.memory, 0, size, 0, &block.mappedData);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to map a Memory Block!");
+		}
+	}
+
+	block.ranges = RangeAllocator(size);
+
+	AddUsage(heapBlocks[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex], size);
+	typeBlockBytes[pool.memoryTypeIndex] += size;
+
+	// Reuse slot of a previously released block so existing block indices stay valid
+	for (uint32_t i = 0; i < pool.blocks.size(); i++)
+	{
+		if (pool.blocks[i].memory == VK_NULL_HANDLE)
+		{
+			pool.blocks[i] = block;
+			return i;
+		}
+	}
+
+	pool.blocks.push_back(block);
+	return static_cast<uint32_t>(pool.blocks.size() - 1);
+}
+
+void DeviceAllocator::FreeBlock(MemoryPool& pool, MemoryBlock& block)
+{
+	VkDeviceSize size = block.ranges.GetCapacity();
+	RemoveUsage(heapBlocks[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex], size);
+	typeBlockBytes[pool.memoryTypeIndex] -= size;
+
+	vkFreeMemory(device, block.memory, nullptr);
+	block = MemoryBlock();
+}
+
+void DeviceAllocator::AddUsage(MemoryUsage& usage, VkDeviceSize size)
+{
+	usage.liveBytes += size;
+	usage.peakBytes = std::max(usage.peakBytes, usage.liveBytes);
+	usage.allocationCount++;
+	usage.totalAllocations++;
+}
+
+void DeviceAllocator::RemoveUsage(MemoryUsage& usage, VkDeviceSize size)
+{
+	usage.liveBytes -= size;
+	usage.allocationCount--;
+}
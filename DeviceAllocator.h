@@ -0,0 +1,172 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+const VkDeviceSize DEFAULT_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;	// Size of each VkDeviceMemory block allocations are carved from (64 MiB)
+
+// What an allocation is used for, so memory statistics can be broken down by it
+enum MemoryTag
+{
+	MEMORY_TAG_OTHER = 0,
+	MEMORY_TAG_MESH_VERTEX = 1,		// Geometry pool vertex buffer
+	MEMORY_TAG_MESH_INDEX = 2,		// Geometry pool index buffer
+	MEMORY_TAG_STAGING = 3,			// Host visible copy sources and readback targets
+	MEMORY_TAG_SWAPCHAIN = 4,		// Images sized to the swapchain (depth buffers, offscreen colour images)
+	MEMORY_TAG_UNIFORM = 5,			// Per frame uniform buffers
+	MEMORY_TAG_DRAW_DATA = 6,		// Per frame instance, indirect draw, culling and material buffers
+	MEMORY_TAG_TEXTURE = 7,			// Streamed texture images
+	MEMORY_TAG_COUNT = 8
+};
+
+const char* GetMemoryTagName(MemoryTag tag);
+
+// Live and peak memory of one heap, memory type or tag (bytes)
+struct MemoryUsage
+{
+	VkDeviceSize liveBytes = 0;
+	VkDeviceSize peakBytes = 0;
+	uint32_t allocationCount = 0;			// Live allocations
+	uint64_t totalAllocations = 0;			// Allocations made since start
+};
+
+// Memory of one heap, as seen by the allocator and (if VK_EXT_memory_budget is enabled) by the driver
+struct MemoryHeapStatistics
+{
+	VkDeviceSize size = 0;					// Heap size reported by device
+	VkMemoryHeapFlags flags = 0;
+	MemoryUsage allocations;				// Sub-allocations handed out from heap's blocks
+	MemoryUsage blocks;						// VkDeviceMemory blocks allocated from driver
+	VkDeviceSize freeBytes = 0;				// Unused space inside blocks
+	VkDeviceSize largestFreeRange = 0;		// Biggest allocation that fits without a new block
+	float fragmentation = 0.0f;				// 0 = free space is one range, towards 1 = free space is split in small ranges
+	bool budgetSupported = false;
+	VkDeviceSize budget = 0;				// Memory driver estimates process can use (VK_EXT_memory_budget)
+	VkDeviceSize usage = 0;					// Memory process uses, including what isn't allocated through allocator (VK_EXT_memory_budget)
+};
+
+// Memory of one memory type
+struct MemoryTypeStatistics
+{
+	uint32_t heapIndex = 0;
+	VkMemoryPropertyFlags propertyFlags = 0;
+	MemoryUsage allocations;
+	VkDeviceSize blockBytes = 0;
+};
+
+struct MemoryStatistics
+{
+	std::vector<MemoryHeapStatistics> heaps;
+	std::vector<MemoryTypeStatistics> types;
+	MemoryUsage tags[MEMORY_TAG_COUNT];
+	MemoryUsage total;
+};
+
+// Region of a memory block handed out by the DeviceAllocator
+struct Allocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;		// Block memory the allocation lives in
+	VkDeviceSize offset = 0;					// Offset of allocation inside block memory
+	VkDeviceSize size = 0;						// Size of allocation as requested (alignment padding goes back to the free list)
+	void* mappedData = nullptr;					// Host pointer to start of allocation (only if memory is HOST_VISIBLE)
+	uint32_t poolIndex = 0;						// Pool (memory type + resource kind) the block belongs to
+	uint32_t blockIndex = 0;					// Block inside the pool
+	MemoryTag tag = MEMORY_TAG_OTHER;			// What allocation is used for (statistics only)
+};
+
+// Free-list management of a linear range of memory
+// Free ranges are kept sorted by offset, allocated first-fit, and merged with their neighbours when freed
+class RangeAllocator
+{
+public:
+	RangeAllocator();
+	RangeAllocator(VkDeviceSize newCapacity);
+
+	bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+	void Free(VkDeviceSize offset, VkDeviceSize size);
+
+	VkDeviceSize GetCapacity();
+	VkDeviceSize GetFreeSize();
+	VkDeviceSize GetLargestFreeRange();
+	bool IsEmpty();
+
+	~RangeAllocator();
+
+private:
+	struct FreeRange
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	VkDeviceSize capacity = 0;
+	VkDeviceSize freeSize = 0;
+	std::vector<FreeRange> freeRanges;
+};
+
+// Sub-allocates buffers and images from large per memory type VkDeviceMemory blocks
+// so resources don't each need their own vkAllocateMemory call
+// Every allocation is tagged, and live/peak bytes are tracked per heap, memory type and tag as allocations come and go
+class DeviceAllocator
+{
+public:
+	DeviceAllocator();
+
+	void Init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, bool newMemoryBudgetSupported = false,
+		VkDeviceSize newBlockSize = DEFAULT_MEMORY_BLOCK_SIZE);
+
+	Allocation Allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, MemoryTag tag, bool linearResource = true);
+	void Free(Allocation& allocation);
+
+	// - Statistics
+	MemoryStatistics GetStatistics();
+	void LogStatistics();
+
+	void Destroy();
+
+	~DeviceAllocator();
+
+private:
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mappedData = nullptr;				// Persistent mapping of whole block (HOST_VISIBLE memory only)
+		RangeAllocator ranges;
+	};
+
+	// Linear (buffers, linear images) and non-linear (optimal images) resources get separate pools,
+	// so the two never sit next to each other in a block and bufferImageGranularity can't be violated
+	struct MemoryPool
+	{
+		uint32_t memoryTypeIndex;
+		bool linear;
+		std::vector<MemoryBlock> blocks;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+
+	VkDeviceSize blockSize = DEFAULT_MEMORY_BLOCK_SIZE;
+	VkPhysicalDeviceMemoryProperties memoryProperties = {};
+	bool memoryBudgetSupported = false;			// VK_EXT_memory_budget enabled on device
+
+	std::vector<MemoryPool> pools;
+
+	// - Statistics
+	std::vector<MemoryUsage> heapAllocations;	// Per heap
+	std::vector<MemoryUsage> heapBlocks;		// Per heap
+	std::vector<MemoryUsage> typeAllocations;	// Per memory type
+	std::vector<VkDeviceSize> typeBlockBytes;	// Per memory type
+	MemoryUsage tagAllocations[MEMORY_TAG_COUNT];
+	MemoryUsage totalAllocations;
+
+	uint32_t GetPoolIndex(uint32_t memoryTypeIndex, bool linearResource);
+	bool AllocateFromBlock(MemoryPool& pool, uint32_t blockIndex, const VkMemoryRequirements& memRequirements, Allocation* allocation);
+	uint32_t CreateBlock(MemoryPool& pool, VkDeviceSize requestSize);
+	void FreeBlock(MemoryPool& pool, MemoryBlock& block);
+
+	static void AddUsage(MemoryUsage& usage, VkDeviceSize size);
+	static void RemoveUsage(MemoryUsage& usage, VkDeviceSize size);
+};
@@ -0,0 +1,129 @@
+#include "FrameLimiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "Utilities.h"
+
+FrameLimiter::FrameLimiter()
+{
+}
+
+void FrameLimiter::SetTargetFrameTime(double milliseconds)
+{
+	targetFrameTime = std::max(milliseconds, 0.0);
+	started = false;
+	ResetStatistics();
+}
+
+double FrameLimiter::GetTargetFrameTime()
+{
+	return targetFrameTime;
+}
+
+double FrameLimiter::Wait()
+{
+	auto waitStart = std::chrono::steady_clock::now();
+
+	if (targetFrameTime > 0.0)
+	{
+		auto frameDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(targetFrameTime));
+		if (!started)
+		{
+			nextDeadline = waitStart;
+		}
+
+		SleepUntil(nextDeadline);
+
+		// Deadlines advance by exactly one frame, so a late wake up is made up for by the next frame
+		// A frame that ran over by more than a whole frame restarts the schedule, rather than rushing to catch up
+		nextDeadline += frameDuration;
+		auto now = std::chrono::steady_clock::now();
+		if (nextDeadline < now)
+		{
+			nextDeadline = now + frameDuration;
+		}
+	}
+
+	auto frameStart = std::chrono::steady_clock::now();
+	if (started)
+	{
+		lastFrameInterval = ElapsedMilliseconds(lastFrameStart, frameStart);
+		AddInterval(lastFrameInterval);
+	}
+	lastFrameStart = frameStart;
+	started = true;
+
+	return ElapsedMilliseconds(waitStart, frameStart);
+}
+
+double FrameLimiter::GetLastFrameInterval()
+{
+	return lastFrameInterval;
+}
+
+FramePacingStatistics FrameLimiter::GetStatistics()
+{
+	FramePacingStatistics statistics;
+	statistics.frameCount = intervalSamples;
+	statistics.targetFrameTime = targetFrameTime;
+	statistics.meanFrameInterval = intervalMean;
+	statistics.jitter = intervalSamples > 1 ? std::sqrt(intervalM2 / (intervalSamples - 1)) : 0.0;
+	statistics.worstDeviation = intervalWorstDeviation;
+
+	return statistics;
+}
+
+void FrameLimiter::ResetStatistics()
+{
+	intervalSamples = 0;
+	intervalMean = 0.0;
+	intervalM2 = 0.0;
+	intervalWorstDeviation = 0.0;
+}
+
+FrameLimiter::~FrameLimiter()
+{
+}
+
+void FrameLimiter::SleepUntil(std::chrono::steady_clock::time_point deadline)
+{
+	// Sleep in 1 ms steps while more time is left than a sleep could overshoot by
+	while (true)
+	{
+		auto now = std::chrono::steady_clock::now();
+		double remaining = ElapsedMilliseconds(now, deadline);
+		double sleepEstimate = sleepMean + (sleepSamples > 1 ? std::sqrt(sleepM2 / (sleepSamples - 1)) : 0.0);
+		if (remaining <= sleepEstimate + LIMITER_SPIN_SLEEP_MARGIN)
+		{
+			break;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		// Update estimate of real sleep length
+		double slept = ElapsedMilliseconds(now, std::chrono::steady_clock::now());
+		sleepSamples++;
+		double delta = slept - sleepMean;
+		sleepMean += delta / sleepSamples;
+		sleepM2 += delta * (slept - sleepMean);
+	}
+
+	// Spin the rest of the way (sleeping any more could wake up too late)
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void FrameLimiter::AddInterval(double interval)
+{
+	intervalSamples++;
+	double delta = interval - intervalMean;
+	intervalMean += delta / intervalSamples;
+	intervalM2 += delta * (interval - intervalMean);
+
+	double reference = targetFrameTime > 0.0 ? targetFrameTime : intervalMean;
+	intervalWorstDeviation = std::max(intervalWorstDeviation, std::abs(interval - reference));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+const double LIMITER_SPIN_SLEEP_MARGIN = 0.25;	// Extra ms left for spinning beyond the expected sleep overshoot
+const double LIMITER_INITIAL_SLEEP_ESTIMATE = 2.0;	// Assumed cost (ms) of a 1 ms sleep until real ones have been measured
+
+// Summary of how evenly frames were delivered (milliseconds)
+struct FramePacingStatistics
+{
+	uint64_t frameCount = 0;
+	double targetFrameTime = 0.0;		// 0 when limiter is off
+	double meanFrameInterval = 0.0;
+	double jitter = 0.0;				// Standard deviation of frame intervals
+	double worstDeviation = 0.0;		// Largest distance of an interval from the target (or from the mean when unlimited)
+};
+
+// Holds frames to a target frame time: sleeps while there is plenty of time left, then spins to the deadline
+// Sleep overshoot is measured as it goes, so the spin is only as long as the OS scheduler actually needs
+class FrameLimiter
+{
+public:
+	FrameLimiter();
+
+	void SetTargetFrameTime(double milliseconds);
+	double GetTargetFrameTime();
+
+	double Wait();
+	double GetLastFrameInterval();
+
+	FramePacingStatistics GetStatistics();
+	void ResetStatistics();
+
+	~FrameLimiter();
+
+private:
+	double targetFrameTime = 0.0;		// 0 = unlimited
+	bool started = false;
+	std::chrono::steady_clock::time_point nextDeadline;
+	std::chrono::steady_clock::time_point lastFrameStart;
+	double lastFrameInterval = 0.0;
+
+	// Running mean and variance of how long a 1 ms sleep really takes (Welford)
+	uint64_t sleepSamples = 0;
+	double sleepMean = LIMITER_INITIAL_SLEEP_ESTIMATE;
+	double sleepM2 = 0.0;
+
+	// Running statistics of frame intervals
+	uint64_t intervalSamples = 0;
+	double intervalMean = 0.0;
+	double intervalM2 = 0.0;
+	double intervalWorstDeviation = 0.0;
+
+	void SleepUntil(std::chrono::steady_clock::time_point deadline);
+	void AddInterval(double interval);
+};
@@ -0,0 +1,144 @@
+#include "GeometryPool.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+GeometryPool::GeometryPool()
+{
+}
+
+void GeometryPool::Init(VkDevice newDevice, DeviceAllocator* newAllocator, UploadManager* newUploadManager, const VertexLayoutInfo& newVertexLayout,
+	uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+	device = newDevice;
+	allocator = newAllocator;
+	uploadManager = newUploadManager;
+	vertexLayout = newVertexLayout;
+
+	// Both buffers live in device local memory and are only ever written by upload copies
+	// They are copied into over and over, so they're shared with the upload family rather than handed back and forth
+	const std::vector<uint32_t>& sharedFamilies = uploadManager->GetSharedFamilies();
+	uint32_t sharedFamilyCount = static_cast<uint32_t>(sharedFamilies.size());
+
+	CreateBuffer(device, allocator, vertexLayout.stride * static_cast<VkDeviceSize>(vertexCapacity),
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer, &vertexBufferAllocation, MEMORY_TAG_MESH_VERTEX,
+		sharedFamilyCount, sharedFamilies.data());
+
+	CreateBuffer(device, allocator, sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCapacity),
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indexBuffer, &indexBufferAllocation, MEMORY_TAG_MESH_INDEX,
+		sharedFamilyCount, sharedFamilies.data());
+
+	// Vertex ranges are counted in vertices, so offsets can be passed straight to vkCmdDrawIndexed
+	// Index ranges are counted in 32 bit slots, converted to first index of the range's index type when allocated
+	vertexRanges = RangeAllocator(vertexCapacity);
+	indexRanges = RangeAllocator(indexCapacity);
+}
+
+GeometryRange GeometryPool::Add(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+	const VertexQuantization& quantization, bool compactIndices)
+{
+	GeometryRange range;
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+	range.indexType = compactIndices && vertexCount <= MAX_16BIT_INDEXED_VERTICES ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	VkDeviceSize vertexOffset;
+	if (!vertexRanges.Allocate(range.vertexCount, 1, &vertexOffset))
+	{
+		throw std::runtime_error("Failed to find space in Geometry Pool Vertex Buffer!");
+	}
+
+	// 16 bit indices are packed two to a slot, so their first index is always at an even position
+	VkDeviceSize indexUnitOffset;
+	if (!indexRanges.Allocate(GetIndexUnits(range), 1, &indexUnitOffset))
+	{
+		vertexRanges.Free(vertexOffset, range.vertexCount);
+		throw std::runtime_error("Failed to find space in Geometry Pool Index Buffer!");
+	}
+
+	range.vertexOffset = static_cast<uint32_t>(vertexOffset);
+	range.firstIndex = static_cast<uint32_t>(range.indexType == VK_INDEX_TYPE_UINT16 ? indexUnitOffset * 2 : indexUnitOffset);
+
+	// Vertices are encoded in chunks straight from caller's memory (e.g. a mapped file) into staging, so it needn't outlive this call
+	uint32_t chunkVertices = std::max(1u, static_cast<uint32_t>(uploadManager->GetMaxChunkSize() / vertexLayout.stride));
+	for (uint32_t first = 0; first < vertexCount; first += chunkVertices)
+	{
+		uint32_t count = std::min(chunkVertices, vertexCount - first);
+		VkDeviceSize chunkSize = vertexLayout.stride * static_cast<VkDeviceSize>(count);
+
+		VkDeviceSize stagingOffset;
+		void* staging = uploadManager->ReserveStaging(chunkSize, &stagingOffset);
+		vertexLayout.encode(vertices + first, count, quantization, staging);
+		uploadManager->CopyToBuffer(stagingOffset, vertexBuffer, vertexLayout.stride * (vertexOffset + first), chunkSize);
+	}
+
+	// Indices stay relative to the mesh's own vertices, vertexOffset is added when drawing
+	StageIndices(indices, indexCount, range.indexType, indexUnitOffset);
+
+	return range;
+}
+
+void GeometryPool::Remove(const GeometryRange& range)
+{
+	// Caller must make sure no frame in flight still draws from the range
+	vertexRanges.Free(range.vertexOffset, range.vertexCount);
+	indexRanges.Free(range.indexType == VK_INDEX_TYPE_UINT16 ? range.firstIndex / 2 : range.firstIndex, GetIndexUnits(range));
+}
+
+VkBuffer GeometryPool::GetVertexBuffer()
+{
+	return vertexBuffer;
+}
+
+VkBuffer GeometryPool::GetIndexBuffer()
+{
+	return indexBuffer;
+}
+
+const VertexLayoutInfo& GeometryPool::GetVertexLayout()
+{
+	return vertexLayout;
+}
+
+void GeometryPool::Destroy()
+{
+	DestroyBuffer(device, allocator, indexBuffer, &indexBufferAllocation);
+	DestroyBuffer(device, allocator, vertexBuffer, &vertexBufferAllocation);
+}
+
+GeometryPool::~GeometryPool()
+{
+}
+
+uint32_t GeometryPool::GetIndexUnits(const GeometryRange& range)
+{
+	return range.indexType == VK_INDEX_TYPE_UINT16 ? (range.indexCount + 1) / 2 : range.indexCount;
+}
+
+void GeometryPool::StageIndices(const uint32_t* indices, uint32_t indexCount, VkIndexType indexType, VkDeviceSize unitOffset)
+{
+	VkDeviceSize dstOffset = sizeof(uint32_t) * unitOffset;
+	if (indexType == VK_INDEX_TYPE_UINT32)
+	{
+		uploadManager->UploadToBuffer(indexBuffer, dstOffset, indices, sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCount));
+		return;
+	}
+
+	// Narrowed in chunks straight into staging, same as vertices (chunks hold an even count so each starts on a 32 bit boundary)
+	uint32_t chunkIndices = std::max(2u, static_cast<uint32_t>(uploadManager->GetMaxChunkSize() / sizeof(uint16_t)) & ~1u);
+	for (uint32_t first = 0; first < indexCount; first += chunkIndices)
+	{
+		uint32_t count = std::min(chunkIndices, indexCount - first);
+		VkDeviceSize chunkSize = sizeof(uint16_t) * static_cast<VkDeviceSize>(count);
+
+		VkDeviceSize stagingOffset;
+		uint16_t* staging = static_cast<uint16_t*>(uploadManager->ReserveStaging(chunkSize, &stagingOffset));
+		for (uint32_t i = 0; i < count; i++)
+		{
+			staging[i] = static_cast<uint16_t>(indices[first + i]);
+		}
+		uploadManager->CopyToBuffer(stagingOffset, indexBuffer, dstOffset + sizeof(uint16_t) * first, chunkSize);
+	}
+}
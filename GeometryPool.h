@@ -0,0 +1,65 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "Utilities.h"
+#include "UploadManager.h"
+#include "VertexLayouts.h"
+
+const uint32_t DEFAULT_GEOMETRY_VERTEX_CAPACITY = 1024 * 1024;		// Vertices the shared vertex buffer can hold
+const uint32_t DEFAULT_GEOMETRY_INDEX_CAPACITY = 4 * 1024 * 1024;	// 32 bit indices the shared index buffer can hold (twice as many 16 bit ones)
+
+// Where one mesh's data lives in the shared geometry buffers (in vertices/indices, not bytes)
+struct GeometryRange
+{
+	uint32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;		// Counted in indices of the range's own index type
+	uint32_t indexCount = 0;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+};
+
+// One large vertex buffer and one large index buffer shared by every mesh
+// so a whole frame can be drawn with a single vertex/index buffer bind, using offsets to pick each mesh
+// Vertices are converted to the pool's vertex layout as they are staged
+// Meshes with few enough vertices can store 16 bit indices in the same index buffer, halving their index fetch
+class GeometryPool
+{
+public:
+	GeometryPool();
+
+	void Init(VkDevice newDevice, DeviceAllocator* newAllocator, UploadManager* newUploadManager, const VertexLayoutInfo& newVertexLayout,
+		uint32_t vertexCapacity = DEFAULT_GEOMETRY_VERTEX_CAPACITY, uint32_t indexCapacity = DEFAULT_GEOMETRY_INDEX_CAPACITY);
+
+	GeometryRange Add(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+		const VertexQuantization& quantization, bool compactIndices = false);
+	void Remove(const GeometryRange& range);
+
+	VkBuffer GetVertexBuffer();
+	VkBuffer GetIndexBuffer();
+	const VertexLayoutInfo& GetVertexLayout();
+
+	void Destroy();
+
+	~GeometryPool();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+	UploadManager* uploadManager = nullptr;
+	VertexLayoutInfo vertexLayout;			// Format vertices are stored in
+
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	Allocation vertexBufferAllocation;
+	RangeAllocator vertexRanges;			// Free vertex slots
+
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	Allocation indexBufferAllocation;
+	RangeAllocator indexRanges;				// Free index slots, counted in 32 bit units
+
+	static uint32_t GetIndexUnits(const GeometryRange& range);
+	void StageIndices(const uint32_t* indices, uint32_t indexCount, VkIndexType indexType, VkDeviceSize unitOffset);
+};
@@ -0,0 +1,262 @@
+#include "GpuProfiler.h"
+
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler()
+{
+}
+
+void GpuProfiler::Init(VkPhysicalDevice physicalDevice, VkDevice newDevice, uint32_t queueFamilyIndex, uint32_t newSlotCount, bool newEnableStatistics)
+{
+	device = newDevice;
+	enableStatistics = newEnableStatistics;
+
+	// Timestamps need a queue that writes them (timestampValidBits of 0 means no support)
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyList.data());
+
+	uint32_t validBits = queueFamilyList[queueFamilyIndex].timestampValidBits;
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	timestampPeriod = deviceProperties.limits.timestampPeriod;
+
+	supported = validBits > 0 && timestampPeriod > 0.0f;
+	if (!supported)
+	{
+		printf("GPU timestamps not supported on queue family %d, profiling disabled\n", queueFamilyIndex);
+		return;
+	}
+	timestampMask = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+
+	// Two timestamps (begin + end) for every scope
+	VkQueryPoolCreateInfo timestampPoolInfo = {};
+	timestampPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	timestampPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	timestampPoolInfo.queryCount = MAX_PROFILER_SCOPES * 2;
+
+	// One pipeline statistics query covering whole frame
+	VkQueryPoolCreateInfo statisticsPoolInfo = {};
+	statisticsPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	statisticsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	statisticsPoolInfo.queryCount = 1;
+	statisticsPoolInfo.pipelineStatistics = GetStatisticsFlags();
+
+	slots.resize(newSlotCount);
+	for (auto& slot : slots)
+	{
+		VkResult result = vkCreateQueryPool(device, &timestampPoolInfo, nullptr, &slot.timestampPool);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Timestamp Query Pool!");
+		}
+
+		if (enableStatistics)
+		{
+			result = vkCreateQueryPool(device, &statisticsPoolInfo, nullptr, &slot.statisticsPool);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a Pipeline Statistics Query Pool!");
+			}
+		}
+	}
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	if (!supported)
+	{
+		return;
+	}
+
+	// Queries must be reset before they are written again (must be outside a render pass)
+	ProfilerSlot& profilerSlot = slots[slot];
+	vkCmdResetQueryPool(commandBuffer, profilerSlot.timestampPool, 0, MAX_PROFILER_SCOPES * 2);
+	if (enableStatistics)
+	{
+		vkCmdResetQueryPool(commandBuffer, profilerSlot.statisticsPool, 0, 1);
+	}
+
+	profilerSlot.scopeNames.clear();
+	profilerSlot.statisticsRecorded = false;
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, uint32_t slot, const std::string& name)
+{
+	uint32_t scope = ReserveScope(slot, name);
+	WriteScopeBegin(commandBuffer, slot, scope);
+
+	return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t scope)
+{
+	if (!supported || scope >= MAX_PROFILER_SCOPES)
+	{
+		return;
+	}
+
+	// End timestamp is written once all previous commands have completely finished
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slots[slot].timestampPool, scope * 2 + 1);
+}
+
+uint32_t GpuProfiler::ReserveScope(uint32_t slot, const std::string& name)
+{
+	// Returning MAX_PROFILER_SCOPES marks scope as not recorded, so writes to it are ignored
+	if (!supported || slots[slot].scopeNames.size() >= MAX_PROFILER_SCOPES)
+	{
+		return MAX_PROFILER_SCOPES;
+	}
+
+	// Reserving is separate from writing so scopes can be handed to worker threads recording secondary buffers
+	slots[slot].scopeNames.push_back(name);
+
+	return static_cast<uint32_t>(slots[slot].scopeNames.size() - 1);
+}
+
+void GpuProfiler::WriteScopeBegin(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t scope)
+{
+	if (!supported || scope >= MAX_PROFILER_SCOPES)
+	{
+		return;
+	}
+
+	// Begin timestamp is written once all previous commands have got to top of pipe
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slots[slot].timestampPool, scope * 2);
+}
+
+void GpuProfiler::BeginStatistics(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	if (!supported || !enableStatistics)
+	{
+		return;
+	}
+
+	vkCmdBeginQuery(commandBuffer, slots[slot].statisticsPool, 0, 0);
+	slots[slot].statisticsRecorded = true;
+}
+
+void GpuProfiler::EndStatistics(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	if (!supported || !enableStatistics)
+	{
+		return;
+	}
+
+	vkCmdEndQuery(commandBuffer, slots[slot].statisticsPool, 0);
+}
+
+bool GpuProfiler::CollectResults(uint32_t slot)
+{
+	if (!supported || slots[slot].scopeNames.empty())
+	{
+		return false;
+	}
+
+	ProfilerSlot& profilerSlot = slots[slot];
+	uint32_t queryCount = static_cast<uint32_t>(profilerSlot.scopeNames.size()) * 2;
+
+	// No WAIT bit: if slot's commands haven't finished yet, VK_NOT_READY is returned and previous results are kept
+	std::vector<uint64_t> timestamps(queryCount);
+	VkResult result = vkGetQueryPoolResults(device, profilerSlot.timestampPool, 0, queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	// Convert timestamp ticks to milliseconds
+	scopeTimings.resize(profilerSlot.scopeNames.size());
+	for (size_t i = 0; i < profilerSlot.scopeNames.size(); i++)
+	{
+		uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+		scopeTimings[i].name = profilerSlot.scopeNames[i];
+		scopeTimings[i].time = static_cast<double>(ticks) * timestampPeriod / 1000000.0;
+	}
+
+	if (enableStatistics && profilerSlot.statisticsRecorded)
+	{
+		// Results are written in order of statistic bits: vertex shader, clipping primitives, fragment shader
+		uint64_t statistics[3] = {};
+		result = vkGetQueryPoolResults(device, profilerSlot.statisticsPool, 0, 1,
+			sizeof(statistics), statistics, sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS)
+		{
+			pipelineStatistics.vertexShaderInvocations = statistics[0];
+			pipelineStatistics.clippingPrimitives = statistics[1];
+			pipelineStatistics.fragmentShaderInvocations = statistics[2];
+		}
+	}
+
+	return true;
+}
+
+const std::vector<GpuScopeTiming>& GpuProfiler::GetScopeTimings()
+{
+	return scopeTimings;
+}
+
+const GpuPipelineStatistics& GpuProfiler::GetPipelineStatistics()
+{
+	return pipelineStatistics;
+}
+
+void GpuProfiler::LogResults()
+{
+	if (!supported || scopeTimings.empty())
+	{
+		return;
+	}
+
+	printf("GPU timings:\n");
+	for (const auto& scope : scopeTimings)
+	{
+		printf("  %-20s %8.3f ms\n", scope.name.c_str(), scope.time);
+	}
+
+	if (enableStatistics)
+	{
+		printf("  Vertex shader invocations:   %llu\n", static_cast<unsigned long long>(pipelineStatistics.vertexShaderInvocations));
+		printf("  Clipping primitives:         %llu\n", static_cast<unsigned long long>(pipelineStatistics.clippingPrimitives));
+		printf("  Fragment shader invocations: %llu\n", static_cast<unsigned long long>(pipelineStatistics.fragmentShaderInvocations));
+	}
+}
+
+bool GpuProfiler::IsSupported()
+{
+	return supported;
+}
+
+bool GpuProfiler::IsStatisticsEnabled()
+{
+	return supported && enableStatistics;
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::GetStatisticsFlags()
+{
+	return VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+}
+
+void GpuProfiler::Destroy()
+{
+	for (auto& slot : slots)
+	{
+		if (slot.timestampPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, slot.timestampPool, nullptr);
+		}
+		if (slot.statisticsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, slot.statisticsPool, nullptr);
+		}
+	}
+	slots.clear();
+}
+
+GpuProfiler::~GpuProfiler()
+{
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+
+const uint32_t MAX_PROFILER_SCOPES = 32;		// Named timestamp scopes that can be recorded into one slot
+
+// GPU time taken by one named scope (milliseconds)
+struct GpuScopeTiming
+{
+	std::string name;
+	double time = 0.0;
+};
+
+// Counters from the pipeline statistics query of one frame
+struct GpuPipelineStatistics
+{
+	uint64_t vertexShaderInvocations = 0;
+	uint64_t clippingPrimitives = 0;
+	uint64_t fragmentShaderInvocations = 0;
+};
+
+// Measures GPU time of named scopes with timestamp queries, plus optional pipeline statistics
+// Each slot (one per command buffer that can be in flight) has its own query pools, so results of
+// a finished slot are read while other slots are still executing, without stalling the queue
+class GpuProfiler
+{
+public:
+	GpuProfiler();
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice newDevice, uint32_t queueFamilyIndex, uint32_t newSlotCount, bool newEnableStatistics);
+
+	// - Recording
+	void BeginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+	uint32_t BeginScope(VkCommandBuffer commandBuffer, uint32_t slot, const std::string& name);
+	void EndScope(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t scope);
+	uint32_t ReserveScope(uint32_t slot, const std::string& name);
+	void WriteScopeBegin(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t scope);
+	void BeginStatistics(VkCommandBuffer commandBuffer, uint32_t slot);
+	void EndStatistics(VkCommandBuffer commandBuffer, uint32_t slot);
+
+	// - Results
+	bool CollectResults(uint32_t slot);
+	const std::vector<GpuScopeTiming>& GetScopeTimings();
+	const GpuPipelineStatistics& GetPipelineStatistics();
+	void LogResults();
+
+	bool IsSupported();
+	bool IsStatisticsEnabled();
+	VkQueryPipelineStatisticFlags GetStatisticsFlags();
+
+	void Destroy();
+
+	~GpuProfiler();
+
+private:
+	struct ProfilerSlot
+	{
+		VkQueryPool timestampPool = VK_NULL_HANDLE;
+		VkQueryPool statisticsPool = VK_NULL_HANDLE;
+		std::vector<std::string> scopeNames;		// Name of each scope recorded into slot (scope i uses queries 2i and 2i+1)
+		bool statisticsRecorded = false;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	bool supported = false;
+	bool enableStatistics = false;
+	float timestampPeriod = 1.0f;				// Nanoseconds per timestamp tick
+	uint64_t timestampMask = ~0ULL;				// Valid bits of timestamps written by the queue
+
+	std::vector<ProfilerSlot> slots;
+
+	// Results of most recently collected slot
+	std::vector<GpuScopeTiming> scopeTimings;
+	GpuPipelineStatistics pipelineStatistics;
+};
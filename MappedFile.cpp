@@ -0,0 +1,134 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const std::string& filename)
+{
+	std::shared_ptr<Mapping> newMapping = std::make_shared<Mapping>();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open a file!");
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of a file!");
+	}
+	newMapping->size = static_cast<size_t>(fileSize.QuadPart);
+
+	// Empty files can't be mapped, they are just an empty span
+	if (newMapping->size > 0)
+	{
+		HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (fileMapping != nullptr)
+		{
+			newMapping->data = static_cast<const char*>(MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0));
+
+			// View keeps the mapping object alive on its own
+			CloseHandle(fileMapping);
+		}
+	}
+	CloseHandle(file);
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		throw std::runtime_error("Failed to open a file!");
+	}
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0)
+	{
+		close(file);
+		throw std::runtime_error("Failed to get size of a file!");
+	}
+	newMapping->size = static_cast<size_t>(fileStat.st_size);
+
+	// Empty files can't be mapped, they are just an empty span
+	if (newMapping->size > 0)
+	{
+		void* data = mmap(nullptr, newMapping->size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data != MAP_FAILED)
+		{
+			newMapping->data = static_cast<const char*>(data);
+		}
+	}
+
+	// Mapping stays valid after file descriptor is closed
+	close(file);
+#endif
+
+	if (newMapping->size > 0 && newMapping->data == nullptr)
+	{
+		throw std::runtime_error("Failed to map a file!");
+	}
+
+	mapping = newMapping;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return mapping != nullptr;
+}
+
+FileSpan MappedFile::GetSpan() const
+{
+	FileSpan span;
+	span.data = GetData();
+	span.size = GetSize();
+	return span;
+}
+
+const char* MappedFile::GetData() const
+{
+	return mapping ? mapping->data : nullptr;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return mapping ? mapping->size : 0;
+}
+
+void MappedFile::Close()
+{
+	// Only unmaps if no other copy still uses the mapping
+	mapping.reset();
+}
+
+MappedFile::~MappedFile()
+{
+}
+
+MappedFile::Mapping::~Mapping()
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap(const_cast<char*>(data), size);
+#endif
+}
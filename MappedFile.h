@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+// Read-only view of bytes (not owned)
+struct FileSpan
+{
+	const char* data = nullptr;
+	size_t size = 0;
+};
+
+// Read-only memory mapping of a whole file, so its contents are read straight from the mapped pages without copying
+// Copies share the same mapping, which is only unmapped once the last copy is destroyed or closed
+class MappedFile
+{
+public:
+	MappedFile();
+	MappedFile(const std::string& filename);
+
+	bool IsOpen() const;
+	FileSpan GetSpan() const;
+	const char* GetData() const;
+	size_t GetSize() const;
+
+	void Close();
+
+	~MappedFile();
+
+private:
+	// OS mapping, shared between copies and unmapped in its destructor
+	struct Mapping
+	{
+		const char* data = nullptr;
+		size_t size = 0;
+
+		~Mapping();
+	};
+
+	std::shared_ptr<Mapping> mapping;
+};
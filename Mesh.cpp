@@ -1,112 +1,164 @@
 #include "Mesh.h"
 
+#include <algorithm>
+
 Mesh::Mesh()
 {
 }
 
-Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices)
+Mesh::Mesh(GeometryPool* newGeometryPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices)
+	: Mesh(newGeometryPool, vertices->data(), static_cast<uint32_t>(vertices->size()), indices->data(), static_cast<uint32_t>(indices->size()))
+{
+}
+
+Mesh::Mesh(GeometryPool* newGeometryPool, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+	const MeshBounds* knownBounds, bool compactIndices, const std::vector<LodLevel>* lodLevels)
 {
-	vertexCount = vertices->size();
-	indexCount = indices->size();
-	physicalDevice = newPhysicalDevice;
-	device = newDevice;
-	CreateVertexBuffer(transferQueue, transferCommandPool, vertices);
-	CreateIndexBuffer(transferQueue, transferCommandPool, indices);
+	geometryPool = newGeometryPool;
+
+	// Mesh files store their bounds, which saves reading every vertex an extra time
+	MeshBounds bounds = knownBounds != nullptr ? *knownBounds : CalculateBounds(vertices, vertexCount);
+	boundingSphere = bounds.sphere;
+
+	// Quantized positions span the bounding box (flat axes still get a non-zero extent)
+	VertexQuantization quantization;
+	quantization.centre = (bounds.min + bounds.max) * 0.5f;
+	quantization.halfExtent = glm::max((bounds.max - bounds.min) * 0.5f, glm::vec3(1e-6f));
+
+	if (geometryPool->GetVertexLayout().boundsRelative)
+	{
+		dequantizeTransform = glm::mat4(1.0f);
+		dequantizeTransform[0][0] = quantization.halfExtent.x;
+		dequantizeTransform[1][1] = quantization.halfExtent.y;
+		dequantizeTransform[2][2] = quantization.halfExtent.z;
+		dequantizeTransform[3] = glm::vec4(quantization.centre, 1.0f);
+	}
+
+	// Simplified LODs are appended after the full mesh's indices, so one index range holds the whole chain
+	const uint32_t* chainIndices = indices;
+	uint32_t chainIndexCount = indexCount;
+	std::vector<uint32_t> lodChain;
+
+	lods[0] = { 0, indexCount, 0.0f };
+	lodCount = 1;
+	if (lodLevels != nullptr && !lodLevels->empty())
+	{
+		lodChain.assign(indices, indices + indexCount);
+		for (const LodLevel& level : *lodLevels)
+		{
+			if (lodCount == MAX_MESH_LODS)
+			{
+				break;
+			}
+			lods[lodCount++] = { static_cast<uint32_t>(lodChain.size()), static_cast<uint32_t>(level.indices.size()), level.error };
+			lodChain.insert(lodChain.end(), level.indices.begin(), level.indices.end());
+		}
+
+		chainIndices = lodChain.data();
+		chainIndexCount = static_cast<uint32_t>(lodChain.size());
+	}
+
+	// Stage vertex and index data into free space of the shared buffers, copy to GPU happens when the upload batch is flushed
+	// (indices are narrowed to 16 bit if asked for and every vertex can be reached with them)
+	geometryRange = geometryPool->Add(vertices, vertexCount, chainIndices, chainIndexCount, quantization, compactIndices);
+
+	for (uint32_t i = 0; i < lodCount; i++)
+	{
+		lods[i].firstIndex += geometryRange.firstIndex;
+	}
 }
 
 int Mesh::GetVertexCount()
 {
-	return vertexCount;
+	return geometryRange.vertexCount;
+}
+
+int32_t Mesh::GetVertexOffset()
+{
+	return static_cast<int32_t>(geometryRange.vertexOffset);
 }
 
 VkBuffer Mesh::GetVertexBuffer()
 {
-	return vertexBuffer;
+	return geometryPool->GetVertexBuffer();
 }
 
 int Mesh::GetIndexCount()
 {
-	return indexCount;
+	return lods[0].indexCount;
 }
 
-VkBuffer Mesh::GetIndexBuffer()
+uint32_t Mesh::GetFirstIndex()
 {
-	return indexBuffer;
+	return lods[0].firstIndex;
 }
 
-void Mesh::DestroyBuffers()
+VkIndexType Mesh::GetIndexType()
 {
-	vkDestroyBuffer(device, vertexBuffer, nullptr);
-	vkFreeMemory(device, vertexBufferMemory, nullptr);
-	vkDestroyBuffer(device, indexBuffer, nullptr);
-	vkFreeMemory(device, indexBufferMemory, nullptr);
+	return geometryRange.indexType;
 }
 
-Mesh::~Mesh()
+VkBuffer Mesh::GetIndexBuffer()
 {
+	return geometryPool->GetIndexBuffer();
 }
 
-void Mesh::CreateVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices)
+uint32_t Mesh::GetLodCount()
 {
-	// Get size of buffer needed for vertices
-	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
-
-	// Temporary buffer to "stage" vertex data before transferring to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	// Create Staging Buffer and Allocate Memory to it
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-		&stagingBuffer, &stagingBufferMemory);
-	// VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT  : CPU can interact with memory
-	// VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : Allows placement of data straight into buffer after mapping (otherwise would have to specify manually)
-
-	// MAP MEMORY TO VERTEX BUFFER
-	void* data;																// 1. Create pointer to a point in normal memory
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);		// 2. "Map" the vertex buffer memory to that point
-	memcpy(data, vertices->data(), static_cast<size_t>(bufferSize));		// 3. Copy memory from vertices vector to the point
-	vkUnmapMemory(device, stagingBufferMemory);								// 4. Unmap the vertex buffer memory
-
-	// Create buffer with TRANSFER_SRC_BIT to mark as recipient of transfer data (also VERTEX_BUFFER)
-	// Buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the GPU and only accessible by it and not CPU (host)
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer, &vertexBufferMemory);
-
-	// Copy staging buffer to vertex buffer on GPU
-	CopyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, vertexBuffer, bufferSize);
-
-	// Clean up staging buffer parts
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	return lodCount;
 }
 
-void Mesh::CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices)
+const MeshLod& Mesh::GetLod(uint32_t lod)
 {
-	// Get size of buffer needed for indices
-	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
+	return lods[lod];
+}
 
-	// Temporary buffer to "stage" index data before transferring to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&stagingBuffer, &stagingBufferMemory);
+glm::vec4 Mesh::GetBoundingSphere()
+{
+	return boundingSphere;
+}
 
-	// MAP MEMORY TO INDEX BUFFER
-	void* data;						
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);	
-	memcpy(data, indices->data(), static_cast<size_t>(bufferSize));	
-	vkUnmapMemory(device, stagingBufferMemory);			
+const glm::mat4& Mesh::GetDequantizeTransform()
+{
+	return dequantizeTransform;
+}
 
-	// Create buffer for INDEX data on GPU access only area
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indexBuffer, &indexBufferMemory);
+void Mesh::Destroy()
+{
+	// Hand range back to the pool so another mesh can use it
+	geometryPool->Remove(geometryRange);
+}
 
-	// Copy staging buffer to GPU access buffer
-	CopyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, indexBuffer, bufferSize);
+Mesh::~Mesh()
+{
+}
 
-	// Destry & Release Stagin Buffer resources
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+MeshBounds Mesh::CalculateBounds(const Vertex* vertices, uint32_t vertexCount)
+{
+	MeshBounds bounds = {};
+	if (vertexCount == 0)
+	{
+		return bounds;
+	}
+
+	// Centre sphere on middle of bounding box, then grow radius to reach furthest vertex
+	glm::vec3 minPos = vertices[0].pos;
+	glm::vec3 maxPos = vertices[0].pos;
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		minPos = glm::min(minPos, vertices[i].pos);
+		maxPos = glm::max(maxPos, vertices[i].pos);
+	}
+	glm::vec3 centre = (minPos + maxPos) * 0.5f;
+
+	float radius = 0.0f;
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		radius = std::max(radius, glm::distance(centre, vertices[i].pos));
+	}
+
+	bounds.min = minPos;
+	bounds.max = maxPos;
+	bounds.sphere = glm::vec4(centre, radius);
+	return bounds;
 }
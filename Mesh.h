@@ -6,36 +6,66 @@
 #include <vector>
 
 #include "Utilities.h"
+#include "GeometryPool.h"
+#include "MeshSimplifier.h"
+
+const uint32_t MAX_MESH_LODS = 8;		// Full mesh plus up to 7 simplified levels
+const float DEFAULT_LOD_ERROR_THRESHOLD = 1.0f;		// Pixels a LOD's error may cover on screen before a finer LOD is used
+
+// Box and sphere enclosing every vertex of a mesh (in mesh space)
+struct MeshBounds
+{
+	glm::vec3 min;
+	glm::vec3 max;
+	glm::vec4 sphere;		// Centre (xyz) and radius (w)
+};
+
+// Index range of one level of detail (every LOD indexes the mesh's same vertices)
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;			// Estimated distance (mesh units) from full mesh, 0 for LOD 0
+};
 
 class Mesh
 {
 public:
 	Mesh();
-	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices);
+	Mesh(GeometryPool* newGeometryPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices);
+	Mesh(GeometryPool* newGeometryPool, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+		const MeshBounds* knownBounds = nullptr, bool compactIndices = false, const std::vector<LodLevel>* lodLevels = nullptr);
 
 	int GetVertexCount();
+	int32_t GetVertexOffset();
 	VkBuffer GetVertexBuffer();
 
 	int GetIndexCount();
+	uint32_t GetFirstIndex();
+	VkIndexType GetIndexType();
 	VkBuffer GetIndexBuffer();
 
-	void DestroyBuffers();
+	uint32_t GetLodCount();
+	const MeshLod& GetLod(uint32_t lod);
+
+	glm::vec4 GetBoundingSphere();
+	const glm::mat4& GetDequantizeTransform();
+
+	static MeshBounds CalculateBounds(const Vertex* vertices, uint32_t vertexCount);
+
+	void Destroy();
 
 	~Mesh();
 
 private:
-	int vertexCount;
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-
-	int indexCount;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
+	// Mesh data is a range of the pool's shared vertex and index buffers
+	GeometryPool* geometryPool = nullptr;
+	GeometryRange geometryRange;
 
-	VkPhysicalDevice physicalDevice;
-	VkDevice device;
+	// LOD 0 is the full mesh, each further LOD coarser (error only grows), all stored one after another in the mesh's index range
+	MeshLod lods[MAX_MESH_LODS] = {};
+	uint32_t lodCount = 1;
 
-	void CreateVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices);
-	void CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices);
+	glm::vec4 boundingSphere;		// Centre (xyz) and radius (w) enclosing every vertex, used for culling
+	glm::mat4 dequantizeTransform = glm::mat4(1.0f);	// Maps stored positions back to mesh space (identity unless layout is bounds relative)
 };
-
@@ -0,0 +1,149 @@
+#include "MeshFile.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cstddef>
+
+MeshFile::MeshFile()
+{
+}
+
+MeshFile::MeshFile(const std::string& filename)
+{
+	file = MappedFile(filename);
+
+	if (file.GetSize() < sizeof(MeshFileHeader))
+	{
+		throw std::runtime_error("Failed to load Mesh File " + filename + ", file is too small!");
+	}
+	memcpy(&header, file.GetData(), sizeof(MeshFileHeader));
+
+	Validate(filename);
+}
+
+const Vertex* MeshFile::GetVertices()
+{
+	return reinterpret_cast<const Vertex*>(file.GetData() + header.vertexDataOffset);
+}
+
+uint32_t MeshFile::GetVertexCount()
+{
+	return header.vertexCount;
+}
+
+const uint32_t* MeshFile::GetIndices()
+{
+	return reinterpret_cast<const uint32_t*>(file.GetData() + header.indexDataOffset);
+}
+
+uint32_t MeshFile::GetIndexCount()
+{
+	return header.indexCount;
+}
+
+MeshBounds MeshFile::GetBounds()
+{
+	MeshBounds bounds;
+	bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	bounds.sphere = glm::vec4(header.boundingSphere[0], header.boundingSphere[1], header.boundingSphere[2], header.boundingSphere[3]);
+	return bounds;
+}
+
+MeshFile::~MeshFile()
+{
+}
+
+void MeshFile::Validate(const std::string& filename)
+{
+	std::string error;
+
+	if (header.magic != MESH_FILE_MAGIC)
+	{
+		error = "not a mesh file";
+	}
+	else if (header.version != MESH_FILE_VERSION)
+	{
+		error = "unsupported version " + std::to_string(header.version);
+	}
+	else if (header.indexSize != sizeof(uint32_t))
+	{
+		error = "only 32 bit indices are supported";
+	}
+	else if (header.attributeCount > MESH_FILE_MAX_ATTRIBUTES)
+	{
+		error = "too many vertex attributes";
+	}
+
+	// Vertex data is used in place, so its layout must be exactly the renderer's Vertex
+	if (error.empty())
+	{
+		bool hasPosition = false;
+		bool hasColour = false;
+		for (uint32_t i = 0; i < header.attributeCount; i++)
+		{
+			const MeshFileAttribute& attribute = header.attributes[i];
+			if (attribute.semantic == MESH_ATTRIBUTE_POSITION)
+			{
+				hasPosition = attribute.format == MESH_FORMAT_FLOAT3 && attribute.offset == offsetof(Vertex, pos);
+			}
+			else if (attribute.semantic == MESH_ATTRIBUTE_COLOUR)
+			{
+				hasColour = attribute.format == MESH_FORMAT_FLOAT3 && attribute.offset == offsetof(Vertex, col);
+			}
+		}
+
+		if (header.vertexStride != sizeof(Vertex) || !hasPosition || !hasColour)
+		{
+			error = "vertex layout doesn't match renderer's vertex";
+		}
+	}
+
+	// Blobs must be aligned and lie entirely inside file
+	if (error.empty())
+	{
+		uint64_t fileSize = file.GetSize();
+		uint64_t vertexDataSize = static_cast<uint64_t>(header.vertexCount) * header.vertexStride;
+		uint64_t indexDataSize = static_cast<uint64_t>(header.indexCount) * header.indexSize;
+
+		if (header.vertexDataSize != vertexDataSize || header.indexDataSize != indexDataSize)
+		{
+			error = "blob sizes don't match counts";
+		}
+		else if (header.vertexDataOffset % MESH_FILE_BLOB_ALIGNMENT != 0 || header.indexDataOffset % MESH_FILE_BLOB_ALIGNMENT != 0)
+		{
+			error = "blobs are not aligned";
+		}
+		else if (header.vertexDataOffset > fileSize || vertexDataSize > fileSize - header.vertexDataOffset ||
+			header.indexDataOffset > fileSize || indexDataSize > fileSize - header.indexDataOffset)
+		{
+			error = "file is truncated";
+		}
+	}
+
+	// Index data is drawn as a triangle list straight from file, so every index must point at a vertex
+	if (error.empty())
+	{
+		if (header.indexCount % 3 != 0)
+		{
+			error = "index count isn't a multiple of 3";
+		}
+		else
+		{
+			const uint32_t* indices = GetIndices();
+			for (uint32_t i = 0; i < header.indexCount; i++)
+			{
+				if (indices[i] >= header.vertexCount)
+				{
+					error = "index " + std::to_string(i) + " is out of range";
+					break;
+				}
+			}
+		}
+	}
+
+	if (!error.empty())
+	{
+		throw std::runtime_error("Failed to load Mesh File " + filename + ", " + error + "!");
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+#include "Utilities.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "MeshFormat.h"
+
+// Binary mesh file mapped into memory, with its vertex and index data read in place
+// (handed straight to staging when uploaded, never copied into intermediate vectors)
+class MeshFile
+{
+public:
+	MeshFile();
+	MeshFile(const std::string& filename);
+
+	const Vertex* GetVertices();
+	uint32_t GetVertexCount();
+	const uint32_t* GetIndices();
+	uint32_t GetIndexCount();
+	MeshBounds GetBounds();
+
+	~MeshFile();
+
+private:
+	MappedFile file;
+	MeshFileHeader header = {};
+
+	void Validate(const std::string& filename);
+};
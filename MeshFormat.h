@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+// Layout of binary mesh files (.mesh), shared by the renderer's loader and the MeshConverter tool
+// File is a header followed by aligned vertex and index blobs, so it can be mapped and read in place:
+//
+//	[MeshFileHeader][padding][vertex data][padding][index data]
+//
+// Every value is little endian
+
+const uint32_t MESH_FILE_MAGIC = 0x4853454D;		// "MESH"
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_FILE_BLOB_ALIGNMENT = 64;		// Vertex and index data start on a multiple of this (from start of file)
+const uint32_t MESH_FILE_MAX_ATTRIBUTES = 8;
+
+// What a vertex attribute holds
+enum MeshAttributeSemantic : uint32_t
+{
+	MESH_ATTRIBUTE_POSITION = 0,
+	MESH_ATTRIBUTE_COLOUR = 1,
+};
+
+// How a vertex attribute is stored
+enum MeshAttributeFormat : uint32_t
+{
+	MESH_FORMAT_FLOAT3 = 0,		// 3 x 32 bit float
+};
+
+// One attribute of vertex layout
+struct MeshFileAttribute
+{
+	uint32_t semantic;			// MeshAttributeSemantic
+	uint32_t format;			// MeshAttributeFormat
+	uint32_t offset;			// Bytes from start of vertex
+	uint32_t reserved;
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+
+	// - Vertex Layout
+	uint32_t vertexStride;		// Bytes between vertices
+	uint32_t indexSize;			// Bytes per index
+	uint32_t attributeCount;
+	uint32_t reserved;
+	MeshFileAttribute attributes[MESH_FILE_MAX_ATTRIBUTES];
+
+	// - Blobs (byte offsets from start of file)
+	uint64_t vertexDataOffset;
+	uint64_t vertexDataSize;
+	uint64_t indexDataOffset;
+	uint64_t indexDataSize;
+
+	// - Bounds (in mesh space)
+	float boundsMin[3];
+	float boundsMax[3];
+	float boundingSphere[4];	// Centre (xyz) and radius (w)
+
+	uint32_t padding[6];		// Header is 256 bytes
+};
+
+static_assert(sizeof(MeshFileHeader) == 256, "MeshFileHeader must stay 256 bytes");
@@ -0,0 +1,345 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStatistics statistics;
+	if (indexCount < 3 || vertexCount == 0)
+	{
+		return statistics;
+	}
+
+	// Time each vertex entered cache, vertex is still in FIFO cache if fewer than cacheSize vertices entered since
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	uint32_t misses = 0;
+
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		uint32_t index = indices[i];
+		if (timestamp - cacheTimestamps[index] > cacheSize)
+		{
+			cacheTimestamps[index] = timestamp++;
+			misses++;
+		}
+	}
+
+	statistics.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+	statistics.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+	return statistics;
+}
+
+// -- VERTEX CACHE --
+
+// Score of a vertex for being picked next: high while it sits near front of cache, and when few triangles still use it
+// (so vertices get finished off rather than left behind to be transformed again later)
+static float VertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// Vertices of last triangle get a fixed score, so its neighbours don't get picked just for being newest
+			score = 0.75f;
+		}
+		else
+		{
+			float scale = 1.0f / (OPTIMIZER_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+		}
+	}
+
+	return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles using each vertex, packed into one list (adjacencyOffsets[v] .. + remaining[v])
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount, 0);
+	uint32_t offset = 0;
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v] = offset;
+		offset += remaining[v];
+	}
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> adjacencyFill(adjacencyOffsets);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			adjacency[adjacencyFill[v]++] = t;
+		}
+	}
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = VertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+
+	// LRU cache, with room for a whole triangle pushed past its end
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	cache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+	nextCache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+
+	std::vector<uint32_t> optimized;
+	optimized.reserve(triangleCount * 3);
+
+	// Start from best scoring triangle, afterwards best triangles are always found among those touching the cache
+	uint32_t bestTriangle = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	uint32_t inputCursor = 0;		// Fallback when cache holds no unfinished triangles: next unemitted one in input order
+
+	while (true)
+	{
+		uint32_t a = indices[bestTriangle * 3];
+		uint32_t b = indices[bestTriangle * 3 + 1];
+		uint32_t c = indices[bestTriangle * 3 + 2];
+
+		optimized.push_back(a);
+		optimized.push_back(b);
+		optimized.push_back(c);
+		emitted[bestTriangle] = true;
+
+		// Remove emitted triangle from its vertices' remaining triangles
+		for (uint32_t v : { a, b, c })
+		{
+			uint32_t* triangles = &adjacency[adjacencyOffsets[v]];
+			uint32_t* last = triangles + remaining[v] - 1;
+			*std::find(triangles, last + 1, bestTriangle) = *last;
+			remaining[v]--;
+		}
+
+		// Move triangle's vertices to front of cache, everything else shifts back
+		nextCache.clear();
+		nextCache.push_back(a);
+		nextCache.push_back(b);
+		nextCache.push_back(c);
+		for (uint32_t v : cache)
+		{
+			if (v != a && v != b && v != c)
+			{
+				nextCache.push_back(v);
+			}
+		}
+		cache.swap(nextCache);
+
+		// Rescore cached vertices (those pushed out lose their cache score), then triangles using them
+		for (uint32_t i = 0; i < cache.size(); i++)
+		{
+			uint32_t v = cache[i];
+			cachePositions[v] = i < OPTIMIZER_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+			vertexScores[v] = VertexScore(cachePositions[v], remaining[v]);
+		}
+
+		float bestScore = -1.0f;
+		bestTriangle = UINT32_MAX;
+		for (uint32_t v : cache)
+		{
+			for (uint32_t i = 0; i < remaining[v]; i++)
+			{
+				uint32_t t = adjacency[adjacencyOffsets[v] + i];
+				float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				triangleScores[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		if (cache.size() > OPTIMIZER_CACHE_SIZE)
+		{
+			cache.resize(OPTIMIZER_CACHE_SIZE);
+		}
+
+		if (bestTriangle == UINT32_MAX)
+		{
+			while (inputCursor < triangleCount && emitted[inputCursor])
+			{
+				inputCursor++;
+			}
+			if (inputCursor == triangleCount)
+			{
+				break;
+			}
+			bestTriangle = inputCursor;
+		}
+	}
+
+	indices.swap(optimized);
+}
+
+// -- OVERDRAW --
+
+struct TriangleCluster
+{
+	uint32_t firstTriangle;
+	uint32_t triangleCount;
+	float sortKey;
+};
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Split where vertex cache order starts over (triangle has no vertex in cache), reordering those clusters costs almost no cache hits
+	std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+	uint32_t timestamp = ANALYSIS_CACHE_SIZE + 1;
+
+	std::vector<TriangleCluster> clusters;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t misses = 0;
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t index = indices[t * 3 + k];
+			if (timestamp - cacheTimestamps[index] > ANALYSIS_CACHE_SIZE)
+			{
+				cacheTimestamps[index] = timestamp++;
+				misses++;
+			}
+		}
+
+		if (t == 0 || misses == 3)
+		{
+			clusters.push_back({ t, 0, 0.0f });
+		}
+		clusters.back().triangleCount++;
+	}
+
+	if (clusters.size() < 2)
+	{
+		return;
+	}
+
+	// Mesh centre as area weighted average of triangle centres
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& p0 = vertices[indices[t * 3]].pos;
+		const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+		const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+		float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+
+		meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+	meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+	// Clusters facing away from mesh centre are likely on its outside, so drawing them first lets them hide what is behind
+	for (TriangleCluster& cluster : clusters)
+	{
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3]].pos;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+			glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);		// Length is twice triangle's area
+			float triangleArea = glm::length(triangleNormal);
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += triangleNormal;
+			area += triangleArea;
+		}
+
+		float normalLength = glm::length(normal);
+		if (area > 0.0f && normalLength > 0.0f)
+		{
+			cluster.sortKey = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+		}
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster& a, const TriangleCluster& b)
+		{
+			return a.sortKey > b.sortKey;
+		});
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (const TriangleCluster& cluster : clusters)
+	{
+		sorted.insert(sorted.end(), indices.begin() + cluster.firstTriangle * 3, indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+	}
+
+	indices.swap(sorted);
+}
+
+// -- VERTEX FETCH --
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
+
+MeshOptimizationReport OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	MeshOptimizationReport report;
+	report.before = AnalyzeVertexCache(indices.data(), static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(vertices.size()));
+
+	// Incomplete triangle at end can't be drawn anyway, and would throw off triangle ordering
+	indices.resize(indices.size() - indices.size() % 3);
+
+	OptimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+	OptimizeOverdraw(indices, vertices);
+	OptimizeVertexFetch(vertices, indices);
+
+	report.after = AnalyzeVertexCache(indices.data(), static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(vertices.size()));
+	report.vertexCount = static_cast<uint32_t>(vertices.size());
+	report.fitsIn16BitIndices = vertices.size() <= MAX_16BIT_INDEXED_VERTICES;
+	return report;
+}
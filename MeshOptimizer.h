@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "Utilities.h"
+
+const uint32_t OPTIMIZER_CACHE_SIZE = 32;		// Vertex cache size triangles are ordered for
+const uint32_t ANALYSIS_CACHE_SIZE = 16;		// FIFO cache size ACMR/ATVR are measured with (typical of current GPUs)
+
+// Post-transform vertex cache efficiency of an index buffer
+struct VertexCacheStatistics
+{
+	float acmr = 0.0f;			// Average cache miss ratio: vertices transformed per triangle (0.5 best, 3 worst)
+	float atvr = 0.0f;			// Average transform to vertex ratio: vertices transformed per vertex (1 best)
+};
+
+struct MeshOptimizationReport
+{
+	VertexCacheStatistics before;
+	VertexCacheStatistics after;
+	uint32_t vertexCount = 0;	// Vertices left after unreferenced ones are dropped
+	bool fitsIn16BitIndices = false;
+};
+
+// Measures how many vertices a FIFO vertex cache of given size would have to transform for the index buffer
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize = ANALYSIS_CACHE_SIZE);
+
+// Reorders triangles so recently used vertices are reused while still in cache (Forsyth's linear speed algorithm)
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+// Reorders clusters of triangles (split where cache order restarts) so outward facing clusters are drawn first,
+// letting them occlude the rest of the mesh, without losing much of the vertex cache order
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices);
+
+// Reorders vertices in the order indices first use them (dropping unused ones), so vertex fetch reads memory sequentially
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Runs every stage above in order, measuring vertex cache efficiency before and after
+MeshOptimizationReport OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
@@ -0,0 +1,510 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <queue>
+
+// -- QUADRICS --
+
+// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix (upper triangle kept)
+struct Quadric
+{
+	double a2, b2, c2, d2;
+	double ab, ac, ad, bc, bd, cd;
+	double weight;
+};
+
+// Quadric of plane dot(normal, p) + distance = 0, normal must be unit length
+static Quadric PlaneQuadric(const glm::vec3& normal, float distance, float weight)
+{
+	double a = normal.x;
+	double b = normal.y;
+	double c = normal.z;
+	double d = distance;
+	double w = weight;
+
+	return { w * a * a, w * b * b, w * c * c, w * d * d,
+		w * a * b, w * a * c, w * a * d, w * b * c, w * b * d, w * c * d,
+		w };
+}
+
+static void AddQuadric(Quadric& quadric, const Quadric& other)
+{
+	quadric.a2 += other.a2;
+	quadric.b2 += other.b2;
+	quadric.c2 += other.c2;
+	quadric.d2 += other.d2;
+	quadric.ab += other.ab;
+	quadric.ac += other.ac;
+	quadric.ad += other.ad;
+	quadric.bc += other.bc;
+	quadric.bd += other.bd;
+	quadric.cd += other.cd;
+	quadric.weight += other.weight;
+}
+
+// Weighted mean squared distance of point to the quadric's planes
+static float QuadricError(const Quadric& quadric, const glm::vec3& p)
+{
+	double x = p.x;
+	double y = p.y;
+	double z = p.z;
+
+	double error = quadric.a2 * x * x + quadric.b2 * y * y + quadric.c2 * z * z + quadric.d2
+		+ 2.0 * (quadric.ab * x * y + quadric.ac * x * z + quadric.bc * y * z)
+		+ 2.0 * (quadric.ad * x + quadric.bd * y + quadric.cd * z);
+
+	return quadric.weight > 0.0 ? static_cast<float>(std::max(error, 0.0) / quadric.weight) : 0.0f;
+}
+
+// -- EDGES --
+
+enum VertexKind : uint8_t
+{
+	VERTEX_INTERIOR = 0,		// Free to collapse onto any neighbour
+	VERTEX_BORDER = 1,			// On an open edge, may only slide along it
+	VERTEX_LOCKED = 2,			// On a non-manifold edge, never collapsed
+};
+
+struct Edge
+{
+	uint32_t a;
+	uint32_t b;
+	bool border;				// Used by a single triangle
+};
+
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	float cost;
+};
+
+static uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+// Unique edges of triangles, classifying each vertex by the edges it's on
+static std::vector<Edge> FindEdges(const std::vector<uint32_t>& triangles, std::vector<uint8_t>& vertexKinds)
+{
+	std::vector<uint64_t> keys;
+	keys.reserve(triangles.size());
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			keys.push_back(EdgeKey(triangles[t + k], triangles[t + (k + 1) % 3]));
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<Edge> edges;
+	for (size_t i = 0; i < keys.size();)
+	{
+		size_t j = i;
+		while (j < keys.size() && keys[j] == keys[i])
+		{
+			j++;
+		}
+
+		size_t triangleCount = j - i;
+		Edge edge = { static_cast<uint32_t>(keys[i] >> 32), static_cast<uint32_t>(keys[i] & 0xFFFFFFFF), triangleCount == 1 };
+
+		uint8_t kind = triangleCount == 1 ? VERTEX_BORDER : (triangleCount > 2 ? VERTEX_LOCKED : VERTEX_INTERIOR);
+		vertexKinds[edge.a] = std::max(vertexKinds[edge.a], kind);
+		vertexKinds[edge.b] = std::max(vertexKinds[edge.b], kind);
+
+		edges.push_back(edge);
+		i = j;
+	}
+
+	return edges;
+}
+
+static bool CanCollapse(const std::vector<uint8_t>& vertexKinds, bool borderEdge, uint32_t from)
+{
+	switch (vertexKinds[from])
+	{
+	case VERTEX_INTERIOR:
+		return true;
+	case VERTEX_BORDER:
+		return borderEdge;		// Collapsing across the mesh would pull the border inwards
+	default:
+		return false;
+	}
+}
+
+// -- COLLAPSES --
+
+// Mesh being simplified: triangles are rewritten in place as vertices collapse, removed ones are only marked dead
+struct SimplifyState
+{
+	const std::vector<Vertex>* vertices;
+	std::vector<uint32_t> triangles;
+	std::vector<bool> triangleAlive;
+	uint32_t liveTriangleCount;
+	std::vector<std::vector<uint32_t>> vertexTriangles;	// Triangles around each vertex (may include dead ones)
+	std::vector<bool> vertexAlive;
+	std::vector<uint8_t> vertexKinds;
+	std::vector<Quadric> quadrics;
+};
+
+struct CollapseOrder
+{
+	bool operator()(const Collapse& a, const Collapse& b) const
+	{
+		return a.cost > b.cost;		// Cheapest on top of queue
+	}
+};
+
+typedef std::priority_queue<Collapse, std::vector<Collapse>, CollapseOrder> CollapseQueue;
+
+static bool TriangleContains(const SimplifyState& state, uint32_t triangle, uint32_t vertex)
+{
+	const uint32_t* indices = &state.triangles[triangle * 3];
+	return indices[0] == vertex || indices[1] == vertex || indices[2] == vertex;
+}
+
+// Live vertices sharing a triangle with vertex
+static void GatherNeighbours(const SimplifyState& state, uint32_t vertex, std::vector<uint32_t>& neighbours)
+{
+	neighbours.clear();
+	for (uint32_t triangle : state.vertexTriangles[vertex])
+	{
+		if (!state.triangleAlive[triangle])
+		{
+			continue;
+		}
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t other = state.triangles[triangle * 3 + k];
+			if (other != vertex && std::find(neighbours.begin(), neighbours.end(), other) == neighbours.end())
+			{
+				neighbours.push_back(other);
+			}
+		}
+	}
+}
+
+static uint32_t CountSharedTriangles(const SimplifyState& state, uint32_t a, uint32_t b)
+{
+	uint32_t count = 0;
+	for (uint32_t triangle : state.vertexTriangles[a])
+	{
+		if (state.triangleAlive[triangle] && TriangleContains(state, triangle, b))
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+static float CollapseCost(const SimplifyState& state, uint32_t from, uint32_t to)
+{
+	Quadric quadric = state.quadrics[from];
+	AddQuadric(quadric, state.quadrics[to]);
+	return QuadricError(quadric, (*state.vertices)[to].pos);
+}
+
+// Queue the cheapest allowed direction of edge a-b
+static void QueueCollapse(const SimplifyState& state, CollapseQueue& queue, uint32_t a, uint32_t b, bool borderEdge)
+{
+	Collapse best = { 0, 0, FLT_MAX };
+	for (uint32_t direction = 0; direction < 2; direction++)
+	{
+		uint32_t from = direction == 0 ? a : b;
+		uint32_t to = direction == 0 ? b : a;
+		if (!CanCollapse(state.vertexKinds, borderEdge, from))
+		{
+			continue;
+		}
+
+		float cost = CollapseCost(state, from, to);
+		if (cost < best.cost)
+		{
+			best = { from, to, cost };
+		}
+	}
+
+	if (best.cost < FLT_MAX)
+	{
+		queue.push(best);
+	}
+}
+
+// Collapse keeps mesh manifold only if the two vertices' only common neighbours are the far corners of their shared triangles
+static bool LinkConditionHolds(const SimplifyState& state, uint32_t from, uint32_t to, uint32_t sharedTriangles,
+	std::vector<uint32_t>& fromNeighbours, std::vector<uint32_t>& toNeighbours)
+{
+	GatherNeighbours(state, from, fromNeighbours);
+	GatherNeighbours(state, to, toNeighbours);
+
+	uint32_t commonNeighbours = 0;
+	for (uint32_t neighbour : fromNeighbours)
+	{
+		if (std::find(toNeighbours.begin(), toNeighbours.end(), neighbour) != toNeighbours.end())
+		{
+			commonNeighbours++;
+		}
+	}
+
+	return commonNeighbours == sharedTriangles;
+}
+
+// Check whether moving vertex from onto vertex to would turn any remaining triangle around it over
+static bool CollapseFlips(const SimplifyState& state, uint32_t from, uint32_t to)
+{
+	const std::vector<Vertex>& vertices = *state.vertices;
+	for (uint32_t triangle : state.vertexTriangles[from])
+	{
+		if (!state.triangleAlive[triangle] || TriangleContains(state, triangle, to))
+		{
+			continue;		// Shared triangles become degenerate and are removed
+		}
+
+		const uint32_t* indices = &state.triangles[triangle * 3];
+		glm::vec3 before[3];
+		glm::vec3 after[3];
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			before[k] = vertices[indices[k]].pos;
+			after[k] = indices[k] == from ? vertices[to].pos : before[k];
+		}
+
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void ApplyCollapse(SimplifyState& state, uint32_t from, uint32_t to)
+{
+	for (uint32_t triangle : state.vertexTriangles[from])
+	{
+		if (!state.triangleAlive[triangle])
+		{
+			continue;
+		}
+
+		if (TriangleContains(state, triangle, to))
+		{
+			state.triangleAlive[triangle] = false;
+			state.liveTriangleCount--;
+			continue;
+		}
+
+		uint32_t* indices = &state.triangles[triangle * 3];
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			if (indices[k] == from)
+			{
+				indices[k] = to;
+			}
+		}
+		state.vertexTriangles[to].push_back(triangle);
+	}
+
+	// Drop dead triangles from surviving vertex's list, so lists don't keep growing as it absorbs neighbours
+	std::vector<uint32_t>& toTriangles = state.vertexTriangles[to];
+	toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&state](uint32_t triangle)
+		{
+			return !state.triangleAlive[triangle];
+		}), toTriangles.end());
+
+	state.vertexTriangles[from].clear();
+	state.vertexAlive[from] = false;
+	AddQuadric(state.quadrics[to], state.quadrics[from]);
+}
+
+// Collapses cheapest edges until target triangle count is reached or no allowed collapse is left
+static void Simplify(SimplifyState& state, CollapseQueue& queue, uint32_t targetTriangleCount, float* error)
+{
+	std::vector<uint32_t> fromNeighbours;
+	std::vector<uint32_t> toNeighbours;
+
+	while (state.liveTriangleCount > targetTriangleCount && !queue.empty())
+	{
+		Collapse collapse = queue.top();
+		queue.pop();
+
+		// Entries aren't removed when the mesh changes around them, so check the edge still exists
+		if (!state.vertexAlive[collapse.from] || !state.vertexAlive[collapse.to])
+		{
+			continue;
+		}
+		uint32_t sharedTriangles = CountSharedTriangles(state, collapse.from, collapse.to);
+		if (sharedTriangles == 0 || !CanCollapse(state.vertexKinds, sharedTriangles == 1, collapse.from))
+		{
+			continue;
+		}
+
+		// Quadrics only ever grow, so a queued cost can only be too low: requeue at the current cost if it went up
+		float cost = CollapseCost(state, collapse.from, collapse.to);
+		if (cost > collapse.cost)
+		{
+			collapse.cost = cost;
+			queue.push(collapse);
+			continue;
+		}
+
+		if (!LinkConditionHolds(state, collapse.from, collapse.to, sharedTriangles, fromNeighbours, toNeighbours) ||
+			CollapseFlips(state, collapse.from, collapse.to))
+		{
+			continue;
+		}
+
+		ApplyCollapse(state, collapse.from, collapse.to);
+		*error = std::max(*error, std::sqrt(cost));
+
+		// Every edge around surviving vertex has a new cost (and some are new edges)
+		GatherNeighbours(state, collapse.to, toNeighbours);
+		for (uint32_t neighbour : toNeighbours)
+		{
+			QueueCollapse(state, queue, collapse.to, neighbour, CountSharedTriangles(state, collapse.to, neighbour) == 1);
+		}
+	}
+}
+
+// -- LOD CHAIN --
+
+std::vector<LodLevel> GenerateLodChain(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t maxLevels)
+{
+	std::vector<LodLevel> levels;
+	std::vector<uint32_t> triangles(indices.begin(), indices.begin() + (indices.size() - indices.size() % 3));
+
+	// Each vertex starts with the planes of its triangles (weighted by area), so collapses are charged for moving surface away from them
+	std::vector<Quadric> quadrics(vertices.size(), Quadric{});
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		const glm::vec3& p0 = vertices[triangles[t]].pos;
+		const glm::vec3& p1 = vertices[triangles[t + 1]].pos;
+		const glm::vec3& p2 = vertices[triangles[t + 2]].pos;
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+		{
+			continue;
+		}
+		normal = normal / length;
+
+		Quadric quadric = PlaneQuadric(normal, -glm::dot(normal, p0), length * 0.5f);
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			AddQuadric(quadrics[triangles[t + k]], quadric);
+		}
+	}
+
+	// Open borders get an extra plane standing up along each border edge, so collapses keep the outline in place
+	std::vector<uint8_t> vertexKinds(vertices.size(), VERTEX_INTERIOR);
+	std::vector<Edge> edges = FindEdges(triangles, vertexKinds);
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t a = triangles[t + k];
+			uint32_t b = triangles[t + (k + 1) % 3];
+			uint64_t key = EdgeKey(a, b);
+
+			auto edge = std::lower_bound(edges.begin(), edges.end(), key, [](const Edge& e, uint64_t value)
+				{
+					return EdgeKey(e.a, e.b) < value;
+				});
+			if (edge == edges.end() || !edge->border)
+			{
+				continue;
+			}
+
+			const glm::vec3& p0 = vertices[triangles[t]].pos;
+			const glm::vec3& p1 = vertices[triangles[t + 1]].pos;
+			const glm::vec3& p2 = vertices[triangles[t + 2]].pos;
+			glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+			glm::vec3 edgeVector = vertices[b].pos - vertices[a].pos;
+
+			glm::vec3 normal = glm::cross(edgeVector, faceNormal);
+			float length = glm::length(normal);
+			if (length == 0.0f)
+			{
+				continue;
+			}
+			normal = normal / length;
+
+			float edgeLengthSquared = glm::dot(edgeVector, edgeVector);
+			Quadric quadric = PlaneQuadric(normal, -glm::dot(normal, vertices[a].pos), edgeLengthSquared * LOD_BORDER_WEIGHT);
+			AddQuadric(quadrics[a], quadric);
+			AddQuadric(quadrics[b], quadric);
+		}
+	}
+
+	SimplifyState state;
+	state.vertices = &vertices;
+	state.triangles = triangles;
+	state.triangleAlive.assign(triangles.size() / 3, true);
+	state.liveTriangleCount = static_cast<uint32_t>(triangles.size() / 3);
+	state.vertexTriangles.resize(vertices.size());
+	state.vertexAlive.assign(vertices.size(), true);
+	state.vertexKinds = vertexKinds;
+	state.quadrics = quadrics;
+
+	for (uint32_t t = 0; t < state.liveTriangleCount; t++)
+	{
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			state.vertexTriangles[triangles[t * 3 + k]].push_back(t);
+		}
+	}
+
+	CollapseQueue queue;
+	for (const Edge& edge : edges)
+	{
+		QueueCollapse(state, queue, edge.a, edge.b, edge.border);
+	}
+
+	// One simplification run for the whole chain, taking a LOD each time a target is reached,
+	// so quadrics (and error) keep accumulating from the full mesh rather than from the previous LOD
+	float error = 0.0f;
+	uint32_t previousTriangleCount = state.liveTriangleCount;
+	while (levels.size() < maxLevels)
+	{
+		uint32_t targetTriangleCount = static_cast<uint32_t>(previousTriangleCount * LOD_REDUCTION);
+		if (targetTriangleCount < LOD_MIN_TRIANGLES)
+		{
+			break;
+		}
+
+		Simplify(state, queue, targetTriangleCount, &error);
+
+		uint32_t triangleCount = state.liveTriangleCount;
+		if (triangleCount > previousTriangleCount * LOD_MIN_REDUCTION)
+		{
+			break;
+		}
+
+		LodLevel level;
+		level.indices.reserve(triangleCount * 3);
+		for (uint32_t t = 0; t < state.triangleAlive.size(); t++)
+		{
+			if (state.triangleAlive[t])
+			{
+				level.indices.insert(level.indices.end(), state.triangles.begin() + t * 3, state.triangles.begin() + t * 3 + 3);
+			}
+		}
+		level.error = error;
+		levels.push_back(level);
+
+		if (triangleCount > targetTriangleCount)
+		{
+			break;		// Simplification got stuck, a further LOD wouldn't get any smaller
+		}
+		previousTriangleCount = triangleCount;
+	}
+
+	return levels;
+}
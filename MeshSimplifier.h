@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include "Utilities.h"
+
+const float LOD_REDUCTION = 0.5f;				// Each LOD aims for this fraction of the previous LOD's triangles
+const float LOD_MIN_REDUCTION = 0.85f;			// LOD that keeps more than this fraction of previous LOD's triangles isn't worth storing
+const uint32_t LOD_MIN_TRIANGLES = 32;			// Chain stops before a LOD would drop below this many triangles
+const float LOD_BORDER_WEIGHT = 10.0f;			// How strongly open borders of a mesh are kept in place
+
+// Simplified index buffer of a mesh, indexing the same vertices as the full mesh
+struct LodLevel
+{
+	std::vector<uint32_t> indices;
+	float error = 0.0f;		// Estimated distance (mesh units) simplified surface has moved from full mesh (quadric error, accumulated)
+};
+
+// Builds a chain of ever coarser index buffers by collapsing edges with lowest quadric error (Garland-Heckbert)
+// Vertices are collapsed onto one of their neighbours rather than moved, so every LOD can share the full mesh's vertex buffer
+// Returns up to maxLevels LODs after the full mesh (LOD 0 isn't included), each with its error
+std::vector<LodLevel> GenerateLodChain(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t maxLevels);
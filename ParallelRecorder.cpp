@@ -0,0 +1,213 @@
+#include "ParallelRecorder.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+ParallelRecorder::ParallelRecorder()
+{
+}
+
+void ParallelRecorder::Init(VkDevice newDevice, uint32_t queueFamilyIndex, uint32_t workerCount, uint32_t newSlotCount)
+{
+	device = newDevice;
+	slotCount = newSlotCount;
+
+	// Workers must not move once threads hold references to them, so size the list before starting any
+	workers = std::vector<Worker>(std::max(workerCount, 1u));
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;		// Buffers are re-recorded often, and reset all together by resetting the pool
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+	VkCommandBufferAllocateInfo cbAllocInfo = {};
+	cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;		// Executed from primary buffer with vkCmdExecuteCommands
+	cbAllocInfo.commandBufferCount = 1;
+
+	for (auto& worker : workers)
+	{
+		worker.commandPools.resize(slotCount);
+		worker.commandBuffers.resize(slotCount);
+
+		for (uint32_t i = 0; i < slotCount; i++)
+		{
+			VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &worker.commandPools[i]);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a Worker Command Pool!");
+			}
+
+			cbAllocInfo.commandPool = worker.commandPools[i];
+			result = vkAllocateCommandBuffers(device, &cbAllocInfo, &worker.commandBuffers[i]);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate a Secondary Command Buffer!");
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].thread = std::thread(&ParallelRecorder::WorkerLoop, this, i);
+	}
+}
+
+uint32_t ParallelRecorder::GetActiveWorkerCount(uint32_t itemCount)
+{
+	// Enough workers that each has at least MIN_ITEMS_PER_WORKER items (but always one, even with no items)
+	uint32_t wanted = (itemCount + MIN_ITEMS_PER_WORKER - 1) / MIN_ITEMS_PER_WORKER;
+	return std::max(1u, std::min(wanted, static_cast<uint32_t>(workers.size())));
+}
+
+std::vector<VkCommandBuffer> ParallelRecorder::Record(uint32_t slot, const VkCommandBufferInheritanceInfo& inheritanceInfo,
+	uint32_t itemCount, const RecordFunction& recordFunction)
+{
+	uint32_t activeWorkers = GetActiveWorkerCount(itemCount);
+	uint32_t sliceSize = (itemCount + activeWorkers - 1) / activeWorkers;
+
+	// Hand each active worker a contiguous slice of items
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		currentInheritance = &inheritanceInfo;
+		currentFunction = &recordFunction;
+		workerError.clear();
+
+		for (uint32_t i = 0; i < activeWorkers; i++)
+		{
+			Worker& worker = workers[i];
+			worker.slot = slot;
+			worker.firstItem = std::min(i * sliceSize, itemCount);
+			worker.itemCount = std::min(sliceSize, itemCount - worker.firstItem);
+			worker.hasJob = true;
+		}
+		pendingJobs = activeWorkers;
+	}
+	jobReady.notify_all();
+
+	// Wait for every slice to be recorded
+	std::unique_lock<std::mutex> lock(mutex);
+	jobsDone.wait(lock, [this]() { return pendingJobs == 0; });
+
+	currentInheritance = nullptr;
+	currentFunction = nullptr;
+
+	if (!workerError.empty())
+	{
+		throw std::runtime_error(workerError);
+	}
+
+	// Secondary buffers in worker order, so draws keep the same order as the items
+	std::vector<VkCommandBuffer> secondaryBuffers;
+	for (uint32_t i = 0; i < activeWorkers; i++)
+	{
+		secondaryBuffers.push_back(workers[i].commandBuffers[slot]);
+	}
+
+	return secondaryBuffers;
+}
+
+void ParallelRecorder::ResetSlot(uint32_t slot)
+{
+	// Slot's buffers must no longer be in use by the GPU (caller has waited on the slot's fence)
+	for (auto& worker : workers)
+	{
+		vkResetCommandPool(device, worker.commandPools[slot], 0);
+	}
+}
+
+void ParallelRecorder::Destroy()
+{
+	// Wake all workers and let them exit
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+
+	for (auto& worker : workers)
+	{
+		if (worker.thread.joinable())
+		{
+			worker.thread.join();
+		}
+
+		// Destroying pool frees its command buffers too
+		for (auto commandPool : worker.commandPools)
+		{
+			vkDestroyCommandPool(device, commandPool, nullptr);
+		}
+	}
+	workers.clear();
+	stopping = false;
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+}
+
+void ParallelRecorder::WorkerLoop(uint32_t workerIndex)
+{
+	Worker& worker = workers[workerIndex];
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobReady.wait(lock, [this, &worker]() { return stopping || worker.hasJob; });
+			if (stopping)
+			{
+				return;
+			}
+		}
+
+		// Record without holding lock, so workers run in parallel
+		std::string error;
+		try
+		{
+			RecordSlice(workerIndex);
+		}
+		catch (const std::runtime_error& e)
+		{
+			error = e.what();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error.empty() && workerError.empty())
+			{
+				workerError = error;
+			}
+			worker.hasJob = false;
+			pendingJobs--;
+		}
+		jobsDone.notify_one();
+	}
+}
+
+void ParallelRecorder::RecordSlice(uint32_t workerIndex)
+{
+	Worker& worker = workers[workerIndex];
+	VkCommandBuffer commandBuffer = worker.commandBuffers[worker.slot];
+
+	// Secondary buffer runs entirely inside render pass given by inheritance info
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = currentInheritance;
+
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording a Secondary Command Buffer!");
+	}
+
+	(*currentFunction)(commandBuffer, workerIndex, worker.firstItem, worker.itemCount);
+
+	result = vkEndCommandBuffer(commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording a Secondary Command Buffer!");
+	}
+}
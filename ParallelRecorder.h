@@ -0,0 +1,67 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+const uint32_t MIN_ITEMS_PER_WORKER = 32;		// Don't wake another worker for fewer draws than this
+
+// Records a slice of items into the secondary command buffer it was given (commandBuffer, workerIndex, firstItem, itemCount)
+using RecordFunction = std::function<void(VkCommandBuffer, uint32_t, uint32_t, uint32_t)>;
+
+// Pool of worker threads that record secondary command buffers in parallel
+// Every worker has its own command pool for each slot, so no two threads ever record from the same pool
+class ParallelRecorder
+{
+public:
+	ParallelRecorder();
+
+	void Init(VkDevice newDevice, uint32_t queueFamilyIndex, uint32_t workerCount, uint32_t newSlotCount);
+
+	uint32_t GetActiveWorkerCount(uint32_t itemCount);
+	std::vector<VkCommandBuffer> Record(uint32_t slot, const VkCommandBufferInheritanceInfo& inheritanceInfo,
+		uint32_t itemCount, const RecordFunction& recordFunction);
+	void ResetSlot(uint32_t slot);
+
+	void Destroy();
+
+	~ParallelRecorder();
+
+private:
+	struct Worker
+	{
+		std::thread thread;
+		std::vector<VkCommandPool> commandPools;		// One per slot
+		std::vector<VkCommandBuffer> commandBuffers;	// Secondary buffer allocated from each slot's pool
+
+		// Current job
+		bool hasJob = false;
+		uint32_t slot = 0;
+		uint32_t firstItem = 0;
+		uint32_t itemCount = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t slotCount = 0;
+
+	std::vector<Worker> workers;
+
+	// - Job State (guarded by mutex)
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobsDone;
+	uint32_t pendingJobs = 0;
+	bool stopping = false;
+	std::string workerError;								// First error thrown by a worker during current Record call
+	const VkCommandBufferInheritanceInfo* currentInheritance = nullptr;
+	const RecordFunction* currentFunction = nullptr;
+
+	void WorkerLoop(uint32_t workerIndex);
+	void RecordSlice(uint32_t workerIndex);
+};
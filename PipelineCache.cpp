@@ -0,0 +1,190 @@
+#include "PipelineCache.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include "Utilities.h"
+
+PipelineCache::PipelineCache()
+{
+}
+
+void PipelineCache::Init(VkPhysicalDevice physicalDevice, VkDevice newDevice, const std::string& newPath)
+{
+	device = newDevice;
+	path = newPath;
+
+	auto loadStart = std::chrono::steady_clock::now();
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	// Only hand saved data to the driver if it was written for this exact device and driver
+	// File is mapped, so data goes to the driver straight from mapped pages
+	MappedFile cacheFile;
+	FileSpan data;
+	if (!path.empty() && LoadFile(cacheFile))
+	{
+		if (IsHeaderValid(cacheFile.GetSpan(), deviceProperties))
+		{
+			data = cacheFile.GetSpan();
+			warm = true;
+		}
+		else
+		{
+			printf("Pipeline cache %s is from another device or driver, discarding it\n", path.c_str());
+		}
+	}
+
+	VkPipelineCacheCreateInfo cacheCreateInfo = {};
+	cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheCreateInfo.initialDataSize = data.size;
+	cacheCreateInfo.pInitialData = data.data;
+
+	VkResult result = vkCreatePipelineCache(device, &cacheCreateInfo, nullptr, &cache);
+	if (result != VK_SUCCESS && warm)
+	{
+		// Driver still refused data, so start with an empty cache rather than failing
+		warm = false;
+		cacheCreateInfo.initialDataSize = 0;
+		cacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(device, &cacheCreateInfo, nullptr, &cache);
+	}
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Pipeline Cache!");
+	}
+
+	loadTime = ElapsedMilliseconds(loadStart, std::chrono::steady_clock::now());
+}
+
+VkPipelineCache PipelineCache::GetCache()
+{
+	return cache;
+}
+
+bool PipelineCache::IsWarm()
+{
+	return warm;
+}
+
+double PipelineCache::GetLoadTime()
+{
+	return loadTime;
+}
+
+void PipelineCache::Save()
+{
+	if (path.empty() || cache == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// Ask for size first, then the data itself
+	size_t dataSize = 0;
+	VkResult result = vkGetPipelineCacheData(device, cache, &dataSize, nullptr);
+	if (result != VK_SUCCESS || dataSize == 0)
+	{
+		return;
+	}
+
+	std::vector<char> data(dataSize);
+	result = vkGetPipelineCacheData(device, cache, &dataSize, data.data());
+	if (result != VK_SUCCESS)
+	{
+		return;
+	}
+	data.resize(dataSize);
+
+	// A cache that can't be saved only costs compile time next run, so it isn't an error
+	if (!WriteFile(data))
+	{
+		printf("Failed to save pipeline cache to %s\n", path.c_str());
+	}
+}
+
+void PipelineCache::Destroy()
+{
+	vkDestroyPipelineCache(device, cache, nullptr);
+	cache = VK_NULL_HANDLE;
+}
+
+PipelineCache::~PipelineCache()
+{
+}
+
+bool PipelineCache::LoadFile(MappedFile& file)
+{
+	// Missing file is normal (first run), so no error
+	try
+	{
+		file = MappedFile(path);
+	}
+	catch (const std::runtime_error&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool PipelineCache::IsHeaderValid(const FileSpan& data, const VkPhysicalDeviceProperties& deviceProperties)
+{
+	// Every pipeline cache starts with the same header, identifying the device and driver that created it
+	VkPipelineCacheHeaderVersionOne header;
+	if (data.size < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, data.data, sizeof(header));
+
+	return header.headerSize >= sizeof(header) && header.headerSize <= data.size
+		&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& header.vendorID == deviceProperties.vendorID
+		&& header.deviceID == deviceProperties.deviceID
+		&& memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool PipelineCache::WriteFile(const std::vector<char>& data)
+{
+	// Write everything to a temporary file first, then swap it in with a single rename,
+	// so a crash mid write leaves the old cache (or none) instead of a truncated one
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file.write(data.data(), data.size());
+		file.flush();
+		if (!file)
+		{
+			file.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	// std::rename won't replace an existing file on Windows
+	bool renamed = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool renamed = std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+	if (!renamed)
+	{
+		std::remove(tempPath.c_str());
+	}
+
+	return renamed;
+}
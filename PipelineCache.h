@@ -0,0 +1,42 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+
+#include "MappedFile.h"
+
+const char* const DEFAULT_PIPELINE_CACHE_PATH = "pipeline_cache.bin";		// Saved next to the executable's working directory
+
+// VkPipelineCache kept on disk between runs, so pipelines compiled once don't need compiling again at startup
+// Saved data is only used if its header matches the current device and driver, anything else starts an empty cache
+class PipelineCache
+{
+public:
+	PipelineCache();
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice newDevice, const std::string& newPath);
+
+	VkPipelineCache GetCache();
+	bool IsWarm();
+	double GetLoadTime();
+
+	void Save();
+	void Destroy();
+
+	~PipelineCache();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	std::string path;						// Empty means cache is never loaded or saved
+
+	bool warm = false;						// Cache started with valid data from disk
+	double loadTime = 0.0;					// Time taken to read file and create cache (milliseconds)
+
+	bool LoadFile(MappedFile& file);
+	bool IsHeaderValid(const FileSpan& data, const VkPhysicalDeviceProperties& deviceProperties);
+	bool WriteFile(const std::vector<char>& data);
+};
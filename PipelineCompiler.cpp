@@ -0,0 +1,446 @@
+#include "PipelineCompiler.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+PipelineCompiler::PipelineCompiler()
+{
+}
+
+void PipelineCompiler::Init(VkDevice newDevice, VkPipelineCache newCache, uint32_t threadCount)
+{
+	device = newDevice;
+	cache = newCache;
+
+	threadCount = std::max(1u, std::min(threadCount, MAX_PIPELINE_COMPILE_THREADS));
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		threads.push_back(std::thread(&PipelineCompiler::WorkerLoop, this));
+	}
+}
+
+PipelineHandle PipelineCompiler::SubmitGraphics(const GraphicsPipelineDescription& description, PipelineHandle fallback)
+{
+	Job job;
+	job.graphics = description;
+	job.fallback = fallback;
+
+	return Submit(job);
+}
+
+PipelineHandle PipelineCompiler::SubmitCompute(const ComputePipelineDescription& description)
+{
+	Job job;
+	job.compute = true;
+	job.computeDescription = description;
+
+	return Submit(job);
+}
+
+VkPipeline PipelineCompiler::GetPipeline(PipelineHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Follow fallbacks until a ready pipeline is found (fallbacks are always submitted before pipelines naming them)
+	while (handle != INVALID_PIPELINE_HANDLE)
+	{
+		Job& job = jobs[handle];
+		if (job.state == JOB_STATE_READY)
+		{
+			return job.pipeline;
+		}
+
+		// A pipeline the renderer can't do without has failed, so stop as a synchronous compile would have
+		if (job.state == JOB_STATE_FAILED)
+		{
+			std::string name = job.compute ? job.computeDescription.name : job.graphics.name;
+			bool optional = job.compute ? job.computeDescription.optional : job.graphics.optional;
+			if (!optional)
+			{
+				throw std::runtime_error(name + " Pipeline: " + job.error);
+			}
+
+			if (!job.errorReported)
+			{
+				printf("%s pipeline not created (%s)\n", name.c_str(), job.error.c_str());
+				job.errorReported = true;
+			}
+		}
+
+		handle = job.fallback;
+	}
+
+	return VK_NULL_HANDLE;
+}
+
+bool PipelineCompiler::IsReady(PipelineHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return handle != INVALID_PIPELINE_HANDLE && jobs[handle].state == JOB_STATE_READY;
+}
+
+bool PipelineCompiler::IsFinished(PipelineHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return handle == INVALID_PIPELINE_HANDLE || IsJobFinished(jobs[handle]);
+}
+
+uint32_t PipelineCompiler::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pendingJobs;
+}
+
+double PipelineCompiler::GetCompileTime(PipelineHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return handle != INVALID_PIPELINE_HANDLE ? jobs[handle].compileTime : 0.0;
+}
+
+void PipelineCompiler::Wait(PipelineHandle handle)
+{
+	if (handle == INVALID_PIPELINE_HANDLE)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	jobFinished.wait(lock, [this, handle]() { return IsJobFinished(jobs[handle]); });
+}
+
+void PipelineCompiler::WaitAll()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobFinished.wait(lock, [this]() { return pendingJobs == 0; });
+}
+
+void PipelineCompiler::Destroy()
+{
+	// Let workers finish what they're compiling, then exit (anything still queued is dropped)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+	jobQueued.notify_all();
+
+	for (auto& thread : threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+	threads.clear();
+
+	for (auto& job : jobs)
+	{
+		if (job.pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(device, job.pipeline, nullptr);
+		}
+	}
+	jobs.clear();
+	pendingJobs = 0;
+	stopping = false;
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+}
+
+PipelineHandle PipelineCompiler::Submit(const Job& job)
+{
+	PipelineHandle handle;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		handle = static_cast<PipelineHandle>(jobs.size());
+		jobs.push_back(job);
+		queue.push_back(handle);
+		pendingJobs++;
+	}
+	jobQueued.notify_one();
+
+	return handle;
+}
+
+void PipelineCompiler::WorkerLoop()
+{
+	while (true)
+	{
+		// Take a copy of the next description, so jobs list can grow while it compiles
+		Job job;
+		PipelineHandle handle;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobQueued.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			handle = queue.front();
+			queue.pop_front();
+			jobs[handle].state = JOB_STATE_COMPILING;
+			job = jobs[handle];
+		}
+
+		// Compile without holding lock, so workers (and lookups from render thread) run in parallel
+		auto compileStart = std::chrono::steady_clock::now();
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::string error;
+		try
+		{
+			pipeline = job.compute ? CompileCompute(job.computeDescription) : CompileGraphics(job.graphics);
+		}
+		catch (const std::runtime_error& e)
+		{
+			error = e.what();
+		}
+		double compileTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			Job& finishedJob = jobs[handle];
+			finishedJob.pipeline = pipeline;
+			finishedJob.error = error;
+			finishedJob.state = error.empty() ? JOB_STATE_READY : JOB_STATE_FAILED;
+			finishedJob.compileTime = compileTime;
+			pendingJobs--;
+		}
+		jobFinished.notify_all();
+	}
+}
+
+VkPipeline PipelineCompiler::CompileGraphics(const GraphicsPipelineDescription& description)
+{
+	// Map in SPIR-V code of shaders (unmapped when files go out of scope)
+	MappedFile vertexShaderFile(description.vertexShaderPath);
+	MappedFile fragmentShaderFile;
+	if (!description.fragmentShaderPath.empty())
+	{
+		fragmentShaderFile = MappedFile(description.fragmentShaderPath);
+	}
+
+	// -- SHADER STAGE CREATION INFORMATION --
+	// Build Shader Modules to link to Graphics Pipeline, straight from mapped pages
+	// Depth only pipelines have just the vertex stage
+	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+
+	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
+	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;				// Shader Stage name
+	vertexShaderCreateInfo.module = CreateShaderModule(vertexShaderFile.GetSpan());	// Shader module to be used by stage
+	vertexShaderCreateInfo.pName = "main";									// Entry point in to shader
+	shaderStages.push_back(vertexShaderCreateInfo);
+
+	if (fragmentShaderFile.IsOpen())
+	{
+		VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
+		fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragmentShaderCreateInfo.pName = "main";
+		try
+		{
+			fragmentShaderCreateInfo.module = CreateShaderModule(fragmentShaderFile.GetSpan());
+		}
+		catch (const std::runtime_error&)
+		{
+			vkDestroyShaderModule(device, vertexShaderCreateInfo.module, nullptr);
+			throw;
+		}
+		shaderStages.push_back(fragmentShaderCreateInfo);
+	}
+
+	// -- VERTEX INPUT --
+	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(description.bindings.size());
+	vertexInputCreateInfo.pVertexBindingDescriptions = description.bindings.data();				// List of Vertex Binding Descriptions (data spacing/stride information)
+	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.attributes.size());
+	vertexInputCreateInfo.pVertexAttributeDescriptions = description.attributes.data();			// List of Vertex Attribute Decription (data format and where to bind to/from)
+
+	// -- INPUT ASSEMBLY --
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;		// Primitive type to assemble vertices as
+	inputAssembly.primitiveRestartEnable = VK_FALSE;					// Allow overrinding of 'strip' topology to start new primitives
+
+	// -- VIEWPORT & SCISSOR
+	// Create a viewport info struct
+	VkViewport viewport = {};
+	viewport.x = 0.0f;													// x start coordinate
+	viewport.y = 0.0f;													// y start coordinate
+	viewport.width = static_cast<float>(description.extent.width);		// width of viewport
+	viewport.height = static_cast<float>(description.extent.height);	// height of viewport
+	viewport.minDepth = 0.0f;											// min framebuffer depth
+	viewport.maxDepth = 1.0f;											// max framebuffer depth
+
+	// Create a scissor info struct
+	VkRect2D scissor = {};
+	scissor.offset = { 0,0 };					// Offset to use region from
+	scissor.extent = description.extent;		// Extent to describe region to use, starting at offset
+
+	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
+	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportStateCreateInfo.viewportCount = 1;
+	viewportStateCreateInfo.pViewports = &viewport;
+	viewportStateCreateInfo.scissorCount = 1;
+	viewportStateCreateInfo.pScissors = &scissor;
+
+	// -- RASTERIZER --
+	VkPipelineRasterizationStateCreateInfo rasterizeCreateInfo = {};
+	rasterizeCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizeCreateInfo.depthClampEnable = VK_FALSE;			// Change if fragments beyond near/far planes are clipped (default) or clamped to plane
+	rasterizeCreateInfo.rasterizerDiscardEnable = VK_FALSE;		// Whether to discard data and skip rasterizer. Never creates fragments, only suitable for pipeline without framebuffer output
+	rasterizeCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;		// How to handle filling points between vertices
+	rasterizeCreateInfo.lineWidth = 1.0f;						// How thick lines should be when drawn
+	rasterizeCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;		// Which face of a triangle to cull
+	rasterizeCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;	// Winding to determine which side is front
+	rasterizeCreateInfo.depthBiasClamp = VK_FALSE;				// Whether to add depth bias to fragments (good for stopping "shadow acne" in shadow mapping)
+
+	// -- MULTISAMPLING --
+	VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {};
+	multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleCreateInfo.sampleShadingEnable = VK_FALSE;					// Enable multisample shading or not
+	multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;		// Number of sample to use per fragment
+
+	// -- BLENDING --
+	// Blending decides how to blend a new colour being written to a fragment, with the old value
+
+	// Blend Attachment State (how blending is handle)
+	VkPipelineColorBlendAttachmentState colourState = {};
+	colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;		// Colours to apply blending to
+	colourState.blendEnable = VK_TRUE;								// Enable blending
+
+	// Blending uses equation: (srcColorBlendFactor * new colour) colorBlendOp (dstColorBlendFactor * old colour)
+	colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colourState.colorBlendOp = VK_BLEND_OP_ADD;
+
+	// Summarised: (VK_BLEND_FACTOR_SRC_ALPHA * new colour) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_APLHA * old colour)
+	//			   (new colour alpha * new colour) + ((1 - new colour alpha) * old colour)
+
+	colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
+	colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colourState.alphaBlendOp = VK_BLEND_OP_ADD;
+	// Summarised: (1 * new alpha) + (0 * old alpha) = new alpha
+
+	// Without a fragment shader, colour attachment is still part of subpass, but left untouched
+	if (!fragmentShaderFile.IsOpen())
+	{
+		colourState.colorWriteMask = 0;
+		colourState.blendEnable = VK_FALSE;
+	}
+
+	VkPipelineColorBlendStateCreateInfo colourBlendingCreateInfo = {};
+	colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colourBlendingCreateInfo.logicOpEnable = VK_FALSE;			// Alternative to calculations is to use logical operations
+	colourBlendingCreateInfo.attachmentCount = 1;
+	colourBlendingCreateInfo.pAttachments = &colourState;
+
+	// -- DEPTH STENCIL TESTING --
+	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilCreateInfo.depthTestEnable = VK_TRUE;											// Enable checking depth to determine fragment write
+	depthStencilCreateInfo.depthWriteEnable = description.depthWrite ? VK_TRUE : VK_FALSE;		// Enable writing to depth buffer (to replace old values)
+	depthStencilCreateInfo.depthCompareOp = description.depthCompareOp;							// Comparison operation that allows an overwrite
+	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;									// Depth Bounds Test: Does the depth value exist between two bounds
+	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;										// Enable Stencil Test
+
+	// -- GRAPHICS PIPELINE CREATION --
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());	// Number of shader stages
+	pipelineCreateInfo.pStages = shaderStages.data();							// List of shader stages
+	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;				// All the fixed functions pipeline states
+	pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+	pipelineCreateInfo.pDynamicState = nullptr;
+	pipelineCreateInfo.pRasterizationState = &rasterizeCreateInfo;
+	pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+	pipelineCreateInfo.layout = description.layout;								// Pipeline Layout pipeline should use
+	pipelineCreateInfo.renderPass = description.renderPass;						// Render pass description the pipeline is compatible with
+	pipelineCreateInfo.subpass = description.subpass;							// Subpass of render pass to use with pipeline
+
+	// Pipeline Derivatives : Can create multiple pipeline that derive from one another for optimisation
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;		// Existing pipeline to derive from...
+	pipelineCreateInfo.basePipelineIndex = -1;					// or index of pipeline being created to derive from (in case creating multiple at once)
+
+	// Create Graphics Pipeline
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateGraphicsPipelines(device, cache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+
+	// Destroy Shader Modules, no longer needed after Pipeline created
+	for (const auto& stage : shaderStages)
+	{
+		vkDestroyShaderModule(device, stage.module, nullptr);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a " + description.name + " Pipeline!");
+	}
+
+	return pipeline;
+}
+
+VkPipeline PipelineCompiler::CompileCompute(const ComputePipelineDescription& description)
+{
+	MappedFile shaderFile(description.shaderPath);
+
+	// -- SHADER STAGE --
+	VkPipelineShaderStageCreateInfo shaderCreateInfo = {};
+	shaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shaderCreateInfo.module = CreateShaderModule(shaderFile.GetSpan());
+	shaderCreateInfo.pName = "main";
+
+	// -- COMPUTE PIPELINE CREATION --
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage = shaderCreateInfo;
+	pipelineCreateInfo.layout = description.layout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateComputePipelines(device, cache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+
+	// Destroy shader module, no longer needed after pipeline created
+	vkDestroyShaderModule(device, shaderCreateInfo.module, nullptr);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a " + description.name + " Pipeline!");
+	}
+
+	return pipeline;
+}
+
+VkShaderModule PipelineCompiler::CreateShaderModule(const FileSpan& code)
+{
+	// Shader Module creation information
+	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = code.size;										// Size of code
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data);		// Pointer to code (of uint32_t pointer type, mapped pages are page aligned)
+
+	VkShaderModule shaderModule;
+	VkResult result = vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a shader module!");
+	}
+
+	return shaderModule;
+}
+
+bool PipelineCompiler::IsJobFinished(const Job& job)
+{
+	return job.state == JOB_STATE_READY || job.state == JOB_STATE_FAILED;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "MappedFile.h"
+
+const uint32_t MAX_PIPELINE_COMPILE_THREADS = 4;		// Pipelines are few, so more threads would mostly sit idle
+
+// Pipeline compiled in the background, looked up through the compiler it was submitted to
+using PipelineHandle = uint32_t;
+const PipelineHandle INVALID_PIPELINE_HANDLE = 0xFFFFFFFF;
+
+// Everything needed to compile a graphics pipeline, owned by the description so it can be compiled on another thread
+// Fixed function state not listed here is the same for every pipeline of the renderer
+struct GraphicsPipelineDescription
+{
+	std::string name;													// Shown in logs and errors
+	std::string vertexShaderPath;
+	std::string fragmentShaderPath;										// Empty for depth only pipelines (colour attachment left untouched)
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+	VkExtent2D extent = {};												// Viewport and scissor size
+	bool depthWrite = true;
+	VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+	bool optional = false;												// Failing leaves pipeline null instead of throwing
+};
+
+struct ComputePipelineDescription
+{
+	std::string name;
+	std::string shaderPath;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	bool optional = false;
+};
+
+// Compiles pipelines on worker threads, so creating them never blocks startup or a frame
+// Every pipeline goes through the same VkPipelineCache (pipeline creation may use a cache from several threads at once)
+// Until a pipeline is ready, lookups give its fallback pipeline if one was named (and is ready), otherwise null
+// Compiled pipelines are owned by the compiler and destroyed with it
+class PipelineCompiler
+{
+public:
+	PipelineCompiler();
+
+	void Init(VkDevice newDevice, VkPipelineCache newCache, uint32_t threadCount);
+
+	PipelineHandle SubmitGraphics(const GraphicsPipelineDescription& description, PipelineHandle fallback = INVALID_PIPELINE_HANDLE);
+	PipelineHandle SubmitCompute(const ComputePipelineDescription& description);
+
+	VkPipeline GetPipeline(PipelineHandle handle);
+	bool IsReady(PipelineHandle handle);
+	bool IsFinished(PipelineHandle handle);
+	uint32_t GetPendingCount();
+	double GetCompileTime(PipelineHandle handle);
+	void Wait(PipelineHandle handle);
+	void WaitAll();
+
+	void Destroy();
+
+	~PipelineCompiler();
+
+private:
+	enum JobState
+	{
+		JOB_STATE_QUEUED = 0,
+		JOB_STATE_COMPILING = 1,
+		JOB_STATE_READY = 2,
+		JOB_STATE_FAILED = 3,
+	};
+
+	struct Job
+	{
+		bool compute = false;
+		GraphicsPipelineDescription graphics;
+		ComputePipelineDescription computeDescription;
+		PipelineHandle fallback = INVALID_PIPELINE_HANDLE;
+
+		JobState state = JOB_STATE_QUEUED;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::string error;
+		bool errorReported = false;						// Failure of optional pipeline has been logged
+		double compileTime = 0.0;						// Milliseconds taken by worker (0 until finished)
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+
+	std::vector<std::thread> threads;
+
+	// - Job State (guarded by mutex)
+	std::mutex mutex;
+	std::condition_variable jobQueued;
+	std::condition_variable jobFinished;
+	std::vector<Job> jobs;								// Indexed by handle
+	std::deque<PipelineHandle> queue;					// Jobs no worker has taken yet, oldest first
+	uint32_t pendingJobs = 0;							// Queued or compiling
+	bool stopping = false;
+
+	PipelineHandle Submit(const Job& job);
+	void WorkerLoop();
+	VkPipeline CompileGraphics(const GraphicsPipelineDescription& description);
+	VkPipeline CompileCompute(const ComputePipelineDescription& description);
+	VkShaderModule CreateShaderModule(const FileSpan& code);
+	bool IsJobFinished(const Job& job);
+};
@@ -1,3 +1,5 @@
 C:/VulkanSDK/1.2.176.1/Bin/glslangValidator.exe -V shader.vert
 C:/VulkanSDK/1.2.176.1/Bin/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.2.176.1/Bin/glslangValidator.exe -V depth.vert -o depth.spv
+C:/VulkanSDK/1.2.176.1/Bin/glslangValidator.exe -V cull.comp -o cull.spv
 pause
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 450
+
+// Depth pre-pass: position only, with no fragment shader, laying down depth for colour pass to test against
+
+layout(location = 0) in vec3 pos;
+layout(location = 2) in mat4 model;		// Per instance transform (binding 1, takes locations 2-5)
+
+layout(set = 0, binding = 0) uniform FrameUniforms {
+	mat4 viewProjection;
+	uint materialBufferIndex;			// Bindless index of this frame's material table
+} frameUniforms;						// Per frame data, at a dynamic offset into frame's uniform region
+
+layout(push_constant) uniform DrawPushConstants {
+	mat4 meshTransform;
+} drawPushConstants;					// Per draw data, pushed with each draw
+
+invariant gl_Position;					// Must match colour pass vertex shader exactly (colour pass tests depth EQUAL)
+
+void main(){
+	gl_Position = frameUniforms.viewProjection * drawPushConstants.meshTransform * model * vec4(pos, 1.0);
+}
\ No newline at end of file
@@ -1,9 +1,29 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragCol;
+layout(location = 1) flat in uint fragMaterial;
 
 layout(location = 0) out vec4 outColour;	// Final output colour (must also have loaction)
 
+struct Material {
+	vec4 baseColour;
+	uint baseColourTexture;				// Bindless texture index (0xFFFFFFFF for none)
+};
+
+layout(set = 0, binding = 0) uniform FrameUniforms {
+	mat4 viewProjection;
+	uint materialBufferIndex;			// Bindless index of this frame's material table
+} frameUniforms;
+
+// Bindless set: every storage buffer and texture the renderer has registered, picked by index
+layout(set = 1, binding = 0) readonly buffer MaterialTable {
+	Material materials[];
+} storageBuffers[];
+layout(set = 1, binding = 1) uniform sampler2D textures[];	// Not sampled yet: vertices have no UVs, so streamed mips aren't drawn
+
 void main(){
-	outColour = vec4(fragCol, 1.0);
+	Material material = storageBuffers[frameUniforms.materialBufferIndex].materials[fragMaterial];
+
+	outColour = vec4(fragCol, 1.0) * material.baseColour;
 }
\ No newline at end of file
@@ -2,11 +2,26 @@
 
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 col;
+layout(location = 2) in mat4 model;		// Per instance transform (binding 1, takes locations 2-5)
+layout(location = 6) in uint materialIndex;	// Per instance index into material table
 
 layout(location = 0) out vec3 fragCol;
+layout(location = 1) flat out uint fragMaterial;
+
+layout(set = 0, binding = 0) uniform FrameUniforms {
+	mat4 viewProjection;
+	uint materialBufferIndex;			// Bindless index of this frame's material table
+} frameUniforms;						// Per frame data, at a dynamic offset into frame's uniform region
+
+layout(push_constant) uniform DrawPushConstants {
+	mat4 meshTransform;
+} drawPushConstants;					// Per draw data, pushed with each draw
+
+invariant gl_Position;					// Depth pre-pass computes position the same way, so depths compare equal
 
 void main(){
-	gl_Position = vec4(pos, 1.0);
+	gl_Position = frameUniforms.viewProjection * drawPushConstants.meshTransform * model * vec4(pos, 1.0);
 	
 	fragCol = col;
+	fragMaterial = materialIndex;
 }
\ No newline at end of file
@@ -0,0 +1,782 @@
+#include "TextureStreamer.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+TextureStreamer::TextureStreamer()
+{
+}
+
+void TextureStreamer::Init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, DeviceAllocator* newAllocator, BindlessDescriptors* newBindlessDescriptors,
+	uint32_t graphicsFamily, bool newMemoryBudgetSupported, VkDeviceSize newUploadLimit)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	allocator = newAllocator;
+	bindlessDescriptors = newBindlessDescriptors;
+	memoryBudgetSupported = newMemoryBudgetSupported;
+	uploadLimit = std::max(newUploadLimit, MIN_TEXTURE_UPLOAD_LIMIT);
+
+	// Staged rows are placed at offsets the device copies from fastest (always a multiple of texel size)
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	copyAlignment = std::max<VkDeviceSize>(deviceProperties.limits.optimalBufferCopyOffsetAlignment, 16);
+
+	// Budget is kept for the largest device local heap, which is where images end up
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+			memoryProperties.memoryHeaps[i].size > memoryProperties.memoryHeaps[budgetHeap].size)
+		{
+			budgetHeap = i;
+		}
+	}
+
+	// SAMPLER
+	// Shared by every texture, trilinear across whatever mips are resident
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;						// Image view decides which mips there are
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+	VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Texture Sampler!");
+	}
+
+	// UPLOAD
+	// Command buffers are re-recorded every frame something is streaming, so they're reset individually
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = graphicsFamily;
+
+	result = vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Texture Streaming Command Pool!");
+	}
+
+	commandBuffers.resize(MAX_FRAME_DRAWS);
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+	result = vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data());
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Texture Streaming Command Buffers!");
+	}
+
+	// A frame's staging buffer is free again once its fence has signalled, so the upload limit is also the staging size
+	stagingBuffers.resize(MAX_FRAME_DRAWS);
+	stagingBufferAllocations.resize(MAX_FRAME_DRAWS);
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		CreateBuffer(device, allocator, uploadLimit, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffers[i], &stagingBufferAllocations[i], MEMORY_TAG_STAGING);
+	}
+}
+
+int TextureStreamer::CreateTexture(uint32_t width, uint32_t height, const void* pixels)
+{
+	if (width == 0 || height == 0 || width > MAX_TEXTURE_SIZE || height > MAX_TEXTURE_SIZE)
+	{
+		throw std::runtime_error("Failed to create Texture, size must be between 1 and MAX_TEXTURE_SIZE!");
+	}
+
+	// MIP CHAIN
+	// Each level is box filtered from the one above it, down to 1x1
+	Texture texture;
+	VkDeviceSize chainSize = 0;
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+	while (true)
+	{
+		MipLevel level = {};
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.offset = chainSize;
+		level.size = static_cast<VkDeviceSize>(levelWidth) * levelHeight * TEXTURE_TEXEL_SIZE;
+		texture.levels.push_back(level);
+		chainSize += level.size;
+
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+
+	texture.texels.resize(static_cast<size_t>(chainSize));
+	memcpy(texture.texels.data(), pixels, static_cast<size_t>(texture.levels[0].size));
+
+	for (size_t i = 1; i < texture.levels.size(); i++)
+	{
+		const MipLevel& source = texture.levels[i - 1];
+		const MipLevel& level = texture.levels[i];
+		const uint8_t* src = texture.texels.data() + source.offset;
+		uint8_t* dst = texture.texels.data() + level.offset;
+
+		for (uint32_t y = 0; y < level.height; y++)
+		{
+			// Odd sized (or 1 wide/high) sources reuse their last row/column
+			uint32_t y0 = std::min(y * 2, source.height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+			for (uint32_t x = 0; x < level.width; x++)
+			{
+				uint32_t x0 = std::min(x * 2, source.width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+				for (uint32_t c = 0; c < TEXTURE_TEXEL_SIZE; c++)
+				{
+					uint32_t sum = src[(y0 * source.width + x0) * TEXTURE_TEXEL_SIZE + c] + src[(y0 * source.width + x1) * TEXTURE_TEXEL_SIZE + c] +
+						src[(y1 * source.width + x0) * TEXTURE_TEXEL_SIZE + c] + src[(y1 * source.width + x1) * TEXTURE_TEXEL_SIZE + c];
+					dst[(y * level.width + x) * TEXTURE_TEXEL_SIZE + c] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	// Mip tail is all that's wanted until texture is drawn
+	texture.tailLevel = static_cast<uint32_t>(texture.levels.size()) - 1;
+	while (texture.tailLevel > 0 &&
+		std::max(texture.levels[texture.tailLevel - 1].width, texture.levels[texture.tailLevel - 1].height) <= TEXTURE_TAIL_SIZE)
+	{
+		texture.tailLevel--;
+	}
+	texture.wantedLevel = texture.tailLevel;
+
+	textures.push_back(texture);
+
+	return static_cast<int>(textures.size()) - 1;
+}
+
+void TextureStreamer::RequestSize(int textureId, float pixels, uint64_t frameNumber)
+{
+	if (textureId < 0 || textureId >= static_cast<int>(textures.size()))
+	{
+		return;
+	}
+
+	// Finest mip needed is the one with about one texel per pixel the texture covers
+	Texture& texture = textures[textureId];
+	uint32_t size = std::max(texture.levels[0].width, texture.levels[0].height);
+	uint32_t level = texture.tailLevel;
+	if (pixels >= 1.0f)
+	{
+		float texelsPerPixel = static_cast<float>(size) / pixels;
+		level = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+		level = std::min(level, texture.tailLevel);
+	}
+
+	// Requests of one frame are combined, so the largest use of a texture decides
+	if (texture.requestFrame != frameNumber)
+	{
+		texture.wantedLevel = level;
+		texture.requestFrame = frameNumber;
+	}
+	else
+	{
+		texture.wantedLevel = std::min(texture.wantedLevel, level);
+	}
+	texture.lastRequestFrame = frameNumber;
+	lastRequestFrame = frameNumber;
+}
+
+uint32_t TextureStreamer::GetBindlessIndex(int textureId)
+{
+	if (textureId < 0 || textureId >= static_cast<int>(textures.size()))
+	{
+		return INVALID_BINDLESS_INDEX;
+	}
+
+	return textures[textureId].bindlessIndex;
+}
+
+uint64_t TextureStreamer::GetResidencyVersion()
+{
+	return residencyVersion;
+}
+
+VkCommandBuffer TextureStreamer::Update(uint32_t frame, uint64_t frameNumber)
+{
+	// Frame's fence has signalled, so its staging buffer and command buffer are free, and so are images retired long enough ago
+	ReleaseRetiredImages(frameNumber, false);
+	uploadedBytes = 0;
+
+	if (textures.empty())
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	UpdateBudget();
+	StartStreams(frameNumber);
+
+	if (streams.empty())
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	VkCommandBuffer commandBuffer = commandBuffers[frame];
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording a Texture Streaming Command Buffer!");
+	}
+
+	// Oldest streams are filled first, each taking as much of frame's upload limit as it has left
+	VkDeviceSize stagingUsed = 0;
+	for (size_t i = 0; i < streams.size();)
+	{
+		Texture& texture = textures[streams[i].textureId];
+		if (!RecordStream(commandBuffer, streams[i], texture, frame, &stagingUsed))
+		{
+			i++;
+			continue;
+		}
+
+		FinishStream(commandBuffer, streams[i], texture, frameNumber);
+		streams.erase(streams.begin() + i);
+	}
+
+	result = vkEndCommandBuffer(commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording a Texture Streaming Command Buffer!");
+	}
+
+	return commandBuffer;
+}
+
+void TextureStreamer::SetBudget(VkDeviceSize newBudgetLimit)
+{
+	budgetLimit = newBudgetLimit;
+}
+
+TextureStreamingStatistics TextureStreamer::GetStatistics()
+{
+	TextureStreamingStatistics statistics;
+	statistics.budget = budget;
+	statistics.residentBytes = residentBytes;
+	statistics.uploadedBytes = uploadedBytes;
+	statistics.evictedBytes = evictedBytes;
+	statistics.textureCount = static_cast<uint32_t>(textures.size());
+	statistics.streamingCount = static_cast<uint32_t>(streams.size());
+	for (const auto& stream : streams)
+	{
+		statistics.pendingUploadBytes += GetRemainingUploadBytes(stream);
+	}
+
+	return statistics;
+}
+
+void TextureStreamer::Destroy()
+{
+	ReleaseRetiredImages(0, true);
+	for (auto& stream : streams)
+	{
+		DestroyTextureImage(stream.target);
+	}
+	streams.clear();
+	for (auto& texture : textures)
+	{
+		DestroyTextureImage(texture.resident);
+	}
+	textures.clear();
+
+	for (size_t i = 0; i < stagingBuffers.size(); i++)
+	{
+		DestroyBuffer(device, allocator, stagingBuffers[i], &stagingBufferAllocations[i]);
+	}
+	stagingBuffers.clear();
+	stagingBufferAllocations.clear();
+
+	vkDestroyCommandPool(device, commandPool, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
+
+void TextureStreamer::UpdateBudget()
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	// Without memory budget, a fixed share of the heap is assumed to be free for textures
+	VkDeviceSize available = static_cast<VkDeviceSize>(memoryProperties.memoryHeaps[budgetHeap].size * TEXTURE_HEAP_FRACTION);
+
+	if (memoryBudgetSupported)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+		// Heap usage includes textures themselves, so what they may fill is what everything else leaves of the budget
+		// (usage is counted in whole allocator blocks, so everything else is overestimated rather than under)
+		VkDeviceSize heapBudget = budgetProperties.heapBudget[budgetHeap];
+		VkDeviceSize heapUsage = budgetProperties.heapUsage[budgetHeap];
+		VkDeviceSize otherUsage = heapUsage > residentBytes ? heapUsage - residentBytes : 0;
+		available = heapBudget > otherUsage ? static_cast<VkDeviceSize>((heapBudget - otherUsage) * TEXTURE_BUDGET_HEADROOM) : 0;
+	}
+
+	budget = budgetLimit > 0 ? std::min(budgetLimit, available) : available;
+}
+
+void TextureStreamer::ReleaseRetiredImages(uint64_t frameNumber, bool force)
+{
+	// Image retired on frame N may be sampled by frames up to N - 1, which are all done by frame N - 1 + MAX_FRAME_DRAWS
+	for (size_t i = 0; i < retiredImages.size();)
+	{
+		if (force || frameNumber >= retiredImages[i].frameNumber + MAX_FRAME_DRAWS)
+		{
+			retiringBytes -= retiredImages[i].image.allocation.size;
+			DestroyTextureImage(retiredImages[i].image);
+			retiredImages.erase(retiredImages.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+void TextureStreamer::EvictLeastRecentlyUsed(VkDeviceSize neededBytes, uint64_t frameNumber, bool includeInUse)
+{
+	// Textures holding finer mips than they need: unused ones need none past their tail, ones in use need their wanted level
+	// Under real pressure, textures in use also give up their finest mip
+	struct Victim
+	{
+		int textureId;
+		uint32_t keepLevel;
+	};
+	std::vector<Victim> victims;
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		Texture& texture = textures[i];
+		if (texture.streaming || texture.resident.image == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		bool inUse = IsInUse(texture, frameNumber);
+		uint32_t keepLevel = inUse ? texture.wantedLevel : texture.tailLevel;
+		if (inUse && includeInUse && texture.resident.firstLevel >= keepLevel)
+		{
+			keepLevel = texture.resident.firstLevel + 1;
+		}
+		keepLevel = std::min(keepLevel, texture.tailLevel);
+
+		if (texture.resident.firstLevel < keepLevel)
+		{
+			victims.push_back({ static_cast<int>(i), keepLevel });
+		}
+	}
+
+	// Least recently used first, largest first among those used as long ago
+	std::sort(victims.begin(), victims.end(), [this](const Victim& a, const Victim& b)
+		{
+			const Texture& textureA = textures[a.textureId];
+			const Texture& textureB = textures[b.textureId];
+			if (textureA.lastRequestFrame != textureB.lastRequestFrame)
+			{
+				return textureA.lastRequestFrame < textureB.lastRequestFrame;
+			}
+			return textureA.resident.firstLevel < textureB.resident.firstLevel;
+		});
+
+	// Dropping mips is a stream too: smaller image is copied from current one on GPU, with nothing to upload
+	VkDeviceSize freedBytes = 0;
+	for (const auto& victim : victims)
+	{
+		if (freedBytes >= neededBytes)
+		{
+			break;
+		}
+
+		const Texture& texture = textures[victim.textureId];
+		VkDeviceSize droppedBytes = GetChainSize(texture, texture.resident.firstLevel) - GetChainSize(texture, victim.keepLevel);
+		freedBytes += droppedBytes;
+		evictedBytes += droppedBytes;
+
+		StartStream(victim.textureId, victim.keepLevel);
+	}
+}
+
+void TextureStreamer::StartStreams(uint64_t frameNumber)
+{
+	// Memory once retired images are gone (new streams wait for them to go, but eviction doesn't need to free them twice)
+	VkDeviceSize committedBytes = residentBytes - retiringBytes;
+	if (committedBytes > budget)
+	{
+		EvictLeastRecentlyUsed(committedBytes - budget, frameNumber, true);
+	}
+
+	// Textures wanting finer mips than they have
+	std::vector<int> candidates;
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		Texture& texture = textures[i];
+		if (texture.streaming)
+		{
+			continue;
+		}
+
+		uint32_t targetLevel = IsInUse(texture, frameNumber) ? texture.wantedLevel : texture.tailLevel;
+		uint32_t currentLevel = texture.resident.image != VK_NULL_HANDLE ? texture.resident.firstLevel : static_cast<uint32_t>(texture.levels.size());
+		if (targetLevel < currentLevel)
+		{
+			candidates.push_back(static_cast<int>(i));
+		}
+	}
+
+	// Low mips first: textures with nothing resident, then those in use, then those furthest from what they want
+	std::sort(candidates.begin(), candidates.end(), [this, frameNumber](int a, int b)
+		{
+			const Texture& textureA = textures[a];
+			const Texture& textureB = textures[b];
+			bool emptyA = textureA.resident.image == VK_NULL_HANDLE;
+			bool emptyB = textureB.resident.image == VK_NULL_HANDLE;
+			if (emptyA != emptyB)
+			{
+				return emptyA;
+			}
+			bool inUseA = IsInUse(textureA, frameNumber);
+			bool inUseB = IsInUse(textureB, frameNumber);
+			if (inUseA != inUseB)
+			{
+				return inUseA;
+			}
+			int deficitA = static_cast<int>(textureA.resident.firstLevel) - static_cast<int>(textureA.wantedLevel);
+			int deficitB = static_cast<int>(textureB.resident.firstLevel) - static_cast<int>(textureB.wantedLevel);
+			return deficitA > deficitB;
+		});
+
+	// Only a few frames of uploads are queued at once, so new requests don't wait behind a long backlog
+	VkDeviceSize queuedBytes = 0;
+	for (const auto& stream : streams)
+	{
+		queuedBytes += GetRemainingUploadBytes(stream);
+	}
+
+	for (int textureId : candidates)
+	{
+		if (queuedBytes >= uploadLimit * TEXTURE_STREAM_AHEAD_FRAMES)
+		{
+			break;
+		}
+
+		// One mip finer at a time, so every texture gets sharper evenly rather than one at a time
+		const Texture& texture = textures[textureId];
+		bool empty = texture.resident.image == VK_NULL_HANDLE;
+		uint32_t firstLevel = empty ? texture.tailLevel : texture.resident.firstLevel - 1;
+		VkDeviceSize chainSize = GetChainSize(texture, firstLevel);
+
+		// Make room by dropping mips nothing is using, then wait for memory to actually be freed
+		// Mip tail is tiny and always needed, so it streams in regardless of budget
+		if (!empty)
+		{
+			committedBytes = residentBytes - retiringBytes;
+			if (committedBytes + chainSize > budget)
+			{
+				EvictLeastRecentlyUsed(committedBytes + chainSize - budget, frameNumber, false);
+			}
+			if (residentBytes + chainSize > budget)
+			{
+				continue;
+			}
+		}
+
+		StartStream(textureId, firstLevel);
+		queuedBytes += GetRemainingUploadBytes(streams.back());
+	}
+}
+
+void TextureStreamer::StartStream(int textureId, uint32_t firstLevel)
+{
+	Texture& texture = textures[textureId];
+
+	TextureStream stream;
+	stream.textureId = textureId;
+	stream.target = CreateTextureImage(texture, firstLevel);
+	residentBytes += stream.target.allocation.size;
+
+	// Mips current image already has are copied from it on GPU, only the rest come through staging
+	stream.uploadLevel = firstLevel;
+	stream.uploadRow = 0;
+	stream.uploadEndLevel = texture.resident.image != VK_NULL_HANDLE ? std::max(firstLevel, texture.resident.firstLevel) : static_cast<uint32_t>(texture.levels.size());
+
+	texture.streaming = true;
+	streams.push_back(stream);
+}
+
+bool TextureStreamer::RecordStream(VkCommandBuffer commandBuffer, TextureStream& stream, Texture& texture, uint32_t frame, VkDeviceSize* stagingUsed)
+{
+	uint32_t levelCount = static_cast<uint32_t>(texture.levels.size()) - stream.target.firstLevel;
+
+	// New image's whole chain goes to TRANSFER_DST once, before its first copy
+	if (!stream.started)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = stream.target.image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+		stream.started = true;
+	}
+
+	// Copy as many rows as fit in what's left of frame's staging buffer, picking up next frame where this one stops
+	uint8_t* staging = static_cast<uint8_t*>(stagingBufferAllocations[frame].mappedData);
+	while (stream.uploadLevel < stream.uploadEndLevel)
+	{
+		const MipLevel& level = texture.levels[stream.uploadLevel];
+		VkDeviceSize rowSize = static_cast<VkDeviceSize>(level.width) * TEXTURE_TEXEL_SIZE;
+
+		VkDeviceSize offset = (*stagingUsed + copyAlignment - 1) / copyAlignment * copyAlignment;
+		if (offset >= uploadLimit)
+		{
+			return false;
+		}
+		uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>(level.height - stream.uploadRow, (uploadLimit - offset) / rowSize));
+		if (rows == 0)
+		{
+			return false;
+		}
+
+		VkDeviceSize copySize = rowSize * rows;
+		memcpy(staging + offset, texture.texels.data() + level.offset + rowSize * stream.uploadRow, static_cast<size_t>(copySize));
+
+		VkBufferImageCopy region = {};
+		region.bufferOffset = offset;
+		region.bufferRowLength = 0;								// 0 = tightly packed
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = stream.uploadLevel - stream.target.firstLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, static_cast<int32_t>(stream.uploadRow), 0 };
+		region.imageExtent = { level.width, rows, 1 };
+
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffers[frame], stream.target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		*stagingUsed = offset + copySize;
+		uploadedBytes += copySize;
+
+		stream.uploadRow += rows;
+		if (stream.uploadRow == level.height)
+		{
+			stream.uploadLevel++;
+			stream.uploadRow = 0;
+		}
+	}
+
+	return true;
+}
+
+void TextureStreamer::FinishStream(VkCommandBuffer commandBuffer, TextureStream& stream, Texture& texture, uint64_t frameNumber)
+{
+	TextureImage& oldImage = texture.resident;
+	uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+
+	// Mips both images hold are copied across on GPU
+	// Frames still sampling old image were submitted earlier, so the barrier waits for them before it changes layout
+	if (oldImage.image != VK_NULL_HANDLE && stream.uploadEndLevel < levelCount)
+	{
+		VkImageMemoryBarrier sourceBarrier = {};
+		sourceBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		sourceBarrier.srcAccessMask = 0;
+		sourceBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		sourceBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		sourceBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		sourceBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		sourceBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		sourceBarrier.image = oldImage.image;
+		sourceBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount - oldImage.firstLevel, 0, 1 };
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &sourceBarrier);
+
+		std::vector<VkImageCopy> regions;
+		for (uint32_t level = stream.uploadEndLevel; level < levelCount; level++)
+		{
+			VkImageCopy region = {};
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - oldImage.firstLevel, 0, 1 };
+			region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - stream.target.firstLevel, 0, 1 };
+			region.extent = { texture.levels[level].width, texture.levels[level].height, 1 };
+			regions.push_back(region);
+		}
+
+		vkCmdCopyImage(commandBuffer, oldImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			stream.target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
+	// New image is ready to be sampled by this frame's draws, submitted straight after
+	VkImageMemoryBarrier readBarrier = {};
+	readBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	readBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	readBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	readBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	readBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	readBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	readBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	readBarrier.image = stream.target.image;
+	readBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount - stream.target.firstLevel, 0, 1 };
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &readBarrier);
+
+	// Texture moves to a new bindless slot, so frames in flight keep reading the old one until they finish
+	uint32_t bindlessIndex = bindlessDescriptors->AddTexture(stream.target.imageView, sampler);
+	if (texture.bindlessIndex != INVALID_BINDLESS_INDEX)
+	{
+		bindlessDescriptors->RemoveTexture(texture.bindlessIndex, frameNumber);
+	}
+	if (oldImage.image != VK_NULL_HANDLE)
+	{
+		retiredImages.push_back({ oldImage, frameNumber });
+		retiringBytes += oldImage.allocation.size;
+	}
+
+	texture.resident = stream.target;
+	texture.bindlessIndex = bindlessIndex;
+	texture.streaming = false;
+	residencyVersion++;
+}
+
+bool TextureStreamer::IsInUse(const Texture& texture, uint64_t frameNumber)
+{
+	// Requested by latest recording (which may be reused for many frames), or recently enough to likely be drawn again
+	return texture.requestFrame == lastRequestFrame || frameNumber < texture.lastRequestFrame + TEXTURE_UNUSED_FRAMES;
+}
+
+VkDeviceSize TextureStreamer::GetChainSize(const Texture& texture, uint32_t firstLevel)
+{
+	VkDeviceSize size = 0;
+	for (size_t i = firstLevel; i < texture.levels.size(); i++)
+	{
+		size += texture.levels[i].size;
+	}
+	return size;
+}
+
+VkDeviceSize TextureStreamer::GetRemainingUploadBytes(const TextureStream& stream)
+{
+	const Texture& texture = textures[stream.textureId];
+	VkDeviceSize size = 0;
+	for (uint32_t level = stream.uploadLevel; level < stream.uploadEndLevel; level++)
+	{
+		size += texture.levels[level].size;
+	}
+	if (stream.uploadLevel < stream.uploadEndLevel)
+	{
+		size -= static_cast<VkDeviceSize>(texture.levels[stream.uploadLevel].width) * TEXTURE_TEXEL_SIZE * stream.uploadRow;
+	}
+	return size;
+}
+
+TextureStreamer::TextureImage TextureStreamer::CreateTextureImage(const Texture& texture, uint32_t firstLevel)
+{
+	TextureImage textureImage;
+	textureImage.firstLevel = firstLevel;
+	uint32_t levelCount = static_cast<uint32_t>(texture.levels.size()) - firstLevel;
+
+	// CREATE IMAGE
+	// Transfer source as well, so a later image can copy mips out of it
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent = { texture.levels[firstLevel].width, texture.levels[firstLevel].height, 1 };
+	imageCreateInfo.mipLevels = levelCount;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = TEXTURE_FORMAT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &textureImage.image);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Texture Image!");
+	}
+
+	// CREATE MEMORY FOR IMAGE
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, textureImage.image, &memRequirements);
+	textureImage.allocation = allocator->Allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_TEXTURE, false);
+	vkBindImageMemory(device, textureImage.image, textureImage.allocation.memory, textureImage.allocation.offset);
+
+	// CREATE IMAGE VIEW
+	// View covers every mip image has, so sampling never reaches mips that aren't resident
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = textureImage.image;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = TEXTURE_FORMAT;
+	viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+	result = vkCreateImageView(device, &viewCreateInfo, nullptr, &textureImage.imageView);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Texture Image View!");
+	}
+
+	return textureImage;
+}
+
+void TextureStreamer::DestroyTextureImage(TextureImage& textureImage)
+{
+	if (textureImage.image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyImageView(device, textureImage.imageView, nullptr);
+	vkDestroyImage(device, textureImage.image, nullptr);
+	residentBytes -= textureImage.allocation.size;
+	allocator->Free(textureImage.allocation);
+
+	textureImage = TextureImage();
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "Utilities.h"
+#include "BindlessDescriptors.h"
+
+const VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+const VkDeviceSize TEXTURE_TEXEL_SIZE = 4;
+const uint32_t TEXTURE_TAIL_SIZE = 64;								// Mips this size and smaller are always resident (the mip tail)
+const uint32_t MAX_TEXTURE_SIZE = 16384;
+const VkDeviceSize DEFAULT_TEXTURE_UPLOAD_LIMIT = 4 * 1024 * 1024;	// Texel bytes copied to textures per frame (4 MiB)
+const VkDeviceSize MIN_TEXTURE_UPLOAD_LIMIT = MAX_TEXTURE_SIZE * TEXTURE_TEXEL_SIZE;	// Must hold at least one row of largest mip
+const float TEXTURE_BUDGET_HEADROOM = 0.9f;							// Share of memory left over by everything else textures may fill
+const float TEXTURE_HEAP_FRACTION = 0.5f;							// Share of device local heap used when memory budget can't be queried
+const uint32_t TEXTURE_UNUSED_FRAMES = 8;							// Frames without a request before texture's high mips may be evicted
+const uint32_t TEXTURE_STREAM_AHEAD_FRAMES = 2;						// Frames of uploads queued up, past which no more streams start
+
+// How texture streaming is doing (bytes)
+struct TextureStreamingStatistics
+{
+	VkDeviceSize budget = 0;				// Most texture memory may use right now
+	VkDeviceSize residentBytes = 0;			// Memory of every texture image (including ones being filled or waiting to be destroyed)
+	VkDeviceSize uploadedBytes = 0;			// Copied in last update
+	VkDeviceSize pendingUploadBytes = 0;	// Still to copy for streams in progress
+	VkDeviceSize evictedBytes = 0;			// Memory freed by dropping mips, since start
+	uint32_t textureCount = 0;
+	uint32_t streamingCount = 0;			// Textures currently changing their resident mips
+};
+
+// Keeps textures' mip chains in system memory and streams them into device local images as they are needed
+// Only the mip tail is resident to begin with, finer mips are brought in as the screen-space size each texture is drawn at asks for them,
+// and mips of least recently used textures are dropped again when memory goes over budget
+// Resident mips live in one image per texture. Changing them fills a new image over as many frames as the per frame upload limit needs,
+// copies still wanted mips across from the old image on GPU, then swaps the texture's bindless slot over to it
+// Copies are recorded into a command buffer per frame in flight, submitted on graphics queue just before the frame's own commands
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+
+	void Init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, DeviceAllocator* newAllocator, BindlessDescriptors* newBindlessDescriptors,
+		uint32_t graphicsFamily, bool newMemoryBudgetSupported, VkDeviceSize newUploadLimit = DEFAULT_TEXTURE_UPLOAD_LIMIT);
+
+	int CreateTexture(uint32_t width, uint32_t height, const void* pixels);
+	void RequestSize(int textureId, float pixels, uint64_t frameNumber);
+	uint32_t GetBindlessIndex(int textureId);
+	uint64_t GetResidencyVersion();
+
+	VkCommandBuffer Update(uint32_t frame, uint64_t frameNumber);
+	void SetBudget(VkDeviceSize newBudgetLimit);
+	TextureStreamingStatistics GetStatistics();
+
+	void Destroy();
+
+	~TextureStreamer();
+
+private:
+	// Mip chain in system memory, each level tightly packed RGBA8
+	struct MipLevel
+	{
+		uint32_t width;
+		uint32_t height;
+		VkDeviceSize offset;			// Offset into texture's texel data
+		VkDeviceSize size;
+	};
+
+	// Image holding the texture's mips from firstLevel to its coarsest
+	struct TextureImage
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		Allocation allocation;
+		uint32_t firstLevel = 0;		// Finest mip of chain held (image's level 0)
+	};
+
+	// New image being filled, swapped in for texture's current one when complete
+	struct TextureStream
+	{
+		int textureId;
+		TextureImage target;
+		bool started = false;			// Image has been transitioned for copies
+		uint32_t uploadLevel = 0;		// Next mip to copy from staging (mips from old image are copied on GPU at the end)
+		uint32_t uploadRow = 0;			// Next row of that mip
+		uint32_t uploadEndLevel = 0;	// First mip not uploaded from staging (copied from old image instead, if it has it)
+	};
+
+	struct Texture
+	{
+		std::vector<MipLevel> levels;
+		std::vector<uint8_t> texels;
+		uint32_t tailLevel = 0;			// Coarsest level streaming stops dropping at
+
+		TextureImage resident;			// Null until first mips have streamed in
+		uint32_t bindlessIndex = INVALID_BINDLESS_INDEX;
+
+		uint32_t wantedLevel = 0;		// Finest level asked for by last requests
+		uint64_t lastRequestFrame = 0;	// Frame texture was last requested on (for least recently used eviction)
+		uint64_t requestFrame = 0;		// Frame wantedLevel was gathered on
+		bool streaming = false;			// A stream is changing this texture's mips
+	};
+
+	// Replaced image, destroyed once frames in flight that may sample it have finished
+	struct RetiredImage
+	{
+		TextureImage image;
+		uint64_t frameNumber;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+	BindlessDescriptors* bindlessDescriptors = nullptr;
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	// - Upload
+	VkDeviceSize uploadLimit = DEFAULT_TEXTURE_UPLOAD_LIMIT;
+	VkDeviceSize copyAlignment = 16;
+	std::vector<VkBuffer> stagingBuffers;			// Per frame in flight, uploadLimit bytes each
+	std::vector<Allocation> stagingBufferAllocations;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> commandBuffers;	// Per frame in flight
+
+	// - Budget
+	bool memoryBudgetSupported = false;				// VK_EXT_memory_budget enabled on device
+	uint32_t budgetHeap = 0;						// Device local heap textures are allocated from
+	VkDeviceSize budgetLimit = 0;					// Set by user (0 = no limit beyond what device has)
+	VkDeviceSize budget = 0;						// Budget for current update
+	VkDeviceSize residentBytes = 0;
+	VkDeviceSize retiringBytes = 0;					// Part of resident bytes freed once retired images are destroyed
+
+	std::vector<Texture> textures;
+	std::vector<TextureStream> streams;				// In progress, oldest first
+	std::vector<RetiredImage> retiredImages;
+	uint64_t residencyVersion = 0;					// Bumped whenever a texture's bindless index changes
+	uint64_t lastRequestFrame = 0;					// Frame latest requests were made on
+
+	// - Statistics
+	VkDeviceSize uploadedBytes = 0;
+	VkDeviceSize evictedBytes = 0;
+
+	void UpdateBudget();
+	void ReleaseRetiredImages(uint64_t frameNumber, bool force);
+	void EvictLeastRecentlyUsed(VkDeviceSize neededBytes, uint64_t frameNumber, bool includeInUse);
+	void StartStreams(uint64_t frameNumber);
+	void StartStream(int textureId, uint32_t firstLevel);
+	bool RecordStream(VkCommandBuffer commandBuffer, TextureStream& stream, Texture& texture, uint32_t frame, VkDeviceSize* stagingUsed);
+	void FinishStream(VkCommandBuffer commandBuffer, TextureStream& stream, Texture& texture, uint64_t frameNumber);
+
+	bool IsInUse(const Texture& texture, uint64_t frameNumber);
+	VkDeviceSize GetChainSize(const Texture& texture, uint32_t firstLevel);
+	VkDeviceSize GetRemainingUploadBytes(const TextureStream& stream);
+	TextureImage CreateTextureImage(const Texture& texture, uint32_t firstLevel);
+	void DestroyTextureImage(TextureImage& textureImage);
+};
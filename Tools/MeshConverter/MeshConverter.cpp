@@ -0,0 +1,217 @@
+// Converts Wavefront OBJ files to the renderer's binary mesh format (.mesh)
+// Usage: MeshConverter input.obj output.mesh
+//
+// Reads positions ("v x y z", with optional "r g b" vertex colours) and faces ("f"), polygons are triangulated as fans
+// Vertices without a colour are given white
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <algorithm>
+
+#include "../../MeshFormat.h"
+
+// Matches renderer's Vertex (two 3 float vectors)
+struct ConvertedVertex
+{
+	float pos[3];
+	float col[3];
+};
+
+bool ParseObj(const std::string& filename, std::vector<ConvertedVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::ifstream file(filename);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to open " << filename << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+
+		if (type == "v")
+		{
+			ConvertedVertex vertex = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+			stream >> vertex.pos[0] >> vertex.pos[1] >> vertex.pos[2];
+			if (stream.fail())
+			{
+				std::cerr << filename << ":" << lineNumber << ": Invalid vertex" << std::endl;
+				return false;
+			}
+
+			// Optional vertex colour
+			float colour[3];
+			if (stream >> colour[0] >> colour[1] >> colour[2])
+			{
+				memcpy(vertex.col, colour, sizeof(colour));
+			}
+
+			vertices.push_back(vertex);
+		}
+		else if (type == "f")
+		{
+			// Each corner is "v", "v/vt", "v//vn" or "v/vt/vn", only position index is used
+			std::vector<uint32_t> face;
+			std::string corner;
+			while (stream >> corner)
+			{
+				long index = std::strtol(corner.c_str(), nullptr, 10);
+
+				// Negative indices count back from latest vertex, positive ones are 1 based
+				long resolved = index < 0 ? static_cast<long>(vertices.size()) + index : index - 1;
+				if (index == 0 || resolved < 0 || resolved >= static_cast<long>(vertices.size()))
+				{
+					std::cerr << filename << ":" << lineNumber << ": Invalid face index " << corner << std::endl;
+					return false;
+				}
+				face.push_back(static_cast<uint32_t>(resolved));
+			}
+
+			for (size_t i = 2; i < face.size(); i++)
+			{
+				indices.push_back(face[0]);
+				indices.push_back(face[i - 1]);
+				indices.push_back(face[i]);
+			}
+		}
+		// Anything else (normals, texture coords, groups, materials...) isn't used by renderer
+	}
+
+	return true;
+}
+
+void CalculateBounds(const std::vector<ConvertedVertex>& vertices, MeshFileHeader& header)
+{
+	if (vertices.empty())
+	{
+		return;
+	}
+
+	// Same sphere as renderer calculates: centre of bounding box, radius to furthest vertex
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.boundsMin[axis] = vertices[0].pos[axis];
+		header.boundsMax[axis] = vertices[0].pos[axis];
+	}
+	for (const auto& vertex : vertices)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			header.boundsMin[axis] = std::min(header.boundsMin[axis], vertex.pos[axis]);
+			header.boundsMax[axis] = std::max(header.boundsMax[axis], vertex.pos[axis]);
+		}
+	}
+
+	float centre[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		centre[axis] = (header.boundsMin[axis] + header.boundsMax[axis]) * 0.5f;
+	}
+
+	float radius = 0.0f;
+	for (const auto& vertex : vertices)
+	{
+		float dx = vertex.pos[0] - centre[0];
+		float dy = vertex.pos[1] - centre[1];
+		float dz = vertex.pos[2] - centre[2];
+		radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+	}
+
+	header.boundingSphere[0] = centre[0];
+	header.boundingSphere[1] = centre[1];
+	header.boundingSphere[2] = centre[2];
+	header.boundingSphere[3] = radius;
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+bool WriteMeshFile(const std::string& filename, const std::vector<ConvertedVertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.indexCount = static_cast<uint32_t>(indices.size());
+
+	// - Vertex Layout
+	header.vertexStride = sizeof(ConvertedVertex);
+	header.indexSize = sizeof(uint32_t);
+	header.attributeCount = 2;
+	header.attributes[0] = { MESH_ATTRIBUTE_POSITION, MESH_FORMAT_FLOAT3, offsetof(ConvertedVertex, pos), 0 };
+	header.attributes[1] = { MESH_ATTRIBUTE_COLOUR, MESH_FORMAT_FLOAT3, offsetof(ConvertedVertex, col), 0 };
+
+	// - Blobs
+	header.vertexDataSize = sizeof(ConvertedVertex) * static_cast<uint64_t>(vertices.size());
+	header.vertexDataOffset = AlignUp(sizeof(MeshFileHeader), MESH_FILE_BLOB_ALIGNMENT);
+	header.indexDataSize = sizeof(uint32_t) * static_cast<uint64_t>(indices.size());
+	header.indexDataOffset = AlignUp(header.vertexDataOffset + header.vertexDataSize, MESH_FILE_BLOB_ALIGNMENT);
+
+	CalculateBounds(vertices, header);
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to open " << filename << " for writing" << std::endl;
+		return false;
+	}
+
+	// Zero padding between header and blobs
+	const char padding[MESH_FILE_BLOB_ALIGNMENT] = {};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(padding, static_cast<std::streamsize>(header.vertexDataOffset - sizeof(header)));
+	file.write(reinterpret_cast<const char*>(vertices.data()), static_cast<std::streamsize>(header.vertexDataSize));
+	file.write(padding, static_cast<std::streamsize>(header.indexDataOffset - header.vertexDataOffset - header.vertexDataSize));
+	file.write(reinterpret_cast<const char*>(indices.data()), static_cast<std::streamsize>(header.indexDataSize));
+
+	if (!file)
+	{
+		std::cerr << "Failed to write " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: MeshConverter input.obj output.mesh" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<ConvertedVertex> vertices;
+	std::vector<uint32_t> indices;
+	if (!ParseObj(argv[1], vertices, indices))
+	{
+		return EXIT_FAILURE;
+	}
+
+	if (!WriteMeshFile(argv[2], vertices, indices))
+	{
+		return EXIT_FAILURE;
+	}
+
+	printf("Wrote %s: %zu vertices, %zu triangles\n", argv[2], vertices.size(), indices.size() / 3);
+
+	return EXIT_SUCCESS;
+}
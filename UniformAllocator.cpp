@@ -0,0 +1,70 @@
+#include "UniformAllocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+UniformAllocator::UniformAllocator()
+{
+}
+
+void UniformAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice newDevice, DeviceAllocator* newAllocator, uint32_t newSlotCount,
+	VkDeviceSize newRegionSize)
+{
+	device = newDevice;
+	allocator = newAllocator;
+
+	// Every dynamic offset has to be a multiple of device's uniform offset alignment (always a power of two)
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	alignment = std::max<VkDeviceSize>(deviceProperties.limits.minUniformBufferOffsetAlignment, 1);
+
+	// Regions start on aligned offsets too, so an allocation's offset is aligned however far into its region it is
+	regionSize = (newRegionSize + alignment - 1) & ~(alignment - 1);
+	regionUsed.assign(newSlotCount, 0);
+
+	// Written by CPU every time a frame is recorded, so it stays mapped in host visible memory
+	CreateBuffer(device, allocator, regionSize * newSlotCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&buffer, &bufferAllocation, MEMORY_TAG_UNIFORM);
+}
+
+void* UniformAllocator::Allocate(uint32_t slot, VkDeviceSize size, uint32_t* dynamicOffset)
+{
+	// Descriptor only covers UNIFORM_DESCRIPTOR_RANGE bytes past the dynamic offset
+	if (size > UNIFORM_DESCRIPTOR_RANGE)
+	{
+		throw std::runtime_error("Uniform allocation is larger than the uniform descriptor range!");
+	}
+
+	// Last allocation must leave a whole descriptor range inside the buffer, so range is reserved rather than size
+	VkDeviceSize offset = regionUsed[slot];
+	if (offset + UNIFORM_DESCRIPTOR_RANGE > regionSize)
+	{
+		throw std::runtime_error("Failed to allocate uniform data, frame's uniform region is full!");
+	}
+	regionUsed[slot] = (offset + size + alignment - 1) & ~(alignment - 1);
+
+	VkDeviceSize bufferOffset = regionSize * slot + offset;
+	*dynamicOffset = static_cast<uint32_t>(bufferOffset);
+	return static_cast<uint8_t*>(bufferAllocation.mappedData) + bufferOffset;
+}
+
+void UniformAllocator::Reset(uint32_t slot)
+{
+	// Only safe once GPU has finished with slot's frame (its fence has signalled)
+	regionUsed[slot] = 0;
+}
+
+VkBuffer UniformAllocator::GetBuffer()
+{
+	return buffer;
+}
+
+void UniformAllocator::Destroy()
+{
+	DestroyBuffer(device, allocator, buffer, &bufferAllocation);
+}
+
+UniformAllocator::~UniformAllocator()
+{
+}
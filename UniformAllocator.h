@@ -0,0 +1,43 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "Utilities.h"
+
+const VkDeviceSize DEFAULT_UNIFORM_REGION_SIZE = 256 * 1024;		// Bytes of uniform data each frame in flight can allocate
+const VkDeviceSize UNIFORM_DESCRIPTOR_RANGE = 256;					// Largest single allocation a dynamic uniform descriptor can see
+
+// Persistently mapped uniform buffer split into one region per frame in flight
+// Each region is bump allocated while its frame is recorded, and rewound once the frame's fence has signalled
+// Allocations are found by shaders through a dynamic offset, so one descriptor set serves them all, and is never updated
+class UniformAllocator
+{
+public:
+	UniformAllocator();
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice newDevice, DeviceAllocator* newAllocator, uint32_t newSlotCount,
+		VkDeviceSize newRegionSize = DEFAULT_UNIFORM_REGION_SIZE);
+
+	void* Allocate(uint32_t slot, VkDeviceSize size, uint32_t* dynamicOffset);
+	void Reset(uint32_t slot);
+
+	VkBuffer GetBuffer();
+
+	void Destroy();
+
+	~UniformAllocator();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	Allocation bufferAllocation;
+
+	VkDeviceSize regionSize = 0;
+	VkDeviceSize alignment = 1;				// minUniformBufferOffsetAlignment of device
+	std::vector<VkDeviceSize> regionUsed;	// Bytes allocated so far in each slot's region
+};
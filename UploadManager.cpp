@@ -0,0 +1,353 @@
+#include "UploadManager.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+
+UploadManager::UploadManager()
+{
+}
+
+void UploadManager::Init(VkDevice newDevice, DeviceAllocator* newAllocator,
+	VkQueue newTransferQueue, uint32_t newTransferFamily,
+	VkQueue newGraphicsQueue, uint32_t newGraphicsFamily,
+	VkDeviceSize newRingSize)
+{
+	device = newDevice;
+	allocator = newAllocator;
+	transferQueue = newTransferQueue;
+	transferFamily = newTransferFamily;
+	graphicsQueue = newGraphicsQueue;
+	graphicsFamily = newGraphicsFamily;
+	ringSize = newRingSize;
+
+	// Own pool so batch command buffers can be individually reset and recycled
+	transferCommandPool = CreateCommandPool(transferFamily);
+
+	// Destination buffers are written by one family and read by the other, so both must be able to use them
+	if (HasDedicatedTransfer())
+	{
+		sharedFamilies = { transferFamily, graphicsFamily };
+	}
+
+	// Staging ring lives in host visible memory for the whole lifetime of the manager
+	CreateBuffer(device, allocator, ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferAllocation, MEMORY_TAG_STAGING);
+	stagingData = static_cast<char*>(stagingBufferAllocation.mappedData);
+}
+
+void UploadManager::UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	// Data bigger than a quarter of the ring is split, so one upload can't starve the ring
+	VkDeviceSize maxChunk = GetMaxChunkSize();
+	const char* src = static_cast<const char*>(data);
+
+	while (size > 0)
+	{
+		VkDeviceSize chunk = std::min(size, maxChunk);
+
+		VkDeviceSize stagingOffset;
+		void* staging = ReserveStaging(chunk, &stagingOffset);
+		memcpy(staging, src, static_cast<size_t>(chunk));
+		CopyToBuffer(stagingOffset, dstBuffer, dstOffset, chunk);
+
+		src += chunk;
+		dstOffset += chunk;
+		size -= chunk;
+	}
+}
+
+VkDeviceSize UploadManager::GetMaxChunkSize()
+{
+	// Largest piece a single upload should reserve at once
+	return ringSize / 4;
+}
+
+const std::vector<uint32_t>& UploadManager::GetSharedFamilies()
+{
+	return sharedFamilies;
+}
+
+void* UploadManager::ReserveStaging(VkDeviceSize size, VkDeviceSize* stagingOffset)
+{
+	if (size > ringSize)
+	{
+		throw std::runtime_error("Upload is larger than the Staging Ring!");
+	}
+
+	// Place region at aligned head, or wrap to start of ring if it doesn't fit before the end
+	VkDeviceSize offset = (ringHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	if (offset + size > ringSize)
+	{
+		offset = 0;
+	}
+	VkDeviceSize consumed = (offset >= ringHead ? offset - ringHead : ringSize - ringHead) + size;
+
+	// Make room by submitting what's pending and retiring oldest batches (waits only when ring is full)
+	while (ringSize - ringUsed < consumed)
+	{
+		if (inFlightBatches.empty())
+		{
+			Flush();
+		}
+		if (inFlightBatches.empty())
+		{
+			throw std::runtime_error("Staging Ring has no space left to reclaim!");
+		}
+		RetireOldestBatch(true);
+	}
+
+	ringHead = offset + size;
+	ringUsed += consumed;
+	pendingBytes += consumed;
+
+	*stagingOffset = offset;
+	return stagingData + offset;
+}
+
+void UploadManager::CopyToBuffer(VkDeviceSize stagingOffset, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+	PendingCopy copy = {};
+	copy.dstBuffer = dstBuffer;
+	copy.region.srcOffset = stagingOffset;
+	copy.region.dstOffset = dstOffset;
+	copy.region.size = size;
+
+	pendingCopies.push_back(copy);
+}
+
+void UploadManager::Flush()
+{
+	if (pendingCopies.empty())
+	{
+		return;
+	}
+
+	Batch batch = AcquireBatch();
+	batch.ringBytes = pendingBytes;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+	// Group copies by destination so each buffer gets a single vkCmdCopyBuffer with all its regions
+	std::stable_sort(pendingCopies.begin(), pendingCopies.end(),
+		[](const PendingCopy& a, const PendingCopy& b) { return a.dstBuffer < b.dstBuffer; });
+
+	std::vector<VkBufferCopy> regions;
+	for (size_t i = 0; i < pendingCopies.size(); i++)
+	{
+		regions.push_back(pendingCopies[i].region);
+
+		if (i + 1 == pendingCopies.size() || pendingCopies[i + 1].dstBuffer != pendingCopies[i].dstBuffer)
+		{
+			vkCmdCopyBuffer(batch.commandBuffer, stagingBuffer, pendingCopies[i].dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+			regions.clear();
+		}
+	}
+
+	if (!HasDedicatedTransfer())
+	{
+		// Same queue family as rendering: make transfer writes visible to any later work on the queue (vertex input, shaders, etc)
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkEndCommandBuffer(batch.commandBuffer);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+		// Submit batch, fence signals when its staging space can be reused
+		VkResult result = vkQueueSubmit(transferQueue, 1, &submitInfo, batch.fence);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit an Upload Batch!");
+		}
+	}
+	else
+	{
+		// Separate queue family: destination buffers are shared concurrently, so there's no ownership to hand over
+		vkEndCommandBuffer(batch.commandBuffer);
+
+		// Copies signal a semaphore when done...
+		VkSubmitInfo transferSubmitInfo = {};
+		transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		transferSubmitInfo.commandBufferCount = 1;
+		transferSubmitInfo.pCommandBuffers = &batch.commandBuffer;
+		transferSubmitInfo.signalSemaphoreCount = 1;
+		transferSubmitInfo.pSignalSemaphores = &batch.transferComplete;
+
+		VkResult result = vkQueueSubmit(transferQueue, 1, &transferSubmitInfo, VK_NULL_HANDLE);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit an Upload Batch!");
+		}
+
+		// ...which the graphics queue waits on (with no commands of its own), so graphics work submitted after it sees the copies
+		// Semaphore wait also makes the copies' writes visible to graphics, so no barrier is needed
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo waitSubmitInfo = {};
+		waitSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		waitSubmitInfo.waitSemaphoreCount = 1;
+		waitSubmitInfo.pWaitSemaphores = &batch.transferComplete;
+		waitSubmitInfo.pWaitDstStageMask = &waitStage;
+		waitSubmitInfo.commandBufferCount = 0;
+
+		// Fence is on the wait, which can only finish after the copies did
+		result = vkQueueSubmit(graphicsQueue, 1, &waitSubmitInfo, batch.fence);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit an Upload Wait!");
+		}
+	}
+
+	inFlightBatches.push_back(batch);
+	pendingCopies.clear();
+	pendingBytes = 0;
+}
+
+void UploadManager::Update()
+{
+	// Retire every batch that has already finished, without blocking
+	while (!inFlightBatches.empty() && vkGetFenceStatus(device, inFlightBatches.front().fence) == VK_SUCCESS)
+	{
+		RetireOldestBatch(false);
+	}
+}
+
+void UploadManager::WaitIdle()
+{
+	Flush();
+	while (!inFlightBatches.empty())
+	{
+		RetireOldestBatch(true);
+	}
+}
+
+void UploadManager::Destroy()
+{
+	WaitIdle();
+
+	for (auto& batch : freeBatches)
+	{
+		vkDestroyFence(device, batch.fence, nullptr);
+		if (batch.transferComplete != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(device, batch.transferComplete, nullptr);
+		}
+	}
+	freeBatches.clear();
+
+	vkDestroyCommandPool(device, transferCommandPool, nullptr);
+	DestroyBuffer(device, allocator, stagingBuffer, &stagingBufferAllocation);
+}
+
+UploadManager::~UploadManager()
+{
+}
+
+bool UploadManager::HasDedicatedTransfer()
+{
+	return transferFamily != graphicsFamily;
+}
+
+VkCommandPool UploadManager::CreateCommandPool(uint32_t queueFamilyIndex)
+{
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+	VkCommandPool commandPool;
+	VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Upload Command Pool!");
+	}
+
+	return commandPool;
+}
+
+VkCommandBuffer UploadManager::AllocateCommandBuffer(VkCommandPool commandPool)
+{
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	VkResult result = vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate an Upload Command Buffer!");
+	}
+
+	return commandBuffer;
+}
+
+UploadManager::Batch UploadManager::AcquireBatch()
+{
+	// Recycle a retired batch if there is one
+	if (!freeBatches.empty())
+	{
+		Batch batch = freeBatches.back();
+		freeBatches.pop_back();
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		return batch;
+	}
+
+	Batch batch = {};
+	batch.commandBuffer = AllocateCommandBuffer(transferCommandPool);
+
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkResult result = vkCreateFence(device, &fenceCreateInfo, nullptr, &batch.fence);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Upload Fence!");
+	}
+
+	if (HasDedicatedTransfer())
+	{
+		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &batch.transferComplete);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create an Upload Semaphore!");
+		}
+	}
+
+	return batch;
+}
+
+void UploadManager::RetireOldestBatch(bool wait)
+{
+	Batch batch = inFlightBatches.front();
+	inFlightBatches.pop_front();
+
+	if (wait)
+	{
+		vkWaitForFences(device, 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+	vkResetFences(device, 1, &batch.fence);
+
+	// Batches retire in submission order, so the oldest bytes of the ring are the ones freed
+	ringUsed -= batch.ringBytes;
+
+	freeBatches.push_back(batch);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <deque>
+
+#include "Utilities.h"
+
+const VkDeviceSize DEFAULT_STAGING_RING_SIZE = 32 * 1024 * 1024;	// Size of persistently mapped staging ring (32 MiB)
+const VkDeviceSize STAGING_ALIGNMENT = 16;							// Alignment of each staged region inside the ring
+
+// Streams data to device local buffers through one persistently mapped staging ring buffer
+// Copies are collected and submitted together as a batch, and ring space is reclaimed once a batch's fence signals
+// If the transfer queue is from a separate family, destination buffers must be created shared (concurrent) with the graphics family
+// (see GetSharedFamilies), and the graphics queue waits on a semaphore before using what a batch wrote
+class UploadManager
+{
+public:
+	UploadManager();
+
+	void Init(VkDevice newDevice, DeviceAllocator* newAllocator,
+		VkQueue newTransferQueue, uint32_t newTransferFamily,
+		VkQueue newGraphicsQueue, uint32_t newGraphicsFamily,
+		VkDeviceSize newRingSize = DEFAULT_STAGING_RING_SIZE);
+
+	void UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+	void* ReserveStaging(VkDeviceSize size, VkDeviceSize* stagingOffset);
+	void CopyToBuffer(VkDeviceSize stagingOffset, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size);
+	VkDeviceSize GetMaxChunkSize();
+	const std::vector<uint32_t>& GetSharedFamilies();
+
+	void Flush();
+	void Update();
+	void WaitIdle();
+
+	void Destroy();
+
+	~UploadManager();
+
+private:
+	struct PendingCopy
+	{
+		VkBuffer dstBuffer;
+		VkBufferCopy region;
+	};
+
+	struct Batch
+	{
+		VkCommandBuffer commandBuffer;		// Copies on transfer queue
+		VkSemaphore transferComplete;		// Signals graphics queue that copies are done (dedicated transfer family only)
+		VkFence fence;
+		VkDeviceSize ringBytes;			// Ring space (including wrap-around waste) released when batch retires
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	VkQueue graphicsQueue = VK_NULL_HANDLE;
+	uint32_t transferFamily = 0;
+	uint32_t graphicsFamily = 0;
+	std::vector<uint32_t> sharedFamilies;		// Families destination buffers are shared between (empty if there's only one)
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+	// - Staging Ring
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	Allocation stagingBufferAllocation;
+	char* stagingData = nullptr;
+	VkDeviceSize ringSize = 0;
+	VkDeviceSize ringHead = 0;			// Next free byte in the ring
+	VkDeviceSize ringUsed = 0;			// Bytes in use by pending and in flight copies
+	VkDeviceSize pendingBytes = 0;		// Bytes consumed since last flush
+
+	// - Batches
+	std::vector<PendingCopy> pendingCopies;
+	std::deque<Batch> inFlightBatches;
+	std::vector<Batch> freeBatches;
+
+	bool HasDedicatedTransfer();
+	VkCommandPool CreateCommandPool(uint32_t queueFamilyIndex);
+	VkCommandBuffer AllocateCommandBuffer(VkCommandPool commandPool);
+
+	Batch AcquireBatch();
+	void RetireOldestBatch(bool wait);
+};
@@ -1,12 +1,22 @@
 #pragma once
 
-#include <fstream>
+#include <stdexcept>
+#include <chrono>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "DeviceAllocator.h"
+
 const int MAX_FRAME_DRAWS = 2;
+const uint32_t MAX_INDIRECT_DRAWS = 16384;		// Draw commands each frame's indirect buffer can hold
+const uint32_t MAX_INSTANCES = 65536;			// Instance transforms each frame's instance buffer can hold
+const uint32_t MAX_16BIT_INDEXED_VERTICES = 65536;	// Meshes with at most this many vertices can use 16 bit indices
+
+// Draws are grouped by index type, each group gets its own indirect draw (16 bit indexed first, then 32 bit)
+const uint32_t DRAW_GROUP_COUNT = 2;
+const VkIndexType DRAW_GROUP_INDEX_TYPES[DRAW_GROUP_COUNT] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
 
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
@@ -19,17 +29,78 @@ struct Vertex
 	glm::vec3 col; //Vertex Colour (r, g, b)
 };
 
+// Object the frustum culling compute shader tests (layout must match cull.comp)
+struct CullObject
+{
+	glm::vec4 boundingSphere;		// Centre (xyz) and radius (w)
+	uint32_t indexCount;			// Draw to emit if visible...
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t instanceCount;
+	uint32_t firstInstance;
+	uint32_t drawGroup;				// Index type group the draw belongs to, each has its own draw count
+	uint32_t groupFirstCommand;		// Where group's packed draws start in indirect buffer
+	uint32_t padding;				// Struct is 16 byte aligned in shader
+};
+
+// Push constants of the frustum culling compute shader
+struct CullPushConstants
+{
+	glm::vec4 frustumPlanes[6];		// Normal (xyz) and distance (w), pointing inwards
+	uint32_t objectCount;
+	uint32_t compact;				// 1 = pack visible draws and count them, 0 = zero instance count of culled draws in place
+};
+
+const uint32_t MAX_MATERIALS = 4096;
+const uint32_t INVALID_BINDLESS_INDEX = 0xFFFFFFFF;		// No resource in bindless arrays (e.g. material without a texture)
+
+// Per frame data of shaders, bound as a dynamic uniform buffer (set 0, binding 0)
+struct FrameUniforms
+{
+	glm::mat4 viewProjection;
+	uint32_t materialBufferIndex;		// Bindless storage buffer holding this frame's material table
+	uint32_t padding[3];
+};
+
+// Per instance data, read from instance buffer at vertex binding 1
+struct InstanceData
+{
+	glm::mat4 transform;
+	uint32_t materialIndex;				// Index into material table
+};
+
+// Surface description, looked up by index in fragment shader (std430 layout of material table)
+struct Material
+{
+	glm::vec4 baseColour = glm::vec4(1.0f);					// Multiplies vertex colour
+	uint32_t baseColourTexture = INVALID_BINDLESS_INDEX;	// Texture id (CreateTexture), resolved to its bindless index on GPU copy
+	uint32_t padding[3] = {};
+};
+
+// Per draw data of vertex shaders, small enough to be pushed rather than kept in a buffer
+struct DrawPushConstants
+{
+	glm::mat4 meshTransform;		// Places whole mesh (all of its instances) in world
+};
+
 // Indices (location) of Queue Families (if they exist at all)
 struct QueueFamilyIndices
 {
 	int graphicsFamily = -1;		// Location of Graphics Queue Family
 	int presentationFamily = -1;	// Location of Presentation Queue Family
+	int transferFamily = -1;		// Location of Transfer Queue Family (dedicated if one exists, otherwise same as graphics)
 
 	// Check if queue families are valid
 	bool isValid()
 	{
 		return graphicsFamily >= 0 && presentationFamily >= 0;
 	}
+
+	// Check if uploads run on a separate queue family, whose destination buffers must be shared with graphics
+	bool hasDedicatedTransfer()
+	{
+		return transferFamily >= 0 && transferFamily != graphicsFamily;
+	}
 };
 
 struct SwapchainDetails
@@ -45,33 +116,22 @@ struct SwapchainImage
 	VkImageView imageView;
 };
 
-static std::vector<char> readFile(const std::string& filename) 
+// CPU timings of a single Draw call (milliseconds)
+struct FrameTimings
 {
-	// Open stream from given file
-	// std::ios::binary tells stream to read file as binary
-	// std::ios::ate tells stream to start reading fron end of file
-	std::ifstream file(filename, std::ios::binary | std::ios::ate);
-
-	// Check if file stream successfully opened
-	if (!file.is_open())
-	{
-		throw std::runtime_error("Failed to open a file!");
-	}
-
-	// Get current read position and use to resize file buffer
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> fileBuffer(fileSize);
-
-	// Move read position (seek to) the start of the file
-	file.seekg(0);
-
-	// Read the file data into the buffer (stream "fileSize" in total)
-	file.read(fileBuffer.data(), fileSize);
-
-	// Close stream
-	file.close();
+	double cpuFrameTime = 0.0;		// Whole Draw call
+	double fenceWaitTime = 0.0;		// Waiting for frame in flight to be free
+	double acquireTime = 0.0;		// Acquiring next swapchain image
+	double recordTime = 0.0;		// Recording command buffers (0 if previous recording was reused)
+	double presentTime = 0.0;		// Queueing image for presentation
+	double limiterWaitTime = 0.0;	// Held back by frame limiter before frame started
+	double frameInterval = 0.0;		// Start of previous frame to start of this one (what pacing is judged by)
+};
 
-	return fileBuffer;
+// Time between two points in milliseconds
+static double ElapsedMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
 }
 
 static uint32_t FindMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
@@ -89,18 +149,30 @@ static uint32_t FindMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t al
 			return i;
 		}
 	}
+
+	// Nothing matched, and no index returned here would be valid
+	throw std::runtime_error("Failed to find a suitable Memory Type!");
 }
 
-static void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer, VkDeviceMemory* bufferMemory)
+static void CreateBuffer(VkDevice device, DeviceAllocator* allocator, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer, Allocation* bufferAllocation,
+	MemoryTag tag, uint32_t sharedFamilyCount = 0, const uint32_t* sharedFamilies = nullptr)
 {
 	// CREATE VERTEX BUFFER
 	// Information to create a buffer (doesn't include assigning memory)
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = bufferSize;								// Size of buffer (size of 1 vertex * number of verticies)
-	bufferInfo.usage = bufferSize;								// Multiple types of buffer possible
+	bufferInfo.usage = bufferUsage;								// Multiple types of buffer possible
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;			// Similar to Swap Chain images, can share vertex buffers
 
+	// Buffers used by more than one queue family are shared concurrently, so no ownership transfers are needed
+	if (sharedFamilyCount > 1)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = sharedFamilyCount;
+		bufferInfo.pQueueFamilyIndices = sharedFamilies;
+	}
+
 	VkResult result = vkCreateBuffer(device, &bufferInfo, nullptr, buffer);
 	if (result != VK_SUCCESS)
 	{
@@ -112,67 +184,15 @@ static void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDev
 	vkGetBufferMemoryRequirements(device, *buffer, &memRequirements);
 
 	// ALLOCATE MEMORY TO BUFFER
-	VkMemoryAllocateInfo memoryAllocInfo = {};
-	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocInfo.allocationSize = memRequirements.size;
-	memoryAllocInfo.memoryTypeIndex = FindMemoryTypeIndex(physicalDevice, memRequirements.memoryTypeBits, bufferProperties);	// Index of memory type on Physical Device that has required bit flags
-																																
-	// Allocate memory to VkDeviceMemory
-	result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, bufferMemory);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a Vertex Buffer Memory!");
-	}
+	// Sub-allocate a region of a larger memory block instead of a vkAllocateMemory per buffer (tagged for memory statistics)
+	*bufferAllocation = allocator->Allocate(memRequirements, bufferProperties, tag);
 
-	// Allocate memory to given vertex buffer
-	vkBindBufferMemory(device, *buffer, *bufferMemory, 0);
+	// Bind region of block memory to given buffer
+	vkBindBufferMemory(device, *buffer, bufferAllocation->memory, bufferAllocation->offset);
 }
 
-static void CopyBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize)
+static void DestroyBuffer(VkDevice device, DeviceAllocator* allocator, VkBuffer buffer, Allocation* bufferAllocation)
 {
-	// Command buffer to hold tansfer commands
-	VkCommandBuffer transferCommandBuffer;
-
-	// Command Buffer details
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = transferCommandPool;											
-	allocInfo.commandBufferCount = 1;
-
-	// Allocate command buffer from pool
-	vkAllocateCommandBuffers(device, &allocInfo, &transferCommandBuffer);
-
-	// Information to begin the command buffer record
-	VkCommandBufferBeginInfo beginInfo = {};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // We're only using the command buffer once, so set up for one time submit
-
-	// Begin recording transfer commands
-	vkBeginCommandBuffer(transferCommandBuffer, &beginInfo);
-
-	// Region of data to copy from and to
-	VkBufferCopy bufferCopyRegion = {};
-	bufferCopyRegion.srcOffset = 0;
-	bufferCopyRegion.dstOffset = 0;
-	bufferCopyRegion.size = bufferSize;
-
-	// Command to copy src buffer to dst buffer
-	vkCmdCopyBuffer(transferCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
-
-	// End commands
-	vkEndCommandBuffer(transferCommandBuffer);
-
-	// Queue submission information
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &transferCommandBuffer;
-
-	// Submit transfer command to transfer queue and wait until it finishes
-	vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(transferQueue);
-
-	// Free temporary command buffer back to pool
-	vkFreeCommandBuffers(device, transferCommandPool, 1, &transferCommandBuffer);
+	vkDestroyBuffer(device, buffer, nullptr);
+	allocator->Free(*bufferAllocation);
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "VertexLayouts.h"
+
+VertexLayoutInfo GetVertexLayoutInfo(VertexFormat format)
+{
+	switch (format)
+	{
+	case VERTEX_FORMAT_HALF:
+		return MakeVertexLayoutInfo<VertexHalf>(format);
+	case VERTEX_FORMAT_SNORM16:
+		return MakeVertexLayoutInfo<VertexSnorm16>(format);
+	case VERTEX_FORMAT_FLOAT:
+	default:
+		return MakeVertexLayoutInfo<VertexFloat>(VERTEX_FORMAT_FLOAT);
+	}
+}
+
+bool ParseVertexFormat(const std::string& name, VertexFormat* format)
+{
+	for (VertexFormat candidate : { VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_HALF, VERTEX_FORMAT_SNORM16 })
+	{
+		if (name == GetVertexFormatName(candidate))
+		{
+			*format = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* GetVertexFormatName(VertexFormat format)
+{
+	switch (format)
+	{
+	case VERTEX_FORMAT_HALF:
+		return "half";
+	case VERTEX_FORMAT_SNORM16:
+		return "snorm16";
+	case VERTEX_FORMAT_FLOAT:
+	default:
+		return "float";
+	}
+}
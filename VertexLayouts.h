@@ -0,0 +1,156 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#include "Utilities.h"
+
+// Formats vertices can be stored in on the GPU
+// Meshes are always given as full precision Vertex data, and converted to the chosen format when uploaded
+enum VertexFormat
+{
+	VERTEX_FORMAT_FLOAT = 0,		// 32 bit float position and colour (24 bytes)
+	VERTEX_FORMAT_HALF = 1,			// 16 bit float position, unorm8 RGBA colour (12 bytes)
+	VERTEX_FORMAT_SNORM16 = 2,		// snorm16 position across mesh bounds, unorm8 RGBA colour (12 bytes)
+};
+
+// Maps positions to -1..1 across a mesh's bounding box (used by layouts with bounds relative positions)
+struct VertexQuantization
+{
+	glm::vec3 centre;
+	glm::vec3 halfExtent;
+};
+
+// -- LAYOUTS --
+// Each layout describes its own attributes, so its Vulkan vertex input is generated from the struct itself
+// Locations must match shader.vert: 0 = position, 1 = colour
+
+struct VertexFloat
+{
+	float pos[3];
+	float col[3];
+
+	static constexpr bool boundsRelative = false;
+
+	static constexpr std::array<VkVertexInputAttributeDescription, 2> GetAttributes()
+	{
+		return { {
+			{ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexFloat, pos) },
+			{ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexFloat, col) },
+		} };
+	}
+
+	static VertexFloat Encode(const Vertex& vertex, const VertexQuantization& quantization)
+	{
+		return { { vertex.pos.x, vertex.pos.y, vertex.pos.z }, { vertex.col.x, vertex.col.y, vertex.col.z } };
+	}
+};
+
+struct VertexHalf
+{
+	uint16_t pos[4];		// w unused, keeps colour 4 byte aligned
+	uint32_t col;
+
+	static constexpr bool boundsRelative = false;
+
+	static constexpr std::array<VkVertexInputAttributeDescription, 2> GetAttributes()
+	{
+		return { {
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(VertexHalf, pos) },
+			{ 1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(VertexHalf, col) },
+		} };
+	}
+
+	static VertexHalf Encode(const Vertex& vertex, const VertexQuantization& quantization)
+	{
+		return { { glm::packHalf1x16(vertex.pos.x), glm::packHalf1x16(vertex.pos.y), glm::packHalf1x16(vertex.pos.z), glm::packHalf1x16(1.0f) },
+			glm::packUnorm4x8(glm::vec4(vertex.col, 1.0f)) };
+	}
+};
+
+struct VertexSnorm16
+{
+	uint16_t pos[4];		// Relative to mesh bounds (see VertexQuantization), w unused
+	uint32_t col;
+
+	static constexpr bool boundsRelative = true;
+
+	static constexpr std::array<VkVertexInputAttributeDescription, 2> GetAttributes()
+	{
+		return { {
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(VertexSnorm16, pos) },
+			{ 1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(VertexSnorm16, col) },
+		} };
+	}
+
+	static VertexSnorm16 Encode(const Vertex& vertex, const VertexQuantization& quantization)
+	{
+		glm::vec3 relative = (vertex.pos - quantization.centre) / quantization.halfExtent;
+		return { { glm::packSnorm1x16(relative.x), glm::packSnorm1x16(relative.y), glm::packSnorm1x16(relative.z), glm::packSnorm1x16(1.0f) },
+			glm::packUnorm4x8(glm::vec4(vertex.col, 1.0f)) };
+	}
+};
+
+static_assert(sizeof(VertexFloat) == 24, "VertexFloat must be tightly packed");
+static_assert(sizeof(VertexHalf) == 12, "VertexHalf must be tightly packed");
+static_assert(sizeof(VertexSnorm16) == 12, "VertexSnorm16 must be tightly packed");
+
+// Vulkan vertex input and upload conversion of a layout, all generated from the layout type
+template<typename T>
+struct VertexLayout
+{
+	static constexpr VkVertexInputBindingDescription GetBindingDescription(uint32_t binding)
+	{
+		return { binding, sizeof(T), VK_VERTEX_INPUT_RATE_VERTEX };
+	}
+
+	static constexpr std::array<VkVertexInputAttributeDescription, T::GetAttributes().size()> GetAttributeDescriptions()
+	{
+		return T::GetAttributes();
+	}
+
+	// Converts vertices straight into destination memory (e.g. staging)
+	static void Encode(const Vertex* vertices, uint32_t vertexCount, const VertexQuantization& quantization, void* dst)
+	{
+		T* encoded = static_cast<T*>(dst);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			encoded[i] = T::Encode(vertices[i], quantization);
+		}
+	}
+};
+
+// Registered layout, in a form that can be chosen at runtime
+struct VertexLayoutInfo
+{
+	VertexFormat format = VERTEX_FORMAT_FLOAT;
+	uint32_t stride = 0;
+	bool boundsRelative = false;			// Positions need mesh's dequantize transform applied
+	std::vector<VkVertexInputAttributeDescription> attributes;		// Binding 0
+	void (*encode)(const Vertex*, uint32_t, const VertexQuantization&, void*) = nullptr;
+};
+
+template<typename T>
+VertexLayoutInfo MakeVertexLayoutInfo(VertexFormat format)
+{
+	auto attributes = VertexLayout<T>::GetAttributeDescriptions();
+
+	VertexLayoutInfo info;
+	info.format = format;
+	info.stride = VertexLayout<T>::GetBindingDescription(0).stride;
+	info.boundsRelative = T::boundsRelative;
+	info.attributes.assign(attributes.begin(), attributes.end());
+	info.encode = &VertexLayout<T>::Encode;
+	return info;
+}
+
+VertexLayoutInfo GetVertexLayoutInfo(VertexFormat format);
+bool ParseVertexFormat(const std::string& name, VertexFormat* format);
+const char* GetVertexFormatName(VertexFormat format);
@@ -12,19 +12,68 @@ VulkanRenderer::~VulkanRenderer()
 int VulkanRenderer::Init(GLFWwindow* newWindow)
 {
 	window = newWindow;
+	headless = false;
 
+	return InitVulkan();
+}
+
+int VulkanRenderer::InitHeadless(uint32_t width, uint32_t height)
+{
+	// No window, surface or swapchain: render into offscreen images instead
+	window = nullptr;
+	headless = true;
+	swapchainExtent = { width, height };
+
+	return InitVulkan();
+}
+
+int VulkanRenderer::InitVulkan()
+{
 	try
 	{
 		CreateInstance();
 		CreateDebugMessenger();
-		CreateSurface();
+		if (!headless)
+		{
+			CreateSurface();
+		}
 		GetPhysicalDevice();
 		CreateLogicalDevice();	
-		CreateSwapchain();
+		ChooseVertexLayout();
+		allocator.Init(mainDevice.physicalDevice, mainDevice.logicalDevice, memoryBudgetSupported);
+		if (headless)
+		{
+			CreateOffscreenImages();
+		}
+		else
+		{
+			CreateSwapchain();
+		}
+		CreateDepthBufferImages();
 		CreateRenderPass();
+		CreateDescriptorSetLayout();
+		CreatePipelineCache();
+		CreatePipelineCompiler();
+
+		// Pipelines compile on worker threads while the rest of the renderer is set up
+		pipelineSubmitTime = std::chrono::steady_clock::now();
 		CreateGraphicsPipeline();
+		CreateComputePipeline();
+
 		CreateFramebuffers();
 		CreateCommandPool();
+		CreateUploadManager();
+		CreateGeometryPool();
+		CreateIndirectBuffers();
+		CreateInstanceBuffers();
+		CreateUniformAllocator();
+		CreateMaterialBuffers();
+		CreateTextureStreamer();
+		CreateDescriptorPool();
+		CreateDescriptorSets();
+
+		// Until a camera is set, frustum is the clip space volume itself
+		SetViewProjection(glm::mat4(1.0f));
 
 
 		// Create a mesh
@@ -49,15 +98,24 @@ int VulkanRenderer::Init(GLFWwindow* newWindow)
 			2, 3, 0
 		};
 
-		Mesh firstMesh = Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, &meshVertices, &meshIndices);
-		Mesh firstMesh2 = Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, &meshVertices2, &meshIndices);
-
-		meshList.push_back(firstMesh);
-		meshList.push_back(firstMesh2);
+		AddMesh(&meshVertices, &meshIndices);
+		AddMesh(&meshVertices2, &meshIndices);
 
+		// Command buffers are recorded in Draw, once the frame knows what it's drawing
 		CreateCommandBuffers();
-		RecordCommands();
+		CreateGpuProfiler();
+		CreateParallelRecorder();
 		CreateSynchronisation();
+
+		// Headless runs are judged by the images they write, so like synchronous mode they wait for every pipeline
+		if (!asyncPipelines || headless)
+		{
+			pipelineCompiler.WaitAll();
+		}
+		if (!UpdatePipelines())
+		{
+			return EXIT_FAILURE;
+		}
 	}
 	catch (const std::runtime_error &e)
 	{
@@ -68,22 +126,80 @@ int VulkanRenderer::Init(GLFWwindow* newWindow)
 	return 0;
 }
 
-void VulkanRenderer::Draw()
+int VulkanRenderer::Draw()
 {
+	// Hold frame back until it's due (returns straight away when no limit is set)
+	double limiterWaitTime = frameLimiter.Wait();
+	auto frameStart = std::chrono::steady_clock::now();
+	lastFrameTimings.limiterWaitTime = limiterWaitTime;
+	lastFrameTimings.frameInterval = frameLimiter.GetLastFrameInterval();
+
+	// Switch to pipelines that have finished compiling since last frame
+	// A required pipeline that failed ends the run here, before frame has touched any of its resources
+	if (!UpdatePipelines())
+	{
+		return EXIT_FAILURE;
+	}
+
 	// 1. Get next available image to draw to and set something to signal when we're finished with the image (a semaphore)
 	// -- GET NEXT IMAGE --
 	
 	// Wait for given fence to signal (open) from last draw before continuing
 	vkWaitForFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	auto fenceWaitEnd = std::chrono::steady_clock::now();
+	lastFrameTimings.fenceWaitTime = ElapsedMilliseconds(frameStart, fenceWaitEnd);
 	// Manually reset (close) fences
 	vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]);
 
+	// Reclaim staging space of upload batches that have finished
+	uploadManager.Update();
+
+	// Frame's uniform data has been read, so its region can be allocated from again
+	uniformAllocator.Reset(currentFrame);
+
+	// Frame's fence has signalled, so its queries from last time are ready
+	gpuProfiler.CollectResults(currentFrame);
+
+	// Destroy removed meshes no frame in flight can be using any more
+	ProcessMeshDeletions(false);
+
+	// Bindless slots freed by frames that have now finished can be handed out again
+	bindlessDescriptors.ReleaseFinished(frameNumber, false);
+
+	// Stream texture mips within this frame's upload limit (copies are submitted just ahead of frame's own commands)
+	VkCommandBuffer textureUploadBuffer = textureStreamer.Update(currentFrame, frameNumber);
+
+	// Bring frame's material table up to date, textures included (a reused recording still reads it through its bindless index)
+	UpdateMaterialBuffer(currentFrame);
+
+	if (headless)
+	{
+		DrawHeadless(textureUploadBuffer);
+		lastFrameTimings.acquireTime = 0.0;
+		lastFrameTimings.presentTime = 0.0;
+		lastFrameTimings.cpuFrameTime = ElapsedMilliseconds(frameStart, std::chrono::steady_clock::now());
+		return 0;
+	}
+
 	// Get index of next image to be drawn to, and signal semaphore when ready to be drawn to
+	auto acquireStart = std::chrono::steady_clock::now();
 	uint32_t imageIndex;
 	vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	lastFrameTimings.acquireTime = ElapsedMilliseconds(acquireStart, std::chrono::steady_clock::now());
+
+	// Record what's to be drawn this frame (or reuse last recording if nothing changed)
+	UpdateCommandBuffer(currentFrame, imageIndex);
 
 	// 2. Submit command buffer to queue for execution, making sure it waits for the image to be signalled as available before drawing and signals when it has finished rendering
 	// -- SUBMIT COMMAND BUFFER TO RENDER --
+	// Texture uploads (if any) go first, so their barriers cover frame's draws
+	std::vector<VkCommandBuffer> submitBuffers;
+	if (textureUploadBuffer != VK_NULL_HANDLE)
+	{
+		submitBuffers.push_back(textureUploadBuffer);
+	}
+	submitBuffers.push_back(commandBuffers[GetRecordingSlot(currentFrame, imageIndex)]);
+
 	// Queue submission information
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -93,8 +209,8 @@ void VulkanRenderer::Draw()
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 	};
 	submitInfo.pWaitDstStageMask = waitStages;						// Stages to check semaphores at
-	submitInfo.commandBufferCount = 1;								// Number of command buffers to submit
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];		// Command buffer to submit
+	submitInfo.commandBufferCount = static_cast<uint32_t>(submitBuffers.size());	// Number of command buffers to submit
+	submitInfo.pCommandBuffers = submitBuffers.data();								// Command buffers to submit (run in order)
 	submitInfo.signalSemaphoreCount = 1;							// Number of semaphores to signal
 	submitInfo.pSignalSemaphores = &renderFinished[currentFrame];	// Semaphores to signal when command buffer finishes
 
@@ -116,231 +232,843 @@ void VulkanRenderer::Draw()
 	presentInfo.pImageIndices = &imageIndex;				// Index of images in swapchains to present
 
 	// Present image
+	auto presentStart = std::chrono::steady_clock::now();
 	result = vkQueuePresentKHR(presentationQueue, &presentInfo);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to present Image!");
 	}
+	auto presentEnd = std::chrono::steady_clock::now();
+	lastFrameTimings.presentTime = ElapsedMilliseconds(presentStart, presentEnd);
 
 	// Get next frame (use % MAX_FRAME_DRAWS to keep value below MAX_FRAME_DRAWS)
 	currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+	frameNumber++;
+
+	lastFrameTimings.cpuFrameTime = ElapsedMilliseconds(frameStart, presentEnd);
+
+	return 0;
 }
 
-void VulkanRenderer::Cleanup()
+void VulkanRenderer::DrawHeadless(VkCommandBuffer textureUploadBuffer)
 {
-	// Wait until no actions being run on device before destroying
-	vkDeviceWaitIdle(mainDevice.logicalDevice);
+	// One offscreen image per frame in flight, so the frame's fence (already waited on) also guards its image
+	uint32_t imageIndex = currentFrame;
 
-	for (size_t i = 0; i < meshList.size(); i++)
-	{
-		meshList[i].DestroyBuffers();
-	}
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
-	{
-		vkDestroySemaphore(mainDevice.logicalDevice, renderFinished[i], nullptr);
-		vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
-		vkDestroyFence(mainDevice.logicalDevice, drawFences[i], nullptr);
-	}
-	vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
-	for (auto framebuffer : swapchainFramebuffers)
-	{
-		vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
-	}
-	vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
-	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
-	for (auto image : swapchainImages)
+	UpdateCommandBuffer(currentFrame, imageIndex);
+
+	std::vector<VkCommandBuffer> submitBuffers;
+	if (textureUploadBuffer != VK_NULL_HANDLE)
 	{
-		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
+		submitBuffers.push_back(textureUploadBuffer);
 	}
-	vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, nullptr);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
-	vkDestroyDevice(mainDevice.logicalDevice, nullptr);
-	if (enableValidationLayers)
+	submitBuffers.push_back(commandBuffers[GetRecordingSlot(currentFrame, imageIndex)]);
+
+	// Nothing to acquire or present, so no semaphores to wait on or signal
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = static_cast<uint32_t>(submitBuffers.size());
+	submitInfo.pCommandBuffers = submitBuffers.data();
+
+	VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, drawFences[currentFrame]);
+	if (result != VK_SUCCESS)
 	{
-		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+		throw std::runtime_error("Failed to submit Command Buffer to Queue!");
 	}
-	vkDestroyInstance(instance, nullptr);
+
+	lastRenderedImage = imageIndex;
+	currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+	frameNumber++;
 }
 
-void VulkanRenderer::CreateInstance()
+int VulkanRenderer::AddMesh(std::vector<Vertex>* vertices, std::vector<uint32_t>* indices)
 {
-	// Information about application itself
-	// Most data here doesn't affect the program and is for developer convenience
-	VkApplicationInfo appInfo = {};
-	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-	appInfo.pApplicationName = "Vulkan App";					// Custom name of the application
-	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);		// Custom version of the application
-	appInfo.pEngineName = "No Engine";							// Custom engine name
-	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);			// Custom engine version
-	appInfo.apiVersion = VK_API_VERSION_1_2;					// The Vulkan Version
-
-	// Create information for a VkInstance (Vulkan Instance)
-	VkInstanceCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-	createInfo.pApplicationInfo = &appInfo;
+	return AddMesh(vertices->data(), static_cast<uint32_t>(vertices->size()), indices->data(), static_cast<uint32_t>(indices->size()));
+}
 
-	// Create list to hold instance extensions
-	//std::vector<const char*> instaneExtensions = std::vector<const char*>();
+int VulkanRenderer::AddMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+	// Data can come straight from a mapped file, it's only read while being staged
+	return CreateMesh(vertices, vertexCount, indices, indexCount, nullptr);
+}
 
-	// Set up extensions Instance will use
-	//uint32_t glfwExtensionCount = 0;		// GLFW may require multiple extensions
-	//const char** glfwExtensions;			// Extensions passed as array of cstrings, so need pointer (the array) to pointer (the cstring)
+int VulkanRenderer::LoadMesh(const std::string& filename)
+{
+	// Blobs are streamed from mapped file pages into staging, file is unmapped again once uploads are staged
+	MeshFile meshFile(filename);
+	MeshBounds bounds = meshFile.GetBounds();
 
-	// Get GLFW extensions
-	//glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	return CreateMesh(meshFile.GetVertices(), meshFile.GetVertexCount(), meshFile.GetIndices(), meshFile.GetIndexCount(), &bounds);
+}
 
-	// Add GLFW extensions to list of extensions
-	/*for (size_t i = 0; i < glfwExtensionCount; i++)
+int VulkanRenderer::CreateMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const MeshBounds* knownBounds)
+{
+	// Meshes small enough are always stored with 16 bit indices
+	if (!meshOptimization && !lodGeneration)
 	{
-		instaneExtensions.push_back(glfwExtensions[i]);
-	}*/
+		return InsertMesh(Mesh(&geometryPool, vertices, vertexCount, indices, indexCount, knownBounds, true));
+	}
 
-	// Check Instance Extensions supported...
-	/*if (!CheckInstanceExtensionSupport(&instaneExtensions))
+	// Optimizer and simplifier work on their own copy (source may be read only mapped memory)
+	// Dropping unused vertices can only shrink the mesh, so known bounds still enclose it
+	std::vector<Vertex> meshVertices(vertices, vertices + vertexCount);
+	std::vector<uint32_t> meshIndices(indices, indices + indexCount);
+
+	if (meshOptimization)
 	{
-		throw std::runtime_error("VkInstance does not support required extensions!");
-	}*/
+		MeshOptimizationReport report = OptimizeMesh(meshVertices, meshIndices);
 
-	/*createInfo.enabledExtensionCount = static_cast<uint32_t>(instaneExtensions.size());
-	createInfo.ppEnabledExtensionNames = instaneExtensions.data();*/
-	auto extensions = GetRequiredExtensions();
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-	createInfo.ppEnabledExtensionNames = extensions.data();
+		printf("Mesh optimized: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %u -> %u vertices, %s indices\n",
+			report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr,
+			vertexCount, report.vertexCount, report.fitsIn16BitIndices ? "16 bit" : "32 bit");
+	}
 
-	// TODO: Set up Validation Layers that Instance will use
-	//createInfo.enabledLayerCount = 0;
-	//createInfo.ppEnabledLayerNames = nullptr;
-	VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = {};
-	if (enableValidationLayers)
+	// Simplified LODs index the same vertices, so they only add index data
+	std::vector<LodLevel> lodLevels;
+	if (lodGeneration)
 	{
-		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-		createInfo.ppEnabledLayerNames = validationLayers.data();
+		lodLevels = GenerateLodChain(meshVertices, meshIndices, MAX_MESH_LODS - 1);
 
-		PopulateDebugMessengerCreateInfo(debugCreateInfo);
-		createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+		std::string triangleCounts = std::to_string(meshIndices.size() / 3);
+		for (auto& level : lodLevels)
+		{
+			if (meshOptimization)
+			{
+				OptimizeVertexCache(level.indices, static_cast<uint32_t>(meshVertices.size()));
+			}
+			triangleCounts += ", " + std::to_string(level.indices.size() / 3);
+		}
+
+		printf("Mesh LODs: %zu generated (%s triangles)\n", lodLevels.size(), triangleCounts.c_str());
 	}
-	else
+
+	return InsertMesh(Mesh(&geometryPool, meshVertices.data(), static_cast<uint32_t>(meshVertices.size()),
+		meshIndices.data(), static_cast<uint32_t>(meshIndices.size()), knownBounds, true, &lodLevels));
+}
+
+int VulkanRenderer::InsertMesh(const Mesh& mesh)
+{
+	// Submit staged mesh data (queue order guarantees it lands before the next draw)
+	uploadManager.Flush();
+
+	// Reuse slot of a removed mesh if there is one, so ids stay small
+	int meshId;
+	if (!freeMeshIds.empty())
 	{
-		createInfo.enabledLayerCount = 0;
-		createInfo.pNext = nullptr;
+		meshId = freeMeshIds.back();
+		freeMeshIds.pop_back();
+		meshList[meshId] = mesh;
+		meshActive[meshId] = true;
+		meshVisible[meshId] = true;
+		meshInstances[meshId].clear();
+		meshTransforms[meshId] = glm::mat4(1.0f);
+		meshMaterials[meshId] = 0;
 	}
-
-	if (enableValidationLayers && !CheckValidationLayerSupport())
+	else
 	{
-		throw std::runtime_error("Validation layers requested, but not available!");
+		meshId = static_cast<int>(meshList.size());
+		meshList.push_back(mesh);
+		meshActive.push_back(true);
+		meshVisible.push_back(true);
+		meshInstances.emplace_back();
+		meshTransforms.push_back(glm::mat4(1.0f));
+		meshMaterials.push_back(0);
 	}
 
-	// Create instance
-	VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
+	sceneVersion++;
 
-	if (result != VK_SUCCESS)
+	return meshId;
+}
+
+void VulkanRenderer::RemoveMesh(int meshId)
+{
+	if (meshId < 0 || meshId >= static_cast<int>(meshList.size()) || !meshActive[meshId])
 	{
-		throw std::runtime_error("Failed to create a Vulkan Instance!");
+		return;
 	}
+
+	// Frames in flight may still draw the mesh, so its geometry is released later
+	pendingMeshDeletions.push_back({ meshList[meshId], frameNumber });
+
+	meshActive[meshId] = false;
+	meshVisible[meshId] = false;
+	meshInstances[meshId].clear();
+	freeMeshIds.push_back(meshId);
+
+	sceneVersion++;
 }
 
-void VulkanRenderer::CreateDebugMessenger()
+void VulkanRenderer::SetMeshVisible(int meshId, bool visible)
 {
-	// Only create message if validation enabled
-	if (!enableValidationLayers)
+	if (meshId < 0 || meshId >= static_cast<int>(meshList.size()) || !meshActive[meshId] || meshVisible[meshId] == visible)
 	{
 		return;
 	}
 
-	VkDebugUtilsMessengerCreateInfoEXT debugInfo;
-	PopulateDebugMessengerCreateInfo(debugInfo);
+	meshVisible[meshId] = visible;
+	sceneVersion++;
+}
 
-	// Create debug message with custom create function
-	if (CreateDebugUtilsMessengerEXT(instance, &debugInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+int VulkanRenderer::AddInstance(int meshId, const glm::mat4& transform)
+{
+	if (meshId < 0 || meshId >= static_cast<int>(meshList.size()) || !meshActive[meshId])
 	{
-		throw std::runtime_error("Failed to set up debug messenger!");
+		throw std::runtime_error("Failed to add Instance, Mesh does not exist!");
 	}
+
+	// Once a mesh has instances it is drawn once per instance, instead of once untransformed
+	meshInstances[meshId].push_back(transform);
+	sceneVersion++;
+
+	return static_cast<int>(meshInstances[meshId].size()) - 1;
 }
 
-void VulkanRenderer::CreateLogicalDevice()
+void VulkanRenderer::SetInstanceTransform(int meshId, int instanceIndex, const glm::mat4& transform)
 {
-	// Get the queue family indices for the chosen Physical Device
-	QueueFamilyIndices indices = GetQueueFamilies(mainDevice.physicalDevice);
+	if (meshId < 0 || meshId >= static_cast<int>(meshList.size()) || !meshActive[meshId] ||
+		instanceIndex < 0 || instanceIndex >= static_cast<int>(meshInstances[meshId].size()))
+	{
+		return;
+	}
 
-	// Vector for queue creation information, and set for family indices
-	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> queueFamilyIndices = { indices.graphicsFamily, indices.presentationFamily };
+	// Instance buffer is rewritten whenever commands are recorded, so a new version is all that's needed
+	meshInstances[meshId][instanceIndex] = transform;
+	sceneVersion++;
+}
 
-	// Queues the logical device needs to create and info to do so
-	for (int queueFamilyIndex : queueFamilyIndices)
+void VulkanRenderer::SetMeshTransform(int meshId, const glm::mat4& transform)
+{
+	if (meshId < 0 || meshId >= static_cast<int>(meshList.size()) || !meshActive[meshId])
 	{
-		VkDeviceQueueCreateInfo queueCreateInfo = {};
-		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo.queueFamilyIndex = queueFamilyIndex;				// The index of the family to create a queue from
-		queueCreateInfo.queueCount = 1;										// Number of queue to create
-		float priority = 1.0;
-		queueCreateInfo.pQueuePriorities = &priority;						// Vulkan needs to know how to handle multiple queues, so decide priority (1 = highest priority)
+		return;
+	}
 
-		queueCreateInfos.push_back(queueCreateInfo);
+	// Pushed with each of the mesh's draws (or folded into its instances for indirect draws) when commands are recorded
+	meshTransforms[meshId] = transform;
+	sceneVersion++;
+}
+
+int VulkanRenderer::CreateMaterial(const Material& material)
+{
+	if (materials.size() >= MAX_MATERIALS)
+	{
+		throw std::runtime_error("Failed to create Material, material table is full!");
 	}
 
-	// Information to create logical device (sometimes called "device")
-	VkDeviceCreateInfo deviceCreateInfo = {};		// Creating an empty struct
-	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());		// Number of Queue Create Infos
-	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();								// List of queue infos so device can create required queues
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());	// Number of enabled logical device extensions
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();							// List of enabled logical device extensions
+	materials.push_back(material);
+	materialsVersion++;
 
-	// Physical Device Features the Logical Device will be using
-	VkPhysicalDeviceFeatures deviceFeatures = {};
+	return static_cast<int>(materials.size()) - 1;
+}
 
-	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;				// Physical Device features Logical Device will use
+void VulkanRenderer::SetMaterial(int materialId, const Material& material)
+{
+	if (materialId < 0 || materialId >= static_cast<int>(materials.size()))
+	{
+		return;
+	}
 
-	// Create the logical device for the given physical device
-	VkResult result = vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, nullptr, &mainDevice.logicalDevice);
-	if (result != VK_SUCCESS)
+	// Each frame copies the table into its own buffer before it's next drawn, so frames in flight keep their copy
+	// Texture sizes are requested while recording, so a changed texture needs recording again
+	materials[materialId] = material;
+	materialsVersion++;
+	sceneVersion++;
+}
+
+void VulkanRenderer::SetMeshMaterial(int meshId, int materialId)
+{
+	if (meshId < 0 || meshId >= static_cast<int>(meshList.size()) || !meshActive[meshId] ||
+		materialId < 0 || materialId >= static_cast<int>(materials.size()))
 	{
-		throw std::runtime_error("Failed to create a Logical Device!");
+		return;
 	}
 
-	// Queues are created at the same time as the device...
-	// So we want handle to queues
-	// From given logical device, of given Queue Family, of given Queue Index (0 since only one queue), place reference in given VkQueue
-	vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
-	vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+	// Material index is written to each instance, so instances need rewriting
+	meshMaterials[meshId] = static_cast<uint32_t>(materialId);
+	sceneVersion++;
 }
 
-void VulkanRenderer::CreateSurface()
+int VulkanRenderer::CreateTexture(uint32_t width, uint32_t height, const void* pixels)
 {
-	// Create Surface (creates a surface create info struct, runs the create surface function, returns result)
-	VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
+	// RGBA8 pixels, copied (with mips generated from them) so caller's pixels can go straight away
+	// Texture is referenced from materials by the id returned, and only its mip tail is resident until it's drawn
+	return textureStreamer.CreateTexture(width, height, pixels);
+}
 
-	if (result != VK_SUCCESS)
+void VulkanRenderer::ClearInstances(int meshId)
+{
+	if (meshId < 0 || meshId >= static_cast<int>(meshList.size()) || meshInstances[meshId].empty())
 	{
-		throw std::runtime_error("Failed to create a surface!");
+		return;
 	}
+
+	meshInstances[meshId].clear();
+	sceneVersion++;
 }
 
-void VulkanRenderer::CreateSwapchain()
+void VulkanRenderer::SetDirtyTracking(bool enabled)
 {
-	// Get Swap Chain details so we can pick best settings
-	SwapchainDetails swapChainDetails = GetSwapchainDetails(mainDevice.physicalDevice);
+	dirtyTracking = enabled;
+}
 
-	// Find optimal surface values for our swap chain
-	// Choose best surface format
-	VkSurfaceFormatKHR surfaceFormat = ChooseBestSurfaceFormat(swapChainDetails.formats);
-	// Choose best presentation mode
-	VkPresentModeKHR presentMode = ChooseBestPresentationMode(swapChainDetails.presentationModes);
-	// Chose swap chain image resolution
-	VkExtent2D extent = ChooseSwapExtent(swapChainDetails.surfaceCapabilities);
+void VulkanRenderer::SetIndirectDraw(bool enabled)
+{
+	indirectDrawEnabled = enabled;
+	sceneVersion++;
+}
 
-	// How many images are in the swap chain? Get 1 more than the minium to allow triple buffering
-	uint32_t imageCount = swapChainDetails.surfaceCapabilities.minImageCount + 1;
+void VulkanRenderer::SetGpuCulling(bool enabled)
+{
+	gpuCullingEnabled = enabled;
+	sceneVersion++;
+}
 
-	// If imageCount higher than max, then clamp down to max, and if 0 then limitless
-	if (swapChainDetails.surfaceCapabilities.maxImageCount > 0 && swapChainDetails.surfaceCapabilities.maxImageCount < imageCount)
-	{
-		imageCount = swapChainDetails.surfaceCapabilities.maxImageCount;
-	}
+void VulkanRenderer::SetPipelineCachePath(const std::string& path)
+{
+	// Must be set before Init
+	pipelineCachePath = path;
+}
 
-	// Creation information for swap chain
+void VulkanRenderer::SetVertexFormat(VertexFormat format)
+{
+	// Must be set before Init
+	vertexFormat = format;
+}
+
+void VulkanRenderer::SetMeshOptimization(bool enabled)
+{
+	// Applies to meshes added afterwards
+	meshOptimization = enabled;
+}
+
+void VulkanRenderer::SetLodGeneration(bool enabled)
+{
+	// Applies to meshes added afterwards
+	lodGeneration = enabled;
+}
+
+void VulkanRenderer::SetLodErrorThreshold(float pixels)
+{
+	// 0 keeps every mesh at full detail
+	lodErrorThreshold = pixels;
+	sceneVersion++;
+}
+
+void VulkanRenderer::SetDepthPrepass(bool enabled)
+{
+	// Must be set before Init (pre-pass pipeline and colour pipeline's depth test are chosen when pipelines are created)
+	depthPrepass = enabled;
+}
+
+void VulkanRenderer::SetPresentMode(VkPresentModeKHR mode)
+{
+	// Must be set before Init (falls back to FIFO if surface doesn't support it)
+	requestedPresentMode = mode;
+}
+
+void VulkanRenderer::SetFrameLimit(double targetFrameTime)
+{
+	// Milliseconds per frame, 0 to draw as fast as present mode allows
+	frameLimiter.SetTargetFrameTime(targetFrameTime);
+}
+
+void VulkanRenderer::SetAsyncPipelines(bool enabled)
+{
+	// Must be set before Init (when disabled, Init waits for every pipeline to compile like it used to)
+	asyncPipelines = enabled;
+}
+
+void VulkanRenderer::SetTextureBudget(VkDeviceSize bytes)
+{
+	// Most memory textures may use (0 = as much as device budget allows), mips are dropped when over it
+	textureStreamer.SetBudget(bytes);
+}
+
+void VulkanRenderer::SetTextureUploadLimit(VkDeviceSize bytes)
+{
+	// Must be set before Init (sizes each frame's texture staging buffer)
+	textureUploadLimit = bytes;
+}
+
+void VulkanRenderer::SetViewProjection(const glm::mat4& newViewProjection)
+{
+	// Extract frustum planes from rows of view-projection matrix (Vulkan clip space, 0 <= z <= w)
+	// glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	auto row = [&newViewProjection](int i)
+	{
+		return glm::vec4(newViewProjection[0][i], newViewProjection[1][i], newViewProjection[2][i], newViewProjection[3][i]);
+	};
+
+	frustumPlanes[0] = row(3) + row(0);		// Left
+	frustumPlanes[1] = row(3) - row(0);		// Right
+	frustumPlanes[2] = row(3) + row(1);		// Bottom
+	frustumPlanes[3] = row(3) - row(1);		// Top
+	frustumPlanes[4] = row(2);				// Near
+	frustumPlanes[5] = row(3) - row(2);		// Far
+
+	// Normalise so distance to plane can be compared against sphere radius
+	for (auto& plane : frustumPlanes)
+	{
+		float length = glm::length(glm::vec3(plane.x, plane.y, plane.z));
+		if (length > 0.0f)
+		{
+			plane = plane / length;
+		}
+	}
+
+	// Kept for LOD selection
+	viewProjection = newViewProjection;
+
+	// Planes are recorded into command buffers as push constants (and LODs picked from the camera)
+	sceneVersion++;
+}
+
+bool VulkanRenderer::ReadbackImage(std::vector<uint8_t>& pixels)
+{
+	if (!headless)
+	{
+		return false;
+	}
+
+	// Wait for frame that rendered the image to finish
+	vkQueueWaitIdle(graphicsQueue);
+
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(swapchainExtent.width) * swapchainExtent.height * 4;
+
+	// Host visible buffer to copy the image in to
+	VkBuffer readbackBuffer;
+	Allocation readbackBufferAllocation;
+	CreateBuffer(mainDevice.logicalDevice, &allocator, imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&readbackBuffer, &readbackBufferAllocation, MEMORY_TAG_STAGING);
+
+	VkCommandBuffer readbackCommandBuffer;
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = graphicsCommandPool;
+	allocInfo.commandBufferCount = 1;
+
+	vkAllocateCommandBuffers(mainDevice.logicalDevice, &allocInfo, &readbackCommandBuffer);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(readbackCommandBuffer, &beginInfo);
+
+	// Render pass leaves offscreen images in TRANSFER_SRC_OPTIMAL, so copy straight out of it
+	VkBufferImageCopy imageCopyRegion = {};
+	imageCopyRegion.bufferOffset = 0;
+	imageCopyRegion.bufferRowLength = 0;								// 0 = tightly packed
+	imageCopyRegion.bufferImageHeight = 0;
+	imageCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageCopyRegion.imageSubresource.mipLevel = 0;
+	imageCopyRegion.imageSubresource.baseArrayLayer = 0;
+	imageCopyRegion.imageSubresource.layerCount = 1;
+	imageCopyRegion.imageOffset = { 0, 0, 0 };
+	imageCopyRegion.imageExtent = { swapchainExtent.width, swapchainExtent.height, 1 };
+
+	vkCmdCopyImageToBuffer(readbackCommandBuffer, swapchainImages[lastRenderedImage].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		readbackBuffer, 1, &imageCopyRegion);
+
+	vkEndCommandBuffer(readbackCommandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &readbackCommandBuffer;
+
+	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(graphicsQueue);
+
+	vkFreeCommandBuffers(mainDevice.logicalDevice, graphicsCommandPool, 1, &readbackCommandBuffer);
+
+	// Copy out of mapped readback memory
+	pixels.resize(static_cast<size_t>(imageSize));
+	memcpy(pixels.data(), readbackBufferAllocation.mappedData, static_cast<size_t>(imageSize));
+
+	DestroyBuffer(mainDevice.logicalDevice, &allocator, readbackBuffer, &readbackBufferAllocation);
+
+	return true;
+}
+
+VkExtent2D VulkanRenderer::GetRenderExtent()
+{
+	return swapchainExtent;
+}
+
+VkPhysicalDeviceProperties VulkanRenderer::GetDeviceProperties()
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+	return deviceProperties;
+}
+
+const FrameTimings& VulkanRenderer::GetLastFrameTimings()
+{
+	return lastFrameTimings;
+}
+
+FramePacingStatistics VulkanRenderer::GetFramePacingStatistics()
+{
+	return frameLimiter.GetStatistics();
+}
+
+TextureStreamingStatistics VulkanRenderer::GetTextureStreamingStatistics()
+{
+	return textureStreamer.GetStatistics();
+}
+
+MemoryStatistics VulkanRenderer::GetMemoryStatistics()
+{
+	return allocator.GetStatistics();
+}
+
+void VulkanRenderer::LogMemoryStatistics()
+{
+	allocator.LogStatistics();
+}
+
+GpuProfiler& VulkanRenderer::GetGpuProfiler()
+{
+	return gpuProfiler;
+}
+
+void VulkanRenderer::Cleanup()
+{
+	// Wait until no actions being run on device before destroying
+	vkDeviceWaitIdle(mainDevice.logicalDevice);
+
+	uploadManager.Destroy();
+	ProcessMeshDeletions(true);
+	for (size_t i = 0; i < meshList.size(); i++)
+	{
+		if (meshActive[i])
+		{
+			meshList[i].Destroy();
+		}
+	}
+	geometryPool.Destroy();
+	uniformAllocator.Destroy();
+	for (size_t i = 0; i < materialBuffers.size(); i++)
+	{
+		DestroyBuffer(mainDevice.logicalDevice, &allocator, materialBuffers[i], &materialBufferAllocations[i]);
+	}
+	textureStreamer.Destroy();
+	bindlessDescriptors.Destroy();
+	for (size_t i = 0; i < indirectBuffers.size(); i++)
+	{
+		DestroyBuffer(mainDevice.logicalDevice, &allocator, indirectBuffers[i], &indirectBufferAllocations[i]);
+		DestroyBuffer(mainDevice.logicalDevice, &allocator, cullObjectBuffers[i], &cullObjectBufferAllocations[i]);
+		DestroyBuffer(mainDevice.logicalDevice, &allocator, instanceBuffers[i], &instanceBufferAllocations[i]);
+	}
+	vkDestroyDescriptorPool(mainDevice.logicalDevice, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, cullSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, uniformSetLayout, nullptr);
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		vkDestroySemaphore(mainDevice.logicalDevice, renderFinished[i], nullptr);
+		vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
+		vkDestroyFence(mainDevice.logicalDevice, drawFences[i], nullptr);
+	}
+	gpuProfiler.Destroy();
+	parallelRecorder.Destroy();
+	for (auto commandPool : recordingCommandPools)
+	{
+		vkDestroyCommandPool(mainDevice.logicalDevice, commandPool, nullptr);
+	}
+	vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
+	for (auto framebuffer : swapchainFramebuffers)
+	{
+		vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
+	}
+	// Waits for pipelines still compiling, then destroys every pipeline (before the layouts and cache they were made with)
+	pipelineCompiler.Destroy();
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, cullPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
+	pipelineCache.Save();
+	pipelineCache.Destroy();
+	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
+	for (size_t i = 0; i < depthBufferImages.size(); i++)
+	{
+		vkDestroyImageView(mainDevice.logicalDevice, depthBufferImageViews[i], nullptr);
+		vkDestroyImage(mainDevice.logicalDevice, depthBufferImages[i], nullptr);
+		allocator.Free(depthBufferImageAllocations[i]);
+	}
+	for (auto image : swapchainImages)
+	{
+		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
+	}
+	if (headless)
+	{
+		// Offscreen images are owned by us, rather than the swapchain
+		for (size_t i = 0; i < swapchainImages.size(); i++)
+		{
+			vkDestroyImage(mainDevice.logicalDevice, swapchainImages[i].image, nullptr);
+			allocator.Free(offscreenImageAllocations[i]);
+		}
+	}
+	else
+	{
+		vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, nullptr);
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
+	allocator.Destroy();
+	vkDestroyDevice(mainDevice.logicalDevice, nullptr);
+	if (enableValidationLayers)
+	{
+		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+	}
+	vkDestroyInstance(instance, nullptr);
+}
+
+void VulkanRenderer::CreateInstance()
+{
+	// Information about application itself
+	// Most data here doesn't affect the program and is for developer convenience
+	VkApplicationInfo appInfo = {};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "Vulkan App";					// Custom name of the application
+	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);		// Custom version of the application
+	appInfo.pEngineName = "No Engine";							// Custom engine name
+	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);			// Custom engine version
+	appInfo.apiVersion = VK_API_VERSION_1_2;					// The Vulkan Version
+
+	// Create information for a VkInstance (Vulkan Instance)
+	VkInstanceCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	createInfo.pApplicationInfo = &appInfo;
+
+	// Create list to hold instance extensions
+	//std::vector<const char*> instaneExtensions = std::vector<const char*>();
+
+	// Set up extensions Instance will use
+	//uint32_t glfwExtensionCount = 0;		// GLFW may require multiple extensions
+	//const char** glfwExtensions;			// Extensions passed as array of cstrings, so need pointer (the array) to pointer (the cstring)
+
+	// Get GLFW extensions
+	//glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+	// Add GLFW extensions to list of extensions
+	/*for (size_t i = 0; i < glfwExtensionCount; i++)
+	{
+		instaneExtensions.push_back(glfwExtensions[i]);
+	}*/
+
+	// Check Instance Extensions supported...
+	/*if (!CheckInstanceExtensionSupport(&instaneExtensions))
+	{
+		throw std::runtime_error("VkInstance does not support required extensions!");
+	}*/
+
+	/*createInfo.enabledExtensionCount = static_cast<uint32_t>(instaneExtensions.size());
+	createInfo.ppEnabledExtensionNames = instaneExtensions.data();*/
+	auto extensions = GetRequiredExtensions();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
+
+	// TODO: Set up Validation Layers that Instance will use
+	//createInfo.enabledLayerCount = 0;
+	//createInfo.ppEnabledLayerNames = nullptr;
+	VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = {};
+	if (enableValidationLayers)
+	{
+		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+		createInfo.ppEnabledLayerNames = validationLayers.data();
+
+		PopulateDebugMessengerCreateInfo(debugCreateInfo);
+		createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+	}
+	else
+	{
+		createInfo.enabledLayerCount = 0;
+		createInfo.pNext = nullptr;
+	}
+
+	if (enableValidationLayers && !CheckValidationLayerSupport())
+	{
+		throw std::runtime_error("Validation layers requested, but not available!");
+	}
+
+	// Create instance
+	VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Vulkan Instance!");
+	}
+}
+
+void VulkanRenderer::CreateDebugMessenger()
+{
+	// Only create message if validation enabled
+	if (!enableValidationLayers)
+	{
+		return;
+	}
+
+	VkDebugUtilsMessengerCreateInfoEXT debugInfo;
+	PopulateDebugMessengerCreateInfo(debugInfo);
+
+	// Create debug message with custom create function
+	if (CreateDebugUtilsMessengerEXT(instance, &debugInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to set up debug messenger!");
+	}
+}
+
+void VulkanRenderer::CreateLogicalDevice()
+{
+	// Get the queue family indices for the chosen Physical Device
+	QueueFamilyIndices indices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	// Vector for queue creation information, and set for family indices
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+	std::set<int> queueFamilyIndices = { indices.graphicsFamily, indices.presentationFamily, indices.transferFamily };
+
+	// Queues the logical device needs to create and info to do so
+	for (int queueFamilyIndex : queueFamilyIndices)
+	{
+		VkDeviceQueueCreateInfo queueCreateInfo = {};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = queueFamilyIndex;				// The index of the family to create a queue from
+		queueCreateInfo.queueCount = 1;										// Number of queue to create
+		float priority = 1.0;
+		queueCreateInfo.pQueuePriorities = &priority;						// Vulkan needs to know how to handle multiple queues, so decide priority (1 = highest priority)
+
+		queueCreateInfos.push_back(queueCreateInfo);
+	}
+
+	// Information to create logical device (sometimes called "device")
+	VkDeviceCreateInfo deviceCreateInfo = {};		// Creating an empty struct
+	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());		// Number of Queue Create Infos
+	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();								// List of queue infos so device can create required queues
+	std::vector<const char*> extensions = GetRequiredDeviceExtensions();
+
+	// Memory budget is optional: texture streaming falls back to a fixed share of the heap without it
+	memoryBudgetSupported = CheckDeviceExtensionAvailable(mainDevice.physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudgetSupported)
+	{
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());			// Number of enabled logical device extensions
+	deviceCreateInfo.ppEnabledExtensionNames = extensions.data();								// List of enabled logical device extensions
+
+	// Physical Device Features the Logical Device will be using
+	VkPhysicalDeviceFeatures deviceFeatures = {};
+
+	// Pipeline statistics queries are optional, so only turn them on if the device has them
+	// Draws are recorded in secondary command buffers, so query must also be inheritable by them
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(mainDevice.physicalDevice, &supportedFeatures);
+	pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE && supportedFeatures.inheritedQueries == VK_TRUE;
+	deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+	deviceFeatures.inheritedQueries = pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+
+	// Multi draw indirect lets one indirect draw cover the whole mesh list (otherwise fall back to a draw per mesh)
+	multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+
+	// Indirect draws pick each mesh's instances with firstInstance, which must be non-zero for all but the first mesh
+	drawIndirectFirstInstanceSupported = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+	// Indirect count (Vulkan 1.2) reads number of draws from a buffer, so it can later be decided on GPU
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+
+	VkPhysicalDeviceVulkan12Features supportedVulkan12Features = {};
+	supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+		supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures2.pNext = &supportedVulkan12Features;
+		vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &supportedFeatures2);
+	}
+	drawIndirectCountSupported = supportedVulkan12Features.drawIndirectCount == VK_TRUE;
+
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.drawIndirectCount = supportedVulkan12Features.drawIndirectCount;
+	BindlessDescriptors::EnableFeatures(&deviceFeatures, &vulkan12Features);	// Device was only picked if it supports them
+	if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		deviceCreateInfo.pNext = &vulkan12Features;
+	}
+
+	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;				// Physical Device features Logical Device will use
+
+	// Create the logical device for the given physical device
+	VkResult result = vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, nullptr, &mainDevice.logicalDevice);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Logical Device!");
+	}
+
+	// Queues are created at the same time as the device...
+	// So we want handle to queues
+	// From given logical device, of given Queue Family, of given Queue Index (0 since only one queue), place reference in given VkQueue
+	vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
+	vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+	vkGetDeviceQueue(mainDevice.logicalDevice, indices.transferFamily, 0, &transferQueue);
+}
+
+void VulkanRenderer::ChooseVertexLayout()
+{
+	vertexLayout = GetVertexLayoutInfo(vertexFormat);
+
+	// Every attribute format of layout must be readable from a vertex buffer
+	for (const auto& attribute : vertexLayout.attributes)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(mainDevice.physicalDevice, attribute.format, &formatProperties);
+		if ((formatProperties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) == 0)
+		{
+			printf("Vertex format %s not supported by device, using float\n", GetVertexFormatName(vertexFormat));
+			vertexLayout = GetVertexLayoutInfo(VERTEX_FORMAT_FLOAT);
+			break;
+		}
+	}
+}
+
+void VulkanRenderer::CreateSurface()
+{
+	// Create Surface (creates a surface create info struct, runs the create surface function, returns result)
+	VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a surface!");
+	}
+}
+
+void VulkanRenderer::CreateSwapchain()
+{
+	// Get Swap Chain details so we can pick best settings
+	SwapchainDetails swapChainDetails = GetSwapchainDetails(mainDevice.physicalDevice);
+
+	// Find optimal surface values for our swap chain
+	// Choose best surface format
+	VkSurfaceFormatKHR surfaceFormat = ChooseBestSurfaceFormat(swapChainDetails.formats);
+	// Choose best presentation mode
+	VkPresentModeKHR presentMode = ChooseBestPresentationMode(swapChainDetails.presentationModes);
+	// Chose swap chain image resolution
+	VkExtent2D extent = ChooseSwapExtent(swapChainDetails.surfaceCapabilities);
+
+	// How many images are in the swap chain? Get 1 more than the minium to allow triple buffering
+	uint32_t imageCount = swapChainDetails.surfaceCapabilities.minImageCount + 1;
+
+	// If imageCount higher than max, then clamp down to max, and if 0 then limitless
+	if (swapChainDetails.surfaceCapabilities.maxImageCount > 0 && swapChainDetails.surfaceCapabilities.maxImageCount < imageCount)
+	{
+		imageCount = swapChainDetails.surfaceCapabilities.maxImageCount;
+	}
+
+	// Creation information for swap chain
 	VkSwapchainCreateInfoKHR swapChainCreateInfo = {};
 	swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	swapChainCreateInfo.surface = surface;														// Swapchain surface
@@ -355,424 +1083,1225 @@ void VulkanRenderer::CreateSwapchain()
 	swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;						// How to handle blending images with external graphics (e.g. other windows)
 	swapChainCreateInfo.clipped = VK_TRUE;														// Whether to clip parts of image not in view (e.g. behind another window, off screen, etc)
 
-	// Get Queue Family Indices
-	QueueFamilyIndices indices = GetQueueFamilies(mainDevice.physicalDevice);
+	// Get Queue Family Indices
+	QueueFamilyIndices indices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	// If Graphics and Presentation families are diffrent, then swapchain must let images be shared between families
+	if (indices.graphicsFamily != indices.presentationFamily)
+	{
+		// Queues to share between
+		uint32_t queueFamilyIndices[] = {
+			(uint32_t)indices.graphicsFamily,
+			(uint32_t)indices.presentationFamily
+		};
+
+		swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;		// Image share handling
+		swapChainCreateInfo.queueFamilyIndexCount = 2;							// Number of queue to share images between
+		swapChainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;			// Array of queues to share between
+	}
+	else
+	{
+		swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		swapChainCreateInfo.queueFamilyIndexCount = 0;							
+		swapChainCreateInfo.pQueueFamilyIndices = nullptr;
+	}
+
+	// If old swap chain been destroyed and this one replaces it, then link old one to quickly hand over responsibilities
+	swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+
+	// Create Swapchain
+	VkResult result = vkCreateSwapchainKHR(mainDevice.logicalDevice, &swapChainCreateInfo, nullptr, &swapchain);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Swapchain!");
+	}
+
+	// Store for later reference
+	swapchainImageFormat = surfaceFormat.format;
+	swapchainExtent = extent;
+
+	// Get swapchain images (first count, then values)
+	uint32_t swapchainImageCount;
+	vkGetSwapchainImagesKHR(mainDevice.logicalDevice, swapchain, &swapchainImageCount, nullptr);
+	std::vector<VkImage> images(swapchainImageCount);
+	vkGetSwapchainImagesKHR(mainDevice.logicalDevice, swapchain, &swapchainImageCount, images.data());
+
+	for (VkImage image : images)
+	{
+		// Store image handle
+		SwapchainImage swapchainImage = {};
+		swapchainImage.image = image;
+		swapchainImage.imageView = CreateImageView(image, swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		// Add to swapchain image list
+		swapchainImages.push_back(swapchainImage);
+	}
+}
+
+void VulkanRenderer::CreateOffscreenImages()
+{
+	// Offscreen images stand in for swapchain images, so the rest of the renderer doesn't need to know the difference
+	swapchainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+	offscreenImageAllocations.resize(MAX_FRAME_DRAWS);
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		// Image is rendered to, then copied from for readback
+		SwapchainImage offscreenImage = {};
+		offscreenImage.image = CreateImage(swapchainExtent.width, swapchainExtent.height, swapchainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_SWAPCHAIN, &offscreenImageAllocations[i]);
+
+		offscreenImage.imageView = CreateImageView(offscreenImage.image, swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		swapchainImages.push_back(offscreenImage);
+	}
+}
+
+void VulkanRenderer::CreateDepthBufferImages()
+{
+	// Highest precision depth format the device can use as an attachment (stencil isn't used, so formats without it come first)
+	depthFormat = ChooseSupportedFormat(
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+	// Depth is only needed during the render pass, so never stored or read back
+	depthBufferImages.resize(swapchainImages.size());
+	depthBufferImageViews.resize(swapchainImages.size());
+	depthBufferImageAllocations.resize(swapchainImages.size());
+	for (size_t i = 0; i < swapchainImages.size(); i++)
+	{
+		depthBufferImages[i] = CreateImage(swapchainExtent.width, swapchainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_SWAPCHAIN, &depthBufferImageAllocations[i]);
+
+		depthBufferImageViews[i] = CreateImageView(depthBufferImages[i], depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+	}
+}
+
+void VulkanRenderer::CreateRenderPass()
+{
+	// Colour attachment of render pass
+	VkAttachmentDescription colourAttachment = {};
+	colourAttachment.format = swapchainImageFormat;							// Format to use for attachment
+	colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;						// Number of samples to write for multisampling
+	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;					// Describes what to do with attachment before rendering
+	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;				// Describes what to do with attachment after rendering
+	colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;		// Describes what to do with stencil before rendering
+	colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;		// Describes what to do with stencil after rendering
+
+	// Framebuffer data will be stored as an image, but images can be given different data layouts
+	// to give optimal use for certain operations
+	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;				// Image data layout befor render pass starts
+	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;			// Image data layout after render pass (to change to)
+	if (headless)
+	{
+		colourAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;	// Nothing to present, so get ready for readback instead
+	}
+
+	// Depth attachment of render pass
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format = depthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;				// Depth isn't needed once the frame is drawn
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	std::array<VkAttachmentDescription, 2> renderPassAttachments = { colourAttachment, depthAttachment };
+
+	// Attachment reference uses an attachemnt index that refer to index in the attachament list passed to renderPassCreateInfo
+	VkAttachmentReference colourAttachmentReference = {};
+	colourAttachmentReference.attachment = 0;
+	colourAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentReference = {};
+	depthAttachmentReference.attachment = 1;
+	depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	// Information about a particular subpass the Render Pass is using
+	// Depth pre-pass draws in the same subpass as colour, so depth it writes never has to leave tile memory
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;			// Pipeline type subpass is to be bound to
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colourAttachmentReference;
+	subpass.pDepthStencilAttachment = &depthAttachmentReference;
+
+	// Need to determine when layout transitions occur using subpass dependencies
+	std::array<VkSubpassDependency, 2> subpassDependencies;
+
+	// Conversion from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIONAL
+	// Transition must happen after...
+	subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;						// Subpass index (VK_SUBPASS_EXTERNAL = Special value meaning outside of renderpass)
+	subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;	// Pipeline stage (and last depth writes of image's previous frame)
+	subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;		// Stage access mask (memory access)
+	// But must happen before...
+	subpassDependencies[0].dstSubpass = 0;
+	subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	subpassDependencies[0].dependencyFlags = 0;
+
+	// Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIONAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+	// Transition must happen after...
+	subpassDependencies[1].srcSubpass = 0;						
+	subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	// But must happen before...
+	subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	subpassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	subpassDependencies[1].dependencyFlags = 0;
+	if (headless)
+	{
+		// Readback copy must happen after rendering finishes
+		subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		subpassDependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	}
+
+	// Create infor for Render Pass
+	VkRenderPassCreateInfo renderPassCreateInfo = {};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(renderPassAttachments.size());
+	renderPassCreateInfo.pAttachments = renderPassAttachments.data();
+	renderPassCreateInfo.subpassCount = 1;
+	renderPassCreateInfo.pSubpasses = &subpass;
+	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
+	renderPassCreateInfo.pDependencies = subpassDependencies.data();
+
+	VkResult result = vkCreateRenderPass(mainDevice.logicalDevice, &renderPassCreateInfo, nullptr, &renderPass);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Render Pass");
+	}
+}
+
+void VulkanRenderer::CreateDescriptorSetLayout()
+{
+	// CULLING SET LAYOUT
+	// Objects to test (binding 0), draw commands to write (binding 1) and draw count (binding 2), all used by compute shader
+	std::array<VkDescriptorSetLayoutBinding, 3> layoutBindings = {};
+	for (uint32_t binding = 0; binding < layoutBindings.size(); binding++)
+	{
+		layoutBindings[binding].binding = binding;										// Binding point in shader (designated by binding number in shader)
+		layoutBindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;		// Type of descriptor
+		layoutBindings[binding].descriptorCount = 1;									// Number of descriptors for binding
+		layoutBindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;				// Shader stage to bind to
+		layoutBindings[binding].pImmutableSamplers = nullptr;							// For Texture: Can make sampler data unchangeable (immutable) by specifying in layout
+	}
+
+	// Create Descriptor Set Layout with given bindings
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());	// Number of binding infos
+	layoutCreateInfo.pBindings = layoutBindings.data();								// Array of binding infos
+
+	VkResult result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &layoutCreateInfo, nullptr, &cullSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// UNIFORM SET LAYOUT
+	// Frame uniforms (binding 0), read by shaders at a dynamic offset into the uniform allocator's buffer
+	VkDescriptorSetLayoutBinding uniformLayoutBinding = {};
+	uniformLayoutBinding.binding = 0;
+	uniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	uniformLayoutBinding.descriptorCount = 1;
+	uniformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	uniformLayoutBinding.pImmutableSamplers = nullptr;
+
+	layoutCreateInfo.bindingCount = 1;
+	layoutCreateInfo.pBindings = &uniformLayoutBinding;
+
+	result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &layoutCreateInfo, nullptr, &uniformSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// BINDLESS SET
+	// Global arrays of buffers and textures, with its own update-after-bind pool
+	bindlessDescriptors.Init(mainDevice.physicalDevice, mainDevice.logicalDevice);
+}
+
+void VulkanRenderer::CreatePipelineCache()
+{
+	// Loads pipelines compiled by a previous run (if the file was written for this device and driver)
+	pipelineCache.Init(mainDevice.physicalDevice, mainDevice.logicalDevice, pipelineCachePath);
+}
+
+void VulkanRenderer::CreatePipelineCompiler()
+{
+	// Pipelines compile alongside render thread (and parallel recorder's workers), so leave it a core
+	uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	pipelineCompiler.Init(mainDevice.logicalDevice, pipelineCache.GetCache(), threadCount);
+}
+
+void VulkanRenderer::CreateGraphicsPipeline()
+{
+	// How the data for a single vertex (including info such as position, colour, texture, coords, normals, etc) is as a whole
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
+	bindingDescriptions[0].binding = 0;									// Can bind multiple streams of data, this defines which one
+	bindingDescriptions[0].stride = vertexLayout.stride;				// Size of a single vertex object (in chosen vertex layout)
+	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;		// How to move between data after each vertex
+																		// VK_VERTEX_INPUT_RATE_VERTEX		: Move on to the next vertex
+																		// VK_VERTEX_INPUT_RATE_INSTANCE	: Move to a vertex for the next instance
+
+	// Per instance data (model matrix), read from the frame's instance buffer
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(InstanceData);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	// How the data for an attribute is defined within a vertex
+	// Position (location 0) and colour (location 1) come from the vertex layout's own description
+	std::vector<VkVertexInputAttributeDescription> attributeDescription = vertexLayout.attributes;
+
+	// Model Matrix Attribute (a mat4 takes one location per column)
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		VkVertexInputAttributeDescription modelAttribute = {};
+		modelAttribute.binding = 1;												// Which binding the data is at (should be same as above)
+		modelAttribute.location = 2 + i;										// Location in shader where data will be read from
+		modelAttribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;					// Format the data will take (also helps define size of data)
+		modelAttribute.offset = static_cast<uint32_t>(offsetof(InstanceData, transform) + sizeof(glm::vec4) * i);	// Where this attribute is defined in the data for a single instance
+		attributeDescription.push_back(modelAttribute);
+	}
+
+	// Material Index Attribute
+	VkVertexInputAttributeDescription materialAttribute = {};
+	materialAttribute.binding = 1;
+	materialAttribute.location = 6;
+	materialAttribute.format = VK_FORMAT_R32_UINT;
+	materialAttribute.offset = offsetof(InstanceData, materialIndex);
+	attributeDescription.push_back(materialAttribute);
+
+	// -- PIPELINE LAYOUT --
+	// Frame uniforms come from a dynamic uniform buffer (set 0), materials and textures from bindless set (set 1)
+	// and per draw mesh transform is pushed (culling compute pipeline has its own layout)
+	std::array<VkDescriptorSetLayout, 2> setLayouts = { uniformSetLayout, bindlessDescriptors.GetSetLayout() };
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;		// Shader stage push constant will go to
+	pushConstantRange.offset = 0;									// Offset into given data to pass to push constant
+	pushConstantRange.size = sizeof(DrawPushConstants);				// Size of data being passed (within 128 bytes every device supports)
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	// Create Pipeline Layout (cheap, so made here rather than on a compile thread)
+	VkResult result = vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+
+	// -- GRAPHICS PIPELINE DESCRIPTION --
+	// Compiled on pipeline compiler's threads, fixed function state shared by every pipeline is filled in there
+	GraphicsPipelineDescription colourDescription;
+	colourDescription.name = "Graphics";
+	colourDescription.vertexShaderPath = "Shaders/vert.spv";
+	colourDescription.fragmentShaderPath = "Shaders/frag.spv";
+	colourDescription.bindings = bindingDescriptions;
+	colourDescription.attributes = attributeDescription;
+	colourDescription.layout = pipelineLayout;
+	colourDescription.renderPass = renderPass;
+	colourDescription.subpass = 0;
+	colourDescription.extent = swapchainExtent;
+	colourDescription.depthWrite = true;							// Enable writing to depth buffer (to replace old values)
+	colourDescription.depthCompareOp = VK_COMPARE_OP_LESS;			// Comparison operation that allows an overwrite (is in front)
+
+	if (!depthPrepass)
+	{
+		graphicsPipelineHandle = pipelineCompiler.SubmitGraphics(colourDescription);
+		return;
+	}
+
+	// -- DEPTH PRE-PASS PIPELINES --
+	// Plain colour pipeline goes first, drawn on its own as fallback until both pre-pass pipelines are ready
+	fallbackPipelineHandle = pipelineCompiler.SubmitGraphics(colourDescription);
+
+	// Same fixed function state as colour pipeline, but only reads positions and has no fragment shader
+	// Position is still read out of the interleaved vertex (binding 0 stride is unchanged), but no other attribute is fetched
+	// (colour and material only matter to shading)
+	GraphicsPipelineDescription depthDescription = colourDescription;
+	depthDescription.name = "Depth Pre-Pass";
+	depthDescription.vertexShaderPath = "Shaders/depth.spv";
+	depthDescription.fragmentShaderPath.clear();
+	depthDescription.attributes.clear();
+	for (const auto& attribute : attributeDescription)
+	{
+		if (attribute.location != 1 && attribute.location != 6)
+		{
+			depthDescription.attributes.push_back(attribute);
+		}
+	}
+	depthPrepassPipelineHandle = pipelineCompiler.SubmitGraphics(depthDescription);
+
+	// Pre-pass has already written nearest depth of every pixel, so only the fragment that wrote it passes (and is shaded)
+	// Both vertex shaders declare gl_Position invariant, so depth matches exactly
+	colourDescription.depthWrite = false;
+	colourDescription.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	graphicsPipelineHandle = pipelineCompiler.SubmitGraphics(colourDescription, fallbackPipelineHandle);
+}
+
+void VulkanRenderer::CreateComputePipeline()
+{
+	// -- PIPELINE LAYOUT --
+	// Frustum planes and object count change with camera/scene, so they're pushed rather than kept in a buffer
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &cullSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkResult result = vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &cullPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Compute Pipeline Layout!");
+	}
+
+	// -- COMPUTE PIPELINE DESCRIPTION --
+	// Culling is optional: without its shader (or until it has compiled), indirect draws are written by CPU
+	ComputePipelineDescription cullDescription;
+	cullDescription.name = "Frustum Culling";
+	cullDescription.shaderPath = "Shaders/cull.spv";
+	cullDescription.layout = cullPipelineLayout;
+	cullDescription.optional = true;
+	cullPipelineHandle = pipelineCompiler.SubmitCompute(cullDescription);
+}
+
+void VulkanRenderer::CreateFramebuffers()
+{
+	// Resize framebuffer count to equal swap chain image count
+	swapchainFramebuffers.resize(swapchainImages.size());
+
+	// Create a framebuffer for each swap chain image
+	for (size_t i = 0; i < swapchainFramebuffers.size(); i++)
+	{
+		std::array<VkImageView, 2> attachments = { swapchainImages[i].imageView, depthBufferImageViews[i] };
+
+		VkFramebufferCreateInfo framebufferCreateInfo = {};
+		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferCreateInfo.renderPass = renderPass;										// Render Pass layout the Framebuffer will be used with
+		framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferCreateInfo.pAttachments = attachments.data();							// List of attachments (1:1 with Render Pass)
+		framebufferCreateInfo.width = swapchainExtent.width;								// Framebuffer width
+		framebufferCreateInfo.height = swapchainExtent.height;								// Framebuffer height
+		framebufferCreateInfo.layers = 1;													// Framebuffer layers
+
+		VkResult result = vkCreateFramebuffer(mainDevice.logicalDevice, &framebufferCreateInfo, nullptr, &swapchainFramebuffers[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Framebuffer!");
+		}
+	}
+}
 
-	// If Graphics and Presentation families are diffrent, then swapchain must let images be shared between families
-	if (indices.graphicsFamily != indices.presentationFamily)
+void VulkanRenderer::CreateCommandPool()
+{
+	// Get indices of queue families from device
+	QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;	// Queue Family type buffers from this command pool will use
+
+	// Create a Graphics Queue Family Command Pool
+	VkResult result = vkCreateCommandPool(mainDevice.logicalDevice, &poolInfo, nullptr, &graphicsCommandPool);
+	if (result != VK_SUCCESS)
 	{
-		// Queues to share between
-		uint32_t queueFamilyIndices[] = {
-			(uint32_t)indices.graphicsFamily,
-			(uint32_t)indices.presentationFamily
-		};
+		throw std::runtime_error("Failed to create a Command Pool!");
+	}
 
-		swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;		// Image share handling
-		swapChainCreateInfo.queueFamilyIndexCount = 2;							// Number of queue to share images between
-		swapChainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;			// Array of queues to share between
+	// Frame command buffers are re-recorded often, so each recording slot (frame in flight and image pair) gets a transient pool that's reset as a whole
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	recordingCommandPools.resize(MAX_FRAME_DRAWS * swapchainFramebuffers.size());
+	for (size_t i = 0; i < recordingCommandPools.size(); i++)
+	{
+		result = vkCreateCommandPool(mainDevice.logicalDevice, &poolInfo, nullptr, &recordingCommandPools[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Frame Command Pool!");
+		}
 	}
-	else
+}
+
+void VulkanRenderer::CreateUploadManager()
+{
+	QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	// Uploads go through the transfer queue, into buffers shared with the graphics family when they're separate
+	uploadManager.Init(mainDevice.logicalDevice, &allocator,
+		transferQueue, queueFamilyIndices.transferFamily,
+		graphicsQueue, queueFamilyIndices.graphicsFamily);
+
+	if (queueFamilyIndices.hasDedicatedTransfer())
 	{
-		swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		swapChainCreateInfo.queueFamilyIndexCount = 0;							
-		swapChainCreateInfo.pQueueFamilyIndices = nullptr;
+		printf("Using dedicated transfer queue family %d for uploads\n", queueFamilyIndices.transferFamily);
 	}
+}
 
-	// If old swap chain been destroyed and this one replaces it, then link old one to quickly hand over responsibilities
-	swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+void VulkanRenderer::CreateGeometryPool()
+{
+	// Meshes are sub-ranges of the pool's buffers, filled through the upload manager
+	geometryPool.Init(mainDevice.logicalDevice, &allocator, &uploadManager, vertexLayout);
+}
 
-	// Create Swapchain
-	VkResult result = vkCreateSwapchainKHR(mainDevice.logicalDevice, &swapChainCreateInfo, nullptr, &swapchain);
+void VulkanRenderer::CreateIndirectBuffers()
+{
+	// Draw commands are written either by CPU when a frame is recorded, or by the culling compute shader,
+	// so buffers stay mapped in host visible memory and can also be written as storage buffers (count is cleared with a fill)
+	VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * MAX_INDIRECT_DRAWS + sizeof(uint32_t) * DRAW_GROUP_COUNT;
+
+	// Objects for culling compute shader to test, written by CPU when a frame is recorded
+	VkDeviceSize objectBufferSize = sizeof(CullObject) * MAX_INDIRECT_DRAWS;
+
+	indirectBuffers.resize(MAX_FRAME_DRAWS);
+	indirectBufferAllocations.resize(MAX_FRAME_DRAWS);
+	cullObjectBuffers.resize(MAX_FRAME_DRAWS);
+	cullObjectBufferAllocations.resize(MAX_FRAME_DRAWS);
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		CreateBuffer(mainDevice.logicalDevice, &allocator, bufferSize,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&indirectBuffers[i], &indirectBufferAllocations[i], MEMORY_TAG_DRAW_DATA);
+
+		CreateBuffer(mainDevice.logicalDevice, &allocator, objectBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&cullObjectBuffers[i], &cullObjectBufferAllocations[i], MEMORY_TAG_DRAW_DATA);
+	}
+}
+
+void VulkanRenderer::CreateInstanceBuffers()
+{
+	// Instance transforms are rewritten by CPU every time a frame is recorded, so they stay mapped in host visible memory
+	VkDeviceSize bufferSize = sizeof(InstanceData) * MAX_INSTANCES;
+
+	instanceBuffers.resize(MAX_FRAME_DRAWS);
+	instanceBufferAllocations.resize(MAX_FRAME_DRAWS);
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		CreateBuffer(mainDevice.logicalDevice, &allocator, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&instanceBuffers[i], &instanceBufferAllocations[i], MEMORY_TAG_DRAW_DATA);
+	}
+}
+
+void VulkanRenderer::CreateUniformAllocator()
+{
+	// One region per frame in flight, rewound when that frame's fence signals
+	uniformAllocator.Init(mainDevice.physicalDevice, mainDevice.logicalDevice, &allocator, MAX_FRAME_DRAWS);
+}
+
+void VulkanRenderer::CreateMaterialBuffers()
+{
+	// Default material (index 0): plain vertex colour
+	materials.push_back(Material());
+	materialsVersion++;
+
+	// Material table is copied in by CPU when it changes, so it stays mapped in host visible memory
+	// Each frame in flight has its own copy, so editing a material never changes a frame the GPU is still drawing
+	VkDeviceSize bufferSize = sizeof(Material) * MAX_MATERIALS;
+
+	materialBuffers.resize(MAX_FRAME_DRAWS);
+	materialBufferAllocations.resize(MAX_FRAME_DRAWS);
+	materialBufferIndices.resize(MAX_FRAME_DRAWS);
+	frameMaterialsVersion.assign(MAX_FRAME_DRAWS, 0);
+	frameResidencyVersion.assign(MAX_FRAME_DRAWS, 0);
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		CreateBuffer(mainDevice.logicalDevice, &allocator, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&materialBuffers[i], &materialBufferAllocations[i], MEMORY_TAG_DRAW_DATA);
+
+		// Shaders find frame's table through its bindless index (passed in frame uniforms)
+		materialBufferIndices[i] = bindlessDescriptors.AddStorageBuffer(materialBuffers[i], 0, bufferSize);
+	}
+}
+
+void VulkanRenderer::CreateTextureStreamer()
+{
+	QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	// Texture copies are submitted on graphics queue along with the frame, so textures never change queue family
+	textureStreamer.Init(mainDevice.physicalDevice, mainDevice.logicalDevice, &allocator, &bindlessDescriptors,
+		queueFamilyIndices.graphicsFamily, memoryBudgetSupported, textureUploadLimit);
+}
+
+void VulkanRenderer::CreateDescriptorPool()
+{
+	// Each frame's culling set has three storage buffers (objects, draw commands, draw count)
+	// plus one dynamic uniform buffer shared by every frame
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = 3 * MAX_FRAME_DRAWS;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = MAX_FRAME_DRAWS + 1;									// Maximum number of Descriptor Sets that can be created from pool
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());		// Amount of Pool Sizes being passed
+	poolCreateInfo.pPoolSizes = poolSizes.data();									// Pool Sizes to create pool with
+
+	VkResult result = vkCreateDescriptorPool(mainDevice.logicalDevice, &poolCreateInfo, nullptr, &descriptorPool);
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to create a Swapchain!");
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
 	}
+}
 
-	// Store for later reference
-	swapchainImageFormat = surfaceFormat.format;
-	swapchainExtent = extent;
+void VulkanRenderer::CreateDescriptorSets()
+{
+	// One culling set per frame in flight, all with the same layout
+	cullDescriptorSets.resize(MAX_FRAME_DRAWS);
+	std::vector<VkDescriptorSetLayout> setLayouts(MAX_FRAME_DRAWS, cullSetLayout);
 
-	// Get swapchain images (first count, then values)
-	uint32_t swapchainImageCount;
-	vkGetSwapchainImagesKHR(mainDevice.logicalDevice, swapchain, &swapchainImageCount, nullptr);
-	std::vector<VkImage> images(swapchainImageCount);
-	vkGetSwapchainImagesKHR(mainDevice.logicalDevice, swapchain, &swapchainImageCount, images.data());
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = descriptorPool;									// Pool to allocate Descriptor Set from
+	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());		// Number of sets to allocate
+	setAllocInfo.pSetLayouts = setLayouts.data();									// Layouts to use to allocate sets (1:1 relationship)
 
-	for (VkImage image : images)
+	VkResult result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, cullDescriptorSets.data());
+	if (result != VK_SUCCESS)
 	{
-		// Store image handle
-		SwapchainImage swapchainImage = {};
-		swapchainImage.image = image;
-		swapchainImage.imageView = CreateImageView(image, swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		throw std::runtime_error("Failed to allocate Descriptor Sets!");
+	}
 
-		// Add to swapchain image list
-		swapchainImages.push_back(swapchainImage);
+	// Draw count sits straight after the largest possible command list
+	VkDeviceSize countOffset = sizeof(VkDrawIndexedIndirectCommand) * MAX_INDIRECT_DRAWS;
+
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		// Buffer info and data offset info
+		VkDescriptorBufferInfo objectsBufferInfo = {};
+		objectsBufferInfo.buffer = cullObjectBuffers[i];		// Buffer to get data from
+		objectsBufferInfo.offset = 0;							// Position of start of data
+		objectsBufferInfo.range = VK_WHOLE_SIZE;				// Size of data
+
+		VkDescriptorBufferInfo drawCommandsBufferInfo = {};
+		drawCommandsBufferInfo.buffer = indirectBuffers[i];
+		drawCommandsBufferInfo.offset = 0;
+		drawCommandsBufferInfo.range = countOffset;
+
+		VkDescriptorBufferInfo drawCountBufferInfo = {};
+		drawCountBufferInfo.buffer = indirectBuffers[i];
+		drawCountBufferInfo.offset = countOffset;				// Multiple of 256, so meets any minStorageBufferOffsetAlignment
+		drawCountBufferInfo.range = sizeof(uint32_t) * DRAW_GROUP_COUNT;
+
+		VkDescriptorBufferInfo bufferInfos[] = { objectsBufferInfo, drawCommandsBufferInfo, drawCountBufferInfo };
+
+		// Data about connection between binding and buffer
+		std::array<VkWriteDescriptorSet, 3> setWrites = {};
+		for (uint32_t binding = 0; binding < setWrites.size(); binding++)
+		{
+			setWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			setWrites[binding].dstSet = cullDescriptorSets[i];						// Descriptor Set to update
+			setWrites[binding].dstBinding = binding;								// Binding to update (matches binding on layout/shader)
+			setWrites[binding].dstArrayElement = 0;									// Index in array to update
+			setWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;	// Type of descriptor
+			setWrites[binding].descriptorCount = 1;									// Amount to update
+			setWrites[binding].pBufferInfo = &bufferInfos[binding];					// Information about buffer data to bind
+		}
+
+		// Update the descriptor sets with new buffer/binding info
+		vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+	}
+
+	// Uniform set is written once: allocations are reached by dynamic offset, so it never needs updating while recording
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &uniformSetLayout;
+
+	result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, &uniformDescriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Descriptor Sets!");
 	}
+
+	VkDescriptorBufferInfo uniformBufferInfo = {};
+	uniformBufferInfo.buffer = uniformAllocator.GetBuffer();
+	uniformBufferInfo.offset = 0;
+	uniformBufferInfo.range = UNIFORM_DESCRIPTOR_RANGE;		// Window each dynamic offset looks through
+
+	VkWriteDescriptorSet uniformSetWrite = {};
+	uniformSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	uniformSetWrite.dstSet = uniformDescriptorSet;
+	uniformSetWrite.dstBinding = 0;
+	uniformSetWrite.dstArrayElement = 0;
+	uniformSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	uniformSetWrite.descriptorCount = 1;
+	uniformSetWrite.pBufferInfo = &uniformBufferInfo;
+
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &uniformSetWrite, 0, nullptr);
 }
 
-void VulkanRenderer::CreateRenderPass()
+void VulkanRenderer::CreateCommandBuffers()
 {
-	// Colour attachment of render pass
-	VkAttachmentDescription colourAttachment = {};
-	colourAttachment.format = swapchainImageFormat;							// Format to use for attachment
-	colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;						// Number of samples to write for multisampling
-	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;					// Describes what to do with attachment before rendering
-	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;				// Describes what to do with attachment after rendering
-	colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;		// Describes what to do with stencil before rendering
-	colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;		// Describes what to do with stencil after rendering
+	// Resize command buffer count to have one for each frame in flight and image it can land on
+	// Frames don't cycle through images in step (e.g. 2 frames in flight over 3 swapchain images), so one per frame would rarely match
+	commandBuffers.resize(recordingCommandPools.size());
 
-	// Framebuffer data will be stored as an image, but images can be given different data layouts
-	// to give optimal use for certain operations
-	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;				// Image data layout befor render pass starts
-	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;			// Image data layout after render pass (to change to)
+	VkCommandBufferAllocateInfo cbAllocInfo = {};
+	cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;	// VK_COMMAND_BUFFER_LEVEL_PRIMARY : Buffer you submit directly to queue. Can't be called by other buffers.
+															// VK_COMMAND_BUFFER_LEVEL_PRIMARY : Buffer can't be called directly. Can be called from other buffer via "vkCmdExecuteCommands" when recording commands in primary buffer.
+	cbAllocInfo.commandBufferCount = 1;
 
-	// Attachment reference uses an attachemnt index that refer to index in the attachament list passed to renderPassCreateInfo
-	VkAttachmentReference colourAttachmentReference = {};
-	colourAttachmentReference.attachment = 0;
-	colourAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	for (size_t i = 0; i < commandBuffers.size(); i++)
+	{
+		// Each recording slot's buffer comes from that slot's own pool
+		cbAllocInfo.commandPool = recordingCommandPools[i];
 
-	// Information about a particular subpass the Render Pass is using
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;			// Pipeline type subpass is to be bound to
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colourAttachmentReference;
+		VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &cbAllocInfo, &commandBuffers[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate Command Buffers");
+		}
+	}
 
-	// Need to determine when layout transitions occur using subpass dependencies
-	std::array<VkSubpassDependency, 2> subpassDependencies;
+	// Nothing recorded yet
+	recordedSceneVersion.assign(commandBuffers.size(), std::numeric_limits<uint64_t>::max());
+}
 
-	// Conversion from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIONAL
-	// Transition must happen after...
-	subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;						// Subpass index (VK_SUBPASS_EXTERNAL = Special value meaning outside of renderpass)
-	subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;		// Pipeline stage
-	subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;				// Stage access mask (memory access)
-	// But must happen before...
-	subpassDependencies[0].dstSubpass = 0;
-	subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpassDependencies[0].dependencyFlags = 0;
+void VulkanRenderer::CreateGpuProfiler()
+{
+	QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
 
-	// Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIONAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-	// Transition must happen after...
-	subpassDependencies[1].srcSubpass = 0;						
-	subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	// But must happen before...
-	subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	subpassDependencies[1].dependencyFlags = 0;
+	// One set of queries per frame in flight, read back once that frame's fence has signalled
+	gpuProfiler.Init(mainDevice.physicalDevice, mainDevice.logicalDevice, queueFamilyIndices.graphicsFamily,
+		MAX_FRAME_DRAWS, pipelineStatisticsSupported);
+}
+
+void VulkanRenderer::CreateParallelRecorder()
+{
+	QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	// Leave one core for main thread (which records primary buffers while workers are busy)
+	uint32_t workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+	// Workers need a set of secondary buffers for every recording slot, as a kept primary still executes them
+	parallelRecorder.Init(mainDevice.logicalDevice, queueFamilyIndices.graphicsFamily, workerCount,
+		static_cast<uint32_t>(commandBuffers.size()));
+}
+
+void VulkanRenderer::CreateSynchronisation()
+{
+	imageAvailable.resize(MAX_FRAME_DRAWS);
+	renderFinished.resize(MAX_FRAME_DRAWS);
+	drawFences.resize(MAX_FRAME_DRAWS);
+
+	// Semaphore creation information
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// Fence creation information
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &imageAvailable[i]) != VK_SUCCESS || 
+			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderFinished[i]) != VK_SUCCESS ||
+			vkCreateFence(mainDevice.logicalDevice, &fenceCreateInfo, nullptr, &drawFences[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Semaphore and/or Fence!");
+		}
+	}
+}
+
+std::vector<VulkanRenderer::DrawItem> VulkanRenderer::BuildDrawList(uint32_t frame, DrawGroups* drawGroups, bool bakeMeshTransforms)
+{
+	// Frame's fence has signalled, so GPU is done reading its instance buffer
+	InstanceData* instances = static_cast<InstanceData*>(instanceBufferAllocations[frame].mappedData);
+	uint32_t instanceCount = 0;
+
+	const glm::mat4 identity(1.0f);
+	LodProjection lodProjection = GetLodProjection();
+	instanceLods.resize(MAX_INSTANCES);
+	drawInstanceSources.resize(MAX_INSTANCES);
+
+	// Only visible meshes are recorded, each with its instances packed together by LOD so one draw covers all instances of a LOD
+	// Meshes are gathered one index type group at a time, so each group can be drawn with its own index buffer bind
+	std::vector<DrawItem> drawList;
+	for (uint32_t group = 0; group < DRAW_GROUP_COUNT; group++)
+	{
+		drawGroups->firstDraw[group] = static_cast<uint32_t>(drawList.size());
+
+		for (size_t i = 0; i < meshList.size(); i++)
+		{
+			if (!meshActive[i] || !meshVisible[i] || meshList[i].GetIndexType() != DRAW_GROUP_INDEX_TYPES[group])
+			{
+				continue;
+			}
+
+			Mesh& mesh = meshList[i];
+			const std::vector<glm::mat4>& transforms = meshInstances[i];
+			const glm::mat4& meshTransform = meshTransforms[i];
+
+			// Mesh without instances is drawn once where it is, instances past buffer capacity are dropped
+			uint32_t meshInstanceCount = transforms.empty() ? 1 : static_cast<uint32_t>(transforms.size());
+			meshInstanceCount = std::min(meshInstanceCount, MAX_INSTANCES - instanceCount);
+			if (meshInstanceCount == 0)
+			{
+				continue;
+			}
+
+			// Pick each instance's LOD, counting how many instances use each
+			// Textured meshes also ask for texture mips fine enough for the largest instance on screen
+			uint32_t textureId = materials[meshMaterials[i]].baseColourTexture;
+			float projectedSize = 0.0f;
+			uint32_t lodInstanceCounts[MAX_MESH_LODS] = {};
+			for (uint32_t j = 0; j < meshInstanceCount; j++)
+			{
+				glm::mat4 transform = transforms.empty() ? meshTransform : meshTransform * transforms[j];
+				uint32_t lod = SelectLod(mesh, transform, lodProjection);
+				instanceLods[j] = static_cast<uint8_t>(lod);
+				lodInstanceCounts[lod]++;
+
+				if (textureId != INVALID_BINDLESS_INDEX)
+				{
+					projectedSize = std::max(projectedSize, GetProjectedSize(mesh, transform, lodProjection));
+				}
+			}
+			if (textureId != INVALID_BINDLESS_INDEX)
+			{
+				textureStreamer.RequestSize(static_cast<int>(textureId), projectedSize, frameNumber);
+			}
+
+			// Each LOD in use gets one draw, with its instances packed together
+			uint32_t lodNextInstance[MAX_MESH_LODS];
+			for (uint32_t lod = 0; lod < mesh.GetLodCount(); lod++)
+			{
+				lodNextInstance[lod] = instanceCount;
+				if (lodInstanceCounts[lod] == 0)
+				{
+					continue;
+				}
+
+				DrawItem drawItem = {};
+				drawItem.meshId = static_cast<uint32_t>(i);
+				drawItem.firstInstance = instanceCount;
+				drawItem.instanceCount = lodInstanceCounts[lod];
+				drawItem.drawGroup = group;
+				drawItem.lod = lod;
+				drawList.push_back(drawItem);
+
+				instanceCount += lodInstanceCounts[lod];
+			}
+
+			// Quantized positions are mapped back to mesh space before the instance's own transform
+			// Mesh transform is normally pushed per draw, but indirect draws can't push between draws, so it's folded in here instead
+			glm::mat4 baseTransform = bakeMeshTransforms ? meshTransform : identity;
+			const glm::mat4& dequantizeTransform = mesh.GetDequantizeTransform();
+			for (uint32_t j = 0; j < meshInstanceCount; j++)
+			{
+				uint32_t slot = lodNextInstance[instanceLods[j]]++;
+				instances[slot].transform = transforms.empty() ? baseTransform * dequantizeTransform : baseTransform * transforms[j] * dequantizeTransform;
+				instances[slot].materialIndex = meshMaterials[i];
+				drawInstanceSources[slot] = j;
+			}
+		}
+
+		drawGroups->drawCount[group] = static_cast<uint32_t>(drawList.size()) - drawGroups->firstDraw[group];
+	}
+
+	return drawList;
+}
+
+VulkanRenderer::LodProjection VulkanRenderer::GetLodProjection()
+{
+	// Rows of view-projection matrix (glm is column major)
+	auto row = [this](int i)
+	{
+		return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	};
+	glm::vec4 rowX = row(0);
+	glm::vec4 rowY = row(1);
+
+	LodProjection projection;
+	projection.depthRow = row(3);
+	projection.depthRowLength = glm::length(glm::vec3(projection.depthRow.x, projection.depthRow.y, projection.depthRow.z));
+
+	// Pixels one world unit covers at w = 1, along whichever screen axis magnifies more
+	float pixelsPerUnit = std::max(glm::length(glm::vec3(rowX.x, rowX.y, rowX.z)) * swapchainExtent.width,
+		glm::length(glm::vec3(rowY.x, rowY.y, rowY.z)) * swapchainExtent.height) * 0.5f;
+	projection.allowedErrorScale = pixelsPerUnit > 0.0f ? lodErrorThreshold / pixelsPerUnit : 0.0f;
+	projection.pixelsPerUnit = pixelsPerUnit;
+
+	return projection;
+}
+
+uint32_t VulkanRenderer::SelectLod(Mesh& mesh, const glm::mat4& transform, const LodProjection& projection)
+{
+	uint32_t lodCount = mesh.GetLodCount();
+	if (lodCount == 1 || projection.allowedErrorScale <= 0.0f)
+	{
+		return 0;
+	}
+
+	// Largest axis scale, so error is never underestimated under non-uniform scale
+	float scaleSquared = std::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+		std::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])), glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+	float scale = std::sqrt(scaleSquared);
 
-	// Create infor for Render Pass
-	VkRenderPassCreateInfo renderPassCreateInfo = {};
-	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassCreateInfo.attachmentCount = 1;
-	renderPassCreateInfo.pAttachments = &colourAttachment;
-	renderPassCreateInfo.subpassCount = 1;
-	renderPassCreateInfo.pSubpasses = &subpass;
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-	renderPassCreateInfo.pDependencies = subpassDependencies.data();
+	// Depth of nearest point of bounding sphere, so the LOD only drops once all of the mesh is far enough
+	glm::vec4 sphere = mesh.GetBoundingSphere();
+	glm::vec4 centre = transform * glm::vec4(sphere.x, sphere.y, sphere.z, 1.0f);
+	float depth = glm::dot(projection.depthRow, centre) - sphere.w * scale * projection.depthRowLength;
+	if (depth <= 0.0f || scale <= 0.0f)
+	{
+		return 0;
+	}
 
-	VkResult result = vkCreateRenderPass(mainDevice.logicalDevice, &renderPassCreateInfo, nullptr, &renderPass);
-	if (result != VK_SUCCESS)
+	// Error (mesh units) that projects to the threshold in pixels at this depth, coarsest LOD within it is used
+	float allowedError = projection.allowedErrorScale * depth / scale;
+	uint32_t lod = 0;
+	while (lod + 1 < lodCount && mesh.GetLod(lod + 1).error <= allowedError)
 	{
-		throw std::runtime_error("Failed to create a Render Pass");
+		lod++;
 	}
+
+	return lod;
 }
 
-void VulkanRenderer::CreateGraphicsPipeline()
+float VulkanRenderer::GetProjectedSize(Mesh& mesh, const glm::mat4& transform, const LodProjection& projection)
 {
-	// Read in SPIR-V code of shaders
-	auto vertexShaderCode = readFile("Shaders/vert.spv");
-	auto fragmentShaderCode = readFile("Shaders/frag.spv");
-
-	// Build Shader Modules to link to Graphics Pipeline
-	VkShaderModule vertexShaderModule = CreateShaderModule(vertexShaderCode);
-	VkShaderModule fragmentShaderModule = CreateShaderModule(fragmentShaderCode);
-
-	// -- SHADER STAGE CREATION INFORMATION --
-	// Vertex Stage cration information
-	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;				// Shader Stage name
-	vertexShaderCreateInfo.module = vertexShaderModule;						// Shader module to be used by stage
-	vertexShaderCreateInfo.pName = "main";									// Entry point in to shader
-
-	// Fragment Stage cration information
-	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;				// Shader Stage name
-	fragmentShaderCreateInfo.module = fragmentShaderModule;						// Shader module to be used by stage
-	fragmentShaderCreateInfo.pName = "main";									// Entry point in to shader
-
-	// Put shader stage creation info in to array
-	// Graphics Pipeline creation info requires array of shader stage creates
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
+	float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
 
-	// How the data for a single vertex (including info such as position, colour, texture, coords, normals, etc) is as a whole
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0;									// Can bind multiple streams of data, this defines which one
-	bindingDescription.stride = sizeof(Vertex);						// Size of a single vertex object
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;		// How to move between data after each vertex
-																	// VK_VERTEX_INPUT_RATE_VERTEX		: Move on to the next vertex
-																	// VK_VERTEX_INPUT_RATE_INSTANCE	: Move to a vertex for the next instance
+	// Diameter of bounding sphere in pixels, at depth of its nearest point (so size is never underestimated)
+	glm::vec4 sphere = mesh.GetBoundingSphere();
+	glm::vec4 centre = transform * glm::vec4(sphere.x, sphere.y, sphere.z, 1.0f);
+	float depth = glm::dot(projection.depthRow, centre) - sphere.w * scale * projection.depthRowLength;
+	if (depth <= 0.0f)
+	{
+		return std::numeric_limits<float>::max();		// Camera is inside the sphere, so it may cover whole screen
+	}
 
-	// How the data for an attribute is defined within a vertex
-	std::array<VkVertexInputAttributeDescription, 2> attributeDescription;
-
-	// Position Attribute
-	attributeDescription[0].binding = 0;							// Which binding the data is at (should be same as above)
-	attributeDescription[0].location = 0;							// Location in shader where data will be read from
-	attributeDescription[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;	// Format the data will take (also helps define size of data)
-	attributeDescription[0].offset = offsetof(Vertex, pos);			// Where this attribute is defined in the data for a single vertex
-
-	// Colour Attribute
-	attributeDescription[1].binding = 0;
-	attributeDescription[1].location = 1;
-	attributeDescription[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-	attributeDescription[1].offset = offsetof(Vertex, col);
-
-	// CREATE PIPELINE
-	// -- VERTEX INPUT --
-	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-	vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;											// List of Vertex Binding Descriptions (data spacing/stride information)
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescription.size());
-	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescription.data();								// List of Vertex Attribute Decription (data format and where to bind to/from)
-
-	// -- INPUT ASSEMBLY --
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;		// Primitive type to assemble vertices as
-	inputAssembly.primitiveRestartEnable = VK_FALSE;					// Allow overrinding of 'strip' topology to start new primitives
-
-	// -- VIEWPORT & SCISSOR
-	// Create a viewport info struct
-	VkViewport viewport = {};
-	viewport.x = 0.0f;												// x start coordinate
-	viewport.y = 0.0f;												// y start coordinate
-	viewport.width = static_cast<float>(swapchainExtent.width);		// width of viewport
-	viewport.height = static_cast<float>(swapchainExtent.height);	// height of viewport
-	viewport.minDepth = 0.0f;										// min framebuffer depth
-	viewport.maxDepth = 1.0f;										// max framebuffer depth
-
-	// Create a scissor info struct
-	VkRect2D scissor = {};
-	scissor.offset = { 0,0 };				// Offset to use region from
-	scissor.extent = swapchainExtent;		// Extent to describe region to use, starting at offset
-
-	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportStateCreateInfo.viewportCount = 1;
-	viewportStateCreateInfo.pViewports = &viewport;
-	viewportStateCreateInfo.scissorCount = 1;
-	viewportStateCreateInfo.pScissors = &scissor;
-
-	// --DYNAMIC STATES -- 
-	// Dynamic states to enable
-	//std::vector<VkDynamicState> dynamicStateEnables;
-	//dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);	// Dynamic Viewport : Can resize in command buffer with vkCmdSetViewport(commandbuffer, 0, 1, &viewport);
-	//dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);	// Dynamic Scissor  : Can resize in command buffer with vkCmdSetScissor(commandbuffer, 0, 1, &scissor);
-
-	//// Dynamic State creation info
-	//VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
-	//dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	//dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-	//dynamicStateCreateInfo.pDynamicStates = dynamicStateEnables.data();
-
-	// -- RASTERIZER --
-	VkPipelineRasterizationStateCreateInfo rasterizeCreateInfo = {};
-	rasterizeCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizeCreateInfo.depthClampEnable = VK_FALSE;			// Change if fragments beyond near/far planes are clipped (default) or clamped to plane
-	rasterizeCreateInfo.rasterizerDiscardEnable = VK_FALSE;		// Whether to discard data and skip rasterizer. Never creates fragments, only suitable for pipeline without framebuffer output
-	rasterizeCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;		// How to handle filling points between vertices
-	rasterizeCreateInfo.lineWidth = 1.0f;						// How thick lines should be when drawn
-	rasterizeCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;		// Which face of a triangle to cull
-	rasterizeCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;	// Winding to determine which side is front
-	rasterizeCreateInfo.depthBiasClamp = VK_FALSE;				// Whether to add depth bias to fragments (good for stopping "shadow acne" in shadow mapping)
-
-	// -- MULTISAMPLING --
-	VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {};
-	multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampleCreateInfo.sampleShadingEnable = VK_FALSE;					// Enable multisample shading or not
-	multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;		// Number of sample to use per fragment
-
-	// -- BLENDING --
-	// Blending decides how to blend a new colour being written to a fragment, with the old value
-
-	// Blend Attachment State (how blending is handle)
-	VkPipelineColorBlendAttachmentState colourState = {};
-	colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
-		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;		// Colours to apply blending to
-	colourState.blendEnable = VK_TRUE;								// Enable blending
-
-	// Blending uses equation: (srcColorBlendFactor * new colour) colorBlendOp (dstColorBlendFactor * old colour)
-	colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	colourState.colorBlendOp = VK_BLEND_OP_ADD;
-
-	// Summarised: (VK_BLEND_FACTOR_SRC_ALPHA * new colour) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_APLHA * old colour)
-	//			   (new colour alpha * new colour) + ((1 - new colour alpha) * old colour)
-
-	colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
-	colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colourState.alphaBlendOp = VK_BLEND_OP_ADD;
-	// Summarised: (1 * new alpha) + (0 * old alpha) = new alpha
-
-	VkPipelineColorBlendStateCreateInfo colourBlendingCreateInfo = {};
-	colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colourBlendingCreateInfo.logicOpEnable = VK_FALSE;			// Alternative to calculations is to use logical operations
-	colourBlendingCreateInfo.attachmentCount = 1;
-	colourBlendingCreateInfo.pAttachments = &colourState;
-
-	// -- PIPELINE LAYOUT (TODO: Apply Future Descriptor Set Layouts) --
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
-	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCreateInfo.setLayoutCount = 0;
-	pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+	return 2.0f * sphere.w * scale * projection.pixelsPerUnit / depth;
+}
 
-	// Create Pipeline Layout
-	VkResult result = vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
-	if (result != VK_SUCCESS)
+glm::vec4 VulkanRenderer::GetDrawBoundingSphere(const DrawItem& drawItem)
+{
+	glm::vec4 meshSphere = meshList[drawItem.meshId].GetBoundingSphere();
+	const std::vector<glm::mat4>& instances = meshInstances[drawItem.meshId];
+	const glm::mat4& meshTransform = meshTransforms[drawItem.meshId];
+
+	// Grow a sphere around each drawn instance's transformed sphere, so one test covers the whole draw
+	// (mesh without instances is a single draw of the mesh transform alone)
+	glm::vec3 centre;
+	float radius = -1.0f;
+	for (uint32_t i = 0; i < drawItem.instanceCount; i++)
 	{
-		throw std::runtime_error("Failed to create Pipeline Layout!");
+		glm::mat4 transform = instances.empty() ? meshTransform : meshTransform * instances[drawInstanceSources[drawItem.firstInstance + i]];
+		glm::vec4 worldCentre = transform * glm::vec4(meshSphere.x, meshSphere.y, meshSphere.z, 1.0f);
+
+		// Largest axis scale keeps the sphere conservative under non-uniform scale
+		float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+		glm::vec3 instanceCentre = glm::vec3(worldCentre.x, worldCentre.y, worldCentre.z);
+		float instanceRadius = meshSphere.w * scale;
+
+		if (radius < 0.0f)
+		{
+			centre = instanceCentre;
+			radius = instanceRadius;
+			continue;
+		}
+
+		float distance = glm::distance(centre, instanceCentre);
+		if (distance + instanceRadius <= radius)
+		{
+			continue;		// Already inside
+		}
+		if (distance + radius <= instanceRadius)
+		{
+			centre = instanceCentre;		// Instance encloses current sphere
+			radius = instanceRadius;
+			continue;
+		}
+
+		// Smallest sphere enclosing both
+		float newRadius = (distance + radius + instanceRadius) * 0.5f;
+		centre = centre + (instanceCentre - centre) * ((newRadius - radius) / distance);
+		radius = newRadius;
 	}
 
-	// -- DEPTH STENCIL TESTING -- 
-	// TODO: Set up depth stencil testing
-
-	// -- GRAPHICS PIPELINE CREATION --
-	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.stageCount = 2;									// Number of shader stages
-	pipelineCreateInfo.pStages = shaderStages;							// List of shader stages
-	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;		// All the fixed functions pipeline states
-	pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
-	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	pipelineCreateInfo.pDynamicState = nullptr;
-	pipelineCreateInfo.pRasterizationState = &rasterizeCreateInfo;
-	pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
-	pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = nullptr;
-	pipelineCreateInfo.layout = pipelineLayout;							// Pipeline Layout pipeline should use
-	pipelineCreateInfo.renderPass = renderPass;							// Render pass description the pipeline is compatible with
-	pipelineCreateInfo.subpass = 0;										// Subpass of render pass to use with pipeline
-
-	// Pipeline Derivatives : Can create multiple pipeline that derive from one another for optimisation
-	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;		// Existing pipeline to derive from...
-	pipelineCreateInfo.basePipelineIndex = -1;					// or index of pipeline being created to derive from (in case creating multiple at once)
-
-	// Create Graphics Pipeline
-	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline);
-	if (result != VK_SUCCESS)
+	return glm::vec4(centre, radius);
+}
+
+void VulkanRenderer::RecordCulling(VkCommandBuffer commandBuffer, uint32_t frame, const std::vector<DrawItem>& drawList, const DrawGroups& drawGroups)
+{
+	// Frame's fence has signalled, so GPU is done reading its object buffer
+	CullObject* objects = static_cast<CullObject*>(cullObjectBufferAllocations[frame].mappedData);
+	for (size_t i = 0; i < drawList.size(); i++)
 	{
-		throw std::runtime_error("Failed to create a Graphics Pipeline!");
+		Mesh& mesh = meshList[drawList[i].meshId];
+		const MeshLod& lod = mesh.GetLod(drawList[i].lod);
+
+		objects[i] = {};
+		objects[i].boundingSphere = GetDrawBoundingSphere(drawList[i]);
+		objects[i].indexCount = lod.indexCount;
+		objects[i].firstIndex = lod.firstIndex;
+		objects[i].vertexOffset = mesh.GetVertexOffset();
+		objects[i].instanceCount = drawList[i].instanceCount;
+		objects[i].firstInstance = drawList[i].firstInstance;
+		objects[i].drawGroup = drawList[i].drawGroup;
+		objects[i].groupFirstCommand = drawGroups.firstDraw[drawList[i].drawGroup];
 	}
 
-	// Destroy Shader Modules, no longer needed after Pipeline created
-	vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, nullptr);
+	CullPushConstants pushConstants = {};
+	for (int i = 0; i < 6; i++)
+	{
+		pushConstants.frustumPlanes[i] = frustumPlanes[i];
+	}
+	pushConstants.objectCount = static_cast<uint32_t>(drawList.size());
+	pushConstants.compact = drawIndirectCountSupported ? 1 : 0;		// Packed list needs a GPU side count to draw it
+
+	uint32_t cullScope = gpuProfiler.BeginScope(commandBuffer, frame, "Frustum Cull");
+
+	// Reset visible draw count of each group (compute shader adds to them)
+	VkDeviceSize countOffset = sizeof(VkDrawIndexedIndirectCommand) * MAX_INDIRECT_DRAWS;
+	vkCmdFillBuffer(commandBuffer, indirectBuffers[frame], countOffset, sizeof(uint32_t) * DRAW_GROUP_COUNT, 0);
+
+	// Clear must finish before compute shader counts draws
+	VkBufferMemoryBarrier clearBarrier = {};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clearBarrier.buffer = indirectBuffers[frame];
+	clearBarrier.offset = countOffset;
+	clearBarrier.size = sizeof(uint32_t) * DRAW_GROUP_COUNT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, 1, &clearBarrier, 0, nullptr);
+
+	// One invocation per object (64 per work group, must match local_size_x in cull.comp)
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[frame], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+	vkCmdDispatch(commandBuffer, (pushConstants.objectCount + 63) / 64, 1, 1);
+
+	// Draw commands and count must be written before indirect draw reads them
+	VkBufferMemoryBarrier drawBarrier = clearBarrier;
+	drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	drawBarrier.offset = 0;
+	drawBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+		0, nullptr, 1, &drawBarrier, 0, nullptr);
+
+	gpuProfiler.EndScope(commandBuffer, frame, cullScope);
 }
 
-void VulkanRenderer::CreateFramebuffers()
+void VulkanRenderer::WriteIndirectCommands(uint32_t frame, const std::vector<DrawItem>& drawList, const DrawGroups& drawGroups)
 {
-	// Resize framebuffer count to equal swap chain image count
-	swapchainFramebuffers.resize(swapchainImages.size());
+	// Frame's fence has signalled, so GPU is done reading its indirect buffer
+	VkDrawIndexedIndirectCommand* drawCommands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBufferAllocations[frame].mappedData);
+	for (size_t i = 0; i < drawList.size(); i++)
+	{
+		Mesh& mesh = meshList[drawList[i].meshId];
+		const MeshLod& lod = mesh.GetLod(drawList[i].lod);
+
+		drawCommands[i].indexCount = lod.indexCount;
+		drawCommands[i].instanceCount = drawList[i].instanceCount;
+		drawCommands[i].firstIndex = lod.firstIndex;
+		drawCommands[i].vertexOffset = mesh.GetVertexOffset();
+		drawCommands[i].firstInstance = drawList[i].firstInstance;
+	}
 
-	// Create a framebuffer for each swap chain image
-	for (size_t i = 0; i < swapchainFramebuffers.size(); i++)
+	// Draw counts of each group sit straight after the largest possible command list
+	VkDeviceSize countOffset = sizeof(VkDrawIndexedIndirectCommand) * MAX_INDIRECT_DRAWS;
+	memcpy(static_cast<char*>(indirectBufferAllocations[frame].mappedData) + countOffset, drawGroups.drawCount, sizeof(uint32_t) * DRAW_GROUP_COUNT);
+}
+
+void VulkanRenderer::RecordIndirectDraws(VkCommandBuffer commandBuffer, uint32_t frame, const DrawGroups& drawGroups, VkPipeline pipeline, uint32_t frameUniformOffset)
+{
+	uint32_t drawScope = gpuProfiler.BeginScope(commandBuffer, frame, pipeline == depthPrepassPipeline ? "Depth Pre-Pass (Indirect)" : "Mesh Draws (Indirect)");
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	// Mesh transforms were baked into instances, so the single push constant of every draw is identity
+	DrawPushConstants pushConstants;
+	pushConstants.meshTransform = glm::mat4(1.0f);
+	VkDescriptorSet descriptorSets[] = { uniformDescriptorSet, bindlessDescriptors.GetSet() };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptorSets, 1, &frameUniformOffset);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstants), &pushConstants);
+
+	VkBuffer vertexBuffers[] = { geometryPool.GetVertexBuffer(), instanceBuffers[frame] };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+
+	// Whole mesh list in a single draw call per index type, rebinding the same index buffer with that group's type
+	// With indirect count, the number of draws actually made is read from the buffer (written by CPU or culling shader)
+	VkDeviceSize countOffset = sizeof(VkDrawIndexedIndirectCommand) * MAX_INDIRECT_DRAWS;
+	for (uint32_t group = 0; group < DRAW_GROUP_COUNT; group++)
 	{
-		std::array<VkImageView, 1> attachments = { swapchainImages[i].imageView };
+		if (drawGroups.drawCount[group] == 0)
+		{
+			continue;
+		}
 
-		VkFramebufferCreateInfo framebufferCreateInfo = {};
-		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferCreateInfo.renderPass = renderPass;										// Render Pass layout the Framebuffer will be used with
-		framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebufferCreateInfo.pAttachments = attachments.data();							// List of attachments (1:1 with Render Pass)
-		framebufferCreateInfo.width = swapchainExtent.width;								// Framebuffer width
-		framebufferCreateInfo.height = swapchainExtent.height;								// Framebuffer height
-		framebufferCreateInfo.layers = 1;													// Framebuffer layers
+		vkCmdBindIndexBuffer(commandBuffer, geometryPool.GetIndexBuffer(), 0, DRAW_GROUP_INDEX_TYPES[group]);
 
-		VkResult result = vkCreateFramebuffer(mainDevice.logicalDevice, &framebufferCreateInfo, nullptr, &swapchainFramebuffers[i]);
-		if (result != VK_SUCCESS)
+		VkDeviceSize commandOffset = sizeof(VkDrawIndexedIndirectCommand) * drawGroups.firstDraw[group];
+		if (drawIndirectCountSupported)
 		{
-			throw std::runtime_error("Failed to create a Framebuffer!");
+			vkCmdDrawIndexedIndirectCount(commandBuffer, indirectBuffers[frame], commandOffset, indirectBuffers[frame], countOffset + sizeof(uint32_t) * group,
+				drawGroups.drawCount[group], sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffers[frame], commandOffset, drawGroups.drawCount[group], sizeof(VkDrawIndexedIndirectCommand));
 		}
 	}
+
+	gpuProfiler.EndScope(commandBuffer, frame, drawScope);
 }
 
-void VulkanRenderer::CreateCommandPool()
+uint32_t VulkanRenderer::GetRecordingSlot(uint32_t frame, uint32_t imageIndex)
 {
-	// Get indices of queue families from device
-	QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+	return frame * static_cast<uint32_t>(swapchainFramebuffers.size()) + imageIndex;
+}
 
-	VkCommandPoolCreateInfo poolInfo = {};
-	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;	// Queue Family type buffers from this command pool will use
+void VulkanRenderer::UpdateCommandBuffer(uint32_t frame, uint32_t imageIndex)
+{
+	uint32_t slot = GetRecordingSlot(frame, imageIndex);
 
-	// Create a Graphics Queue Family Command Pool
-	VkResult result = vkCreateCommandPool(mainDevice.logicalDevice, &poolInfo, nullptr, &graphicsCommandPool);
-	if (result != VK_SUCCESS)
+	// Previous recording for this frame and image is still correct if scene hasn't changed
+	// Frame data it reads (instances, uniforms, indirect commands) is rewritten identically by any recording at the same scene version
+	if (dirtyTracking && recordedSceneVersion[slot] == sceneVersion)
 	{
-		throw std::runtime_error("Failed to create a Command Pool!");
+		lastFrameTimings.recordTime = 0.0;
+		return;
 	}
+
+	auto recordStart = std::chrono::steady_clock::now();
+
+	// Slot is only ever submitted as this frame, whose fence has signalled, so nothing from its pools is still in use
+	vkResetCommandPool(mainDevice.logicalDevice, recordingCommandPools[slot], 0);
+	parallelRecorder.ResetSlot(slot);
+
+	RecordCommands(frame, imageIndex);
+
+	recordedSceneVersion[slot] = sceneVersion;
+
+	lastFrameTimings.recordTime = ElapsedMilliseconds(recordStart, std::chrono::steady_clock::now());
 }
 
-void VulkanRenderer::CreateCommandBuffers()
+bool VulkanRenderer::UpdatePipelines()
 {
-	// Resize command buffer count to have one for each framebuffer
-	commandBuffers.resize(swapchainFramebuffers.size());
+	// Colour pipeline falls back to plain colour pipeline (if pre-pass is on) until it's ready, and frames are only cleared until then
+	// Lookups throw if a pipeline the renderer can't do without has failed: that can happen long after Init,
+	// so the error is handed back for caller to stop on rather than thrown out of a frame
+	VkPipeline newGraphicsPipeline = VK_NULL_HANDLE;
+	VkPipeline newDepthPrepassPipeline = VK_NULL_HANDLE;
+	VkPipeline newCullPipeline = VK_NULL_HANDLE;
+	try
+	{
+		newGraphicsPipeline = pipelineCompiler.GetPipeline(graphicsPipelineHandle);
+		if (depthPrepass)
+		{
+			// Equal depth test of pre-pass colour pipeline passes nothing without pre-pass depth, so both switch over together
+			newDepthPrepassPipeline = pipelineCompiler.GetPipeline(depthPrepassPipelineHandle);
+			if (newDepthPrepassPipeline == VK_NULL_HANDLE || !pipelineCompiler.IsReady(graphicsPipelineHandle))
+			{
+				newGraphicsPipeline = pipelineCompiler.GetPipeline(fallbackPipelineHandle);
+				newDepthPrepassPipeline = VK_NULL_HANDLE;
+			}
+		}
+		newCullPipeline = pipelineCompiler.GetPipeline(cullPipelineHandle);
+	}
+	catch (const std::runtime_error &e)
+	{
+		printf("ERROR: %s\n", e.what());
+		return false;
+	}
 
-	VkCommandBufferAllocateInfo cbAllocInfo = {};
-	cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cbAllocInfo.commandPool = graphicsCommandPool;
-	cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;	// VK_COMMAND_BUFFER_LEVEL_PRIMARY : Buffer you submit directly to queue. Can't be called by other buffers.
-															// VK_COMMAND_BUFFER_LEVEL_PRIMARY : Buffer can't be called directly. Can be called from other buffer via "vkCmdExecuteCommands" when recording commands in primary buffer.
-	cbAllocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+	// Recordings made with previous pipelines (or without them) are out of date
+	if (newGraphicsPipeline != graphicsPipeline || newDepthPrepassPipeline != depthPrepassPipeline || newCullPipeline != cullPipeline)
+	{
+		graphicsPipeline = newGraphicsPipeline;
+		depthPrepassPipeline = newDepthPrepassPipeline;
+		cullPipeline = newCullPipeline;
+		sceneVersion++;
+	}
 
-	// Allocate command buffers and place handles in array of buffers
-	VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &cbAllocInfo, commandBuffers.data());
-	if (result != VK_SUCCESS)
+	if (!pipelinesReady && pipelineCompiler.GetPendingCount() == 0)
 	{
-		throw std::runtime_error("Failed to allocate Command Buffers");
+		pipelinesReady = true;
+		printf("Pipelines compiled in %.2f ms (pipeline cache %s, loaded in %.2f ms)\n",
+			ElapsedMilliseconds(pipelineSubmitTime, std::chrono::steady_clock::now()),
+			pipelineCache.IsWarm() ? "hit" : "miss", pipelineCache.GetLoadTime());
 	}
+
+	return true;
 }
 
-void VulkanRenderer::CreateSynchronisation()
+void VulkanRenderer::ProcessMeshDeletions(bool force)
 {
-	imageAvailable.resize(MAX_FRAME_DRAWS);
-	renderFinished.resize(MAX_FRAME_DRAWS);
-	drawFences.resize(MAX_FRAME_DRAWS);
-
-	// Semaphore creation information
-	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-	// Fence creation information
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	// A mesh removed on frame N may be used by frames up to N - 1, and those are all done
+	// once the fence of frame N - 1 + MAX_FRAME_DRAWS has been waited on
+	for (size_t i = 0; i < pendingMeshDeletions.size();)
+	{
+		if (force || frameNumber >= pendingMeshDeletions[i].frameNumber + MAX_FRAME_DRAWS)
+		{
+			pendingMeshDeletions[i].mesh.Destroy();
+			pendingMeshDeletions.erase(pendingMeshDeletions.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
 
+void VulkanRenderer::UpdateMaterialBuffer(uint32_t frame)
+{
+	// Frame's fence has signalled, so GPU is done reading its material buffer
+	uint64_t residencyVersion = textureStreamer.GetResidencyVersion();
+	if (frameMaterialsVersion[frame] == materialsVersion && frameResidencyVersion[frame] == residencyVersion)
+	{
+		return;
+	}
 
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	// Materials hold texture ids, which shaders see as the bindless slot of texture's current image
+	Material* frameMaterials = static_cast<Material*>(materialBufferAllocations[frame].mappedData);
+	for (size_t i = 0; i < materials.size(); i++)
 	{
-		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &imageAvailable[i]) != VK_SUCCESS || 
-			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderFinished[i]) != VK_SUCCESS ||
-			vkCreateFence(mainDevice.logicalDevice, &fenceCreateInfo, nullptr, &drawFences[i]) != VK_SUCCESS)
+		frameMaterials[i] = materials[i];
+		if (materials[i].baseColourTexture != INVALID_BINDLESS_INDEX)
 		{
-			throw std::runtime_error("Failed to create a Semaphore and/or Fence!");
+			frameMaterials[i].baseColourTexture = textureStreamer.GetBindlessIndex(static_cast<int>(materials[i].baseColourTexture));
 		}
 	}
+	frameMaterialsVersion[frame] = materialsVersion;
+	frameResidencyVersion[frame] = residencyVersion;
 }
 
-void VulkanRenderer::RecordCommands()
+void VulkanRenderer::RecordCommands(uint32_t frame, uint32_t imageIndex)
 {
 	// Information about how to begin each command buffer
 	VkCommandBufferBeginInfo bufferBeginInfo = {};
 	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	// bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;	// Buffer can be resubmitted when it has already been submitted and is awaiting execution
+	// No ONE_TIME_SUBMIT_BIT: with dirty tracking, a recording is resubmitted for as long as the scene stays the same
 
 	// Information about how to begin a render pass (only needed for graphical applications)
 	VkRenderPassBeginInfo renderPassBeginInfo = {};
@@ -780,52 +2309,181 @@ void VulkanRenderer::RecordCommands()
 	renderPassBeginInfo.renderPass = renderPass;							// Render Pass to begin
 	renderPassBeginInfo.renderArea.offset = { 0,0 };						// Start point of render pass in pixels
 	renderPassBeginInfo.renderArea.extent = swapchainExtent;				// Size of region to run render pass on (starting at offset)
-	VkClearValue clearValues[] = 
+	std::array<VkClearValue, 2> clearValues = {};
+	clearValues[0].color = { 0.6f, 0.65f, 0.4f, 1.0f };
+	clearValues[1].depthStencil.depth = 1.0f;								// Furthest depth, so anything drawn is in front
+	renderPassBeginInfo.pClearValues = clearValues.data();					// List of clear values (1:1 with attachments)
+	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+
+	// Information secondary buffers need about the render pass they will be executed inside
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.pipelineStatistics = gpuProfiler.IsStatisticsEnabled() ? gpuProfiler.GetStatisticsFlags() : 0;	// Statistics query active in primary while they run
+
+	renderPassBeginInfo.framebuffer = swapchainFramebuffers[imageIndex];
+	inheritanceInfo.framebuffer = swapchainFramebuffers[imageIndex];
+
+	// Indirect draws need multi draw indirect (a device without it could only do one draw per indirect call)
+	// and non-zero firstInstance in indirect commands to reach each mesh's instances
+	bool indirectAvailable = indirectDrawEnabled && multiDrawIndirectSupported && drawIndirectFirstInstanceSupported;
+
+	// Visible meshes, with their instance transforms written to this frame's instance buffer
+	// Mesh transforms are baked into instances whenever an indirect draw may be used, as nothing can be pushed between its draws
+	DrawGroups drawGroups;
+	std::vector<DrawItem> drawList = BuildDrawList(frame, &drawGroups, indirectAvailable);
+	uint32_t drawCount = static_cast<uint32_t>(drawList.size());
+
+	// Frame uniforms: one small copy into this frame's uniform region, found by every draw through one dynamic offset
+	uint32_t frameUniformOffset;
+	FrameUniforms* frameUniforms = static_cast<FrameUniforms*>(uniformAllocator.Allocate(frame, sizeof(FrameUniforms), &frameUniformOffset));
+	frameUniforms->viewProjection = viewProjection;
+	frameUniforms->materialBufferIndex = materialBufferIndices[frame];
+
+	uint32_t slot = GetRecordingSlot(frame, imageIndex);
+	VkCommandBuffer commandBuffer = commandBuffers[slot];
+
+	// Start recording commands to command buffer!
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo);
+	if (result != VK_SUCCESS)
 	{
-		{0.6f, 0.65f, 0.4f, 1.0f}
-	};
-	renderPassBeginInfo.pClearValues = clearValues;							// List of clear values (TODO: Depth Attachment Clear Value)
-	renderPassBeginInfo.clearValueCount = 1;
+		throw std::runtime_error("Failed to start recording a Command Buffer!");
+	}
 
-	for (size_t i = 0; i < commandBuffers.size(); i++)
+	// Reset this frame's queries, ready for it to write them
+	gpuProfiler.BeginFrame(commandBuffer, frame);
+
+	// Meshes are only drawn once a colour pipeline has compiled (until then frame is just cleared)
+	// and depth pre-pass is only drawn once its pipelines are in use
+	bool drawMeshes = graphicsPipeline != VK_NULL_HANDLE;
+	bool prepassActive = depthPrepassPipeline != VK_NULL_HANDLE;
+
+	bool useIndirect = drawMeshes && indirectAvailable && drawCount <= MAX_INDIRECT_DRAWS;
+	if (useIndirect)
 	{
-		renderPassBeginInfo.framebuffer = swapchainFramebuffers[i];
+		// Fill indirect buffer: on GPU by culling against frustum (has to be outside render pass), or directly from CPU
+		if (gpuCullingEnabled && cullPipeline != VK_NULL_HANDLE)
+		{
+			RecordCulling(commandBuffer, frame, drawList, drawGroups);
+		}
+		else
+		{
+			WriteIndirectCommands(frame, drawList, drawGroups);
+		}
+	}
 
-		// Start recording commands to command buffer!
-		VkResult result = vkBeginCommandBuffer(commandBuffers[i], &bufferBeginInfo);
-		if (result != VK_SUCCESS)
+	uint32_t renderPassScope = gpuProfiler.BeginScope(commandBuffer, frame, "Render Pass");
+	gpuProfiler.BeginStatistics(commandBuffer, frame);
+
+	if (!drawMeshes)
+	{
+		// Render pass still runs, so image is cleared and ends up in the layout presentation (or readback) expects
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdEndRenderPass(commandBuffer);
+	}
+	else if (useIndirect)
+	{
+		// Begin Render Pass, recording draw straight into primary buffer
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			// Depth pre-pass replays the same indirect commands, before colour pass draws them again
+			if (prepassActive)
+			{
+				RecordIndirectDraws(commandBuffer, frame, drawGroups, depthPrepassPipeline, frameUniformOffset);
+			}
+			RecordIndirectDraws(commandBuffer, frame, drawGroups, graphicsPipeline, frameUniformOffset);
+
+		// End Render Pass
+		vkCmdEndRenderPass(commandBuffer);
+	}
+	else
+	{
+		// With depth pre-pass, every draw is listed twice: depth draws first, then colour draws
+		// Secondary buffers run in worker order, so all of depth is laid down before any colour is shaded
+		uint32_t passCount = prepassActive ? 2 : 1;
+		uint32_t itemCount = drawCount * passCount;
+
+		// Each worker's slice of draws is timed as its own scope
+		std::vector<uint32_t> workerScopes;
+		for (uint32_t w = 0; w < parallelRecorder.GetActiveWorkerCount(itemCount); w++)
 		{
-			throw std::runtime_error("Failed to start recording a Command Buffer!");
+			workerScopes.push_back(gpuProfiler.ReserveScope(frame, "Mesh Draws " + std::to_string(w)));
 		}
 
-			// Begin Render Pass
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Record mesh draws across worker threads, each into its own secondary command buffer
+		std::vector<VkCommandBuffer> secondaryBuffers = parallelRecorder.Record(slot, inheritanceInfo, itemCount,
+			[this, frame, drawCount, passCount, frameUniformOffset, indirectAvailable, &workerScopes, &drawList](VkCommandBuffer secondaryBuffer, uint32_t workerIndex, uint32_t firstItem, uint32_t count)
+			{
+				gpuProfiler.WriteScopeBegin(secondaryBuffer, frame, workerScopes[workerIndex]);
+
+				// Bind pipeline to be used in render pass (state isn't inherited from primary buffer)
+				// Slice may start in depth pre-pass and cross into colour pass, where colour pipeline is bound instead
+				bool inColourPass = firstItem >= drawCount * (passCount - 1);
+				vkCmdBindPipeline(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, inColourPass ? graphicsPipeline : depthPrepassPipeline);
 
-				// Bind pipeline to be used in render pass
-				vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+				// Frame uniforms (both pipelines share a layout, so this stays bound across the switch to colour pipeline)
+				// Bindless set is bound once for every draw, materials and textures are picked by index in shaders
+				VkDescriptorSet descriptorSets[] = { uniformDescriptorSet, bindlessDescriptors.GetSet() };
+				vkCmdBindDescriptorSets(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptorSets, 1, &frameUniformOffset);
 
-				for (size_t j = 0; j < meshList.size(); j++)
-				{
-					VkBuffer vertexBuffers[] = { meshList[j].GetVertexBuffer() };					// Buffers to bind
-					VkDeviceSize offsets[] = { 0 };												// Offsets into buffers being bound
-					vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);	// Command to bind vertex buffer before drawing with them
+				// Every mesh lives in the geometry pool, so its buffers are bound once for all draws (with frame's instance buffer at binding 1)
+				VkBuffer vertexBuffers[] = { geometryPool.GetVertexBuffer(), instanceBuffers[frame] };	// Buffers to bind
+				VkDeviceSize offsets[] = { 0, 0 };														// Offsets into buffers being bound
+				vkCmdBindVertexBuffers(secondaryBuffer, 0, 2, vertexBuffers, offsets);					// Command to bind vertex buffer before drawing with them
 
-					// Bind mesh index buffer, with 0 offset and using the uint32 type
-					vkCmdBindIndexBuffer(commandBuffers[i], meshList[j].GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+				// Shared index buffer is bound with 0 offset, and rebound whenever the slice crosses into another index type group
+				bool indexBufferBound = false;
+				uint32_t boundGroup = 0;
 
-					// Execute pipeline
-					vkCmdDrawIndexed(commandBuffers[i], meshList[j].GetIndexCount(), 1, 0, 0, 0);
+				for (uint32_t item = firstItem; item < firstItem + count; item++)
+				{
+					if (!inColourPass && item >= drawCount)
+					{
+						vkCmdBindPipeline(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+						inColourPass = true;
+					}
+
+					const DrawItem& drawItem = drawList[item % drawCount];
+					Mesh& mesh = meshList[drawItem.meshId];
+
+					if (!indexBufferBound || drawItem.drawGroup != boundGroup)
+					{
+						vkCmdBindIndexBuffer(secondaryBuffer, geometryPool.GetIndexBuffer(), 0, DRAW_GROUP_INDEX_TYPES[drawItem.drawGroup]);
+						indexBufferBound = true;
+						boundGroup = drawItem.drawGroup;
+					}
+
+					// Per draw data is pushed straight into the command buffer (already in instances if they were built for indirect drawing)
+					DrawPushConstants pushConstants;
+					pushConstants.meshTransform = indirectAvailable ? glm::mat4(1.0f) : meshTransforms[drawItem.meshId];
+					vkCmdPushConstants(secondaryBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstants), &pushConstants);
+
+					// Execute pipeline, picking mesh's LOD out of shared buffers with first index and vertex offset, and its instances with first instance
+					const MeshLod& lod = mesh.GetLod(drawItem.lod);
+					vkCmdDrawIndexed(secondaryBuffer, lod.indexCount, drawItem.instanceCount, lod.firstIndex, mesh.GetVertexOffset(), drawItem.firstInstance);
 				}
 
-			// End Render Pass
-			vkCmdEndRenderPass(commandBuffers[i]);
+				gpuProfiler.EndScope(secondaryBuffer, frame, workerScopes[workerIndex]);
+			});
 
-		// Stop recording to command buffer!
-		result = vkEndCommandBuffer(commandBuffers[i]);
-		if (result != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to stop recording a Command Buffer!");
-		}
+		// Begin Render Pass, with its contents coming from secondary command buffers
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+			vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+
+		// End Render Pass
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	gpuProfiler.EndStatistics(commandBuffer, frame);
+	gpuProfiler.EndScope(commandBuffer, frame, renderPassScope);
+
+	// Stop recording to command buffer!
+	result = vkEndCommandBuffer(commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording a Command Buffer!");
 	}
 }
 
@@ -877,9 +2535,12 @@ void VulkanRenderer::GetPhysicalDevice()
 		if (CheckDeviceSuitable(device))
 		{
 			mainDevice.physicalDevice = device;
-			break;
+			return;
 		}
 	}
+
+	// Nothing matched, so there's no device to create the logical device from
+	throw std::runtime_error("No suitable GPU found!");
 }
 
 // === This function will return the required list of extensions based on whether validation layers are enabled or not:
@@ -887,10 +2548,13 @@ std::vector<const char*> VulkanRenderer::GetRequiredExtensions()
 {
 	// Set up extensions Instance will use
 	uint32_t glfwExtensionCount = 0;		// GLFW may require multiple extensions
-	const char** glfwExtensions;			// Extensions passed as array of cstrings, so need pointer (the array) to pointer (the cstring)
+	const char** glfwExtensions = nullptr;	// Extensions passed as array of cstrings, so need pointer (the array) to pointer (the cstring)
 
-	// Get GLFW extensions
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	// Get GLFW extensions (headless has no window, so doesn't need any surface extensions)
+	if (!headless)
+	{
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	}
 
 	// Create list to hold instance extensions
 	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
@@ -911,6 +2575,17 @@ std::vector<const char*> VulkanRenderer::GetRequiredExtensions()
 	return extensions;
 }
 
+std::vector<const char*> VulkanRenderer::GetRequiredDeviceExtensions()
+{
+	// Swapchain extension is only needed when presenting to a window
+	if (headless)
+	{
+		return {};
+	}
+
+	return deviceExtensions;
+}
+
 bool VulkanRenderer::CheckInstanceExtensionSupport(std::vector<const char*>* checkExtensions)
 {
 	// Need to get number of extensions to create array of correct size to hold extensions
@@ -960,7 +2635,7 @@ bool VulkanRenderer::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
 
 	// Check for extension
-	for (const auto& deviceExtension : deviceExtensions)
+	for (const auto& deviceExtension : GetRequiredDeviceExtensions())
 	{
 		bool hasExtension = false;
 		for (const auto& extension : extensions)
@@ -994,7 +2669,13 @@ bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
 
 	QueueFamilyIndices indices = GetQueueFamilies(device);
 
-	bool extensionsSupported = CheckDeviceExtensionSupport(device);
+	bool extensionsSupported = CheckDeviceExtensionSupport(device) && CheckDescriptorIndexingSupport(device);
+
+	// Headless rendering doesn't need a swapchain
+	if (headless)
+	{
+		return indices.isValid() && extensionsSupported;
+	}
 
 	bool swapChainValid = false;
 	if (extensionsSupported)
@@ -1006,6 +2687,45 @@ bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
 	return indices.isValid() && extensionsSupported && swapChainValid;
 }
 
+bool VulkanRenderer::CheckDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName)
+{
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+	for (const auto& extension : extensions)
+	{
+		if (strcmp(extensionName, extension.extensionName) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool VulkanRenderer::CheckDescriptorIndexingSupport(VkPhysicalDevice device)
+{
+	// Materials and textures are reached through bindless descriptor arrays, which need Vulkan 1.2 descriptor indexing
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_2)
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 features2 = {};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &vulkan12Features;
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+
+	return BindlessDescriptors::CheckFeatureSupport(features2.features, vulkan12Features);
+}
+
 // === Checking Layers
 bool VulkanRenderer::CheckValidationLayerSupport()
 {
@@ -1050,33 +2770,59 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
 
 	// Go through each queue family and check if it has at least 1 of the required types of queue
 	int i = 0;
+	int transferOnlyFamily = -1;
 	for (const auto& queueFamily : queueFamilyList)
 	{
 		// First check if queue family has at last 1 queue in that family (could have no queue)
 		// Queue can be multiple types defined through bitfield. Need to bitwise AND with VK_QUEUE_*_BIT to check if has required type
-		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		if (indices.graphicsFamily < 0 && queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 		{
 			indices.graphicsFamily = i;		// If queue family is valid, then get index
 		}
 
-		// Check if Queue Family supports presentation
+		// Check if Queue Family supports presentation (headless never presents, so graphics family stands in)
 		VkBool32 presentationSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport);
+		if (headless)
+		{
+			presentationSupport = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT ? VK_TRUE : VK_FALSE;
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport);
+		}
 		// Check if queue is presentation type (can be both graphics and presentation)
-		if (queueFamily.queueCount > 0 && presentationSupport)
+		if (indices.presentationFamily < 0 && queueFamily.queueCount > 0 && presentationSupport)
 		{
 			indices.presentationFamily = i;
 		}
 
-		// Check if queue family indices are in a valid state, stop searching if so
-		if (indices.isValid())
+		// Check if queue family is transfer only (usually the copy engine, which can run alongside rendering)
+		// Families without graphics but with compute are kept as a second choice
+		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
 		{
-			break;
+			if (!(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+			{
+				transferOnlyFamily = i;
+			}
+			else if (indices.transferFamily < 0)
+			{
+				indices.transferFamily = i;
+			}
 		}
 
 		i++;
 	}
 
+	// Prefer transfer only family, fall back to graphics family (graphics queues always support transfer)
+	if (transferOnlyFamily >= 0)
+	{
+		indices.transferFamily = transferOnlyFamily;
+	}
+	else if (indices.transferFamily < 0)
+	{
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
 	return indices;
 }
 
@@ -1139,16 +2885,24 @@ VkSurfaceFormatKHR VulkanRenderer::ChooseBestSurfaceFormat(const std::vector<VkS
 
 VkPresentModeKHR VulkanRenderer::ChooseBestPresentationMode(const std::vector<VkPresentModeKHR> presentationModes)
 {
-	// Look for Mailbox presentation mode
+	// Look for requested presentation mode
+	// IMMEDIATE   : Tears, lowest latency
+	// MAILBOX     : No tearing, newest image replaces queued one (GPU keeps rendering frames that are never shown)
+	// FIFO        : V-Sync, Draw is held to display refresh rate
+	// FIFO_RELAXED: V-Sync, but a late image is shown straight away (tearing) instead of waiting another refresh
 	for (const auto& presentationMode : presentationModes)
 	{
-		if (presentationMode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (presentationMode == requestedPresentMode)
 		{
 			return presentationMode;
 		}
 	}
 
 	// If can't find, use FIFO as Vulkan spec says it must be present
+	if (requestedPresentMode != VK_PRESENT_MODE_FIFO_KHR)
+	{
+		printf("Requested present mode %d not supported by surface, using FIFO\n", requestedPresentMode);
+	}
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -1180,6 +2934,63 @@ VkExtent2D VulkanRenderer::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surf
 	}
 }
 
+VkFormat VulkanRenderer::ChooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags)
+{
+	// Loop through options and find compatible one
+	for (VkFormat format : formats)
+	{
+		// Get properties for given format on this device
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(mainDevice.physicalDevice, format, &properties);
+
+		// Depending on tiling choice, need to check for different bit flag
+		VkFormatFeatureFlags supportedFlags = tiling == VK_IMAGE_TILING_LINEAR ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+		if ((supportedFlags & featureFlags) == featureFlags)
+		{
+			return format;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a matching format!");
+}
+
+VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags,
+	VkMemoryPropertyFlags propFlags, MemoryTag tag, Allocation* imageAllocation)
+{
+	// CREATE IMAGE
+	// Image Creation Info
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;						// Type of image (1D, 2D or 3D)
+	imageCreateInfo.extent = { width, height, 1 };						// Extent of image (depth of 1 for a 2D image)
+	imageCreateInfo.mipLevels = 1;										// Number of mipmap levels
+	imageCreateInfo.arrayLayers = 1;									// Number of levels in image array
+	imageCreateInfo.format = format;									// Format type of image
+	imageCreateInfo.tiling = tiling;									// How image data should be "tiled" (arranged for optimal reading)
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;			// Layout of image data on creation
+	imageCreateInfo.usage = useFlags;									// Bit flags defining what image will be used for
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;					// Number of samples for multi-sampling
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;			// Whether image can be shared between queues
+
+	VkImage image;
+	VkResult result = vkCreateImage(mainDevice.logicalDevice, &imageCreateInfo, nullptr, &image);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Image!");
+	}
+
+	// CREATE MEMORY FOR IMAGE
+	// Optimal tiling images go in the allocator's non-linear pools
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(mainDevice.logicalDevice, image, &memRequirements);
+	*imageAllocation = allocator.Allocate(memRequirements, propFlags, tag, tiling == VK_IMAGE_TILING_LINEAR);
+
+	// Connect memory to image
+	vkBindImageMemory(mainDevice.logicalDevice, image, imageAllocation->memory, imageAllocation->offset);
+
+	return image;
+}
+
 VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
 {
 	VkImageViewCreateInfo viewCreateInfo = {};
@@ -1208,21 +3019,3 @@ VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkIm
 	}
 	return imageView;
 }
-
-VkShaderModule VulkanRenderer::CreateShaderModule(const std::vector<char>& code)
-{
-	// Shader Module creation information
-	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
-	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCreateInfo.codeSize = code.size();										// Size of code
-	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());		// Pointer to code (of uint32_t pointer type)
-
-	VkShaderModule shaderModule;
-	VkResult result = vkCreateShaderModule(mainDevice.logicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a shader module!");
-	}
-
-	return shaderModule;
-}
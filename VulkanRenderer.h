@@ -10,8 +10,21 @@
 #include <iostream>
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstddef>
 
 #include "Mesh.h"
+#include "GpuProfiler.h"
+#include "ParallelRecorder.h"
+#include "PipelineCache.h"
+#include "PipelineCompiler.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "FrameLimiter.h"
+#include "UniformAllocator.h"
+#include "BindlessDescriptors.h"
+#include "TextureStreamer.h"
 #include "VulkanValidation.h"
 #include "Utilities.h"
 
@@ -22,16 +35,154 @@ public:
 	~VulkanRenderer();
 
 	int Init(GLFWwindow* newWindow);
-	void Draw();
+	int InitHeadless(uint32_t width, uint32_t height);
+	int Draw();
 	void Cleanup();
 
+	// - Scene
+	int AddMesh(std::vector<Vertex>* vertices, std::vector<uint32_t>* indices);
+	int AddMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+	int LoadMesh(const std::string& filename);
+	void RemoveMesh(int meshId);
+	void SetMeshVisible(int meshId, bool visible);
+	int AddInstance(int meshId, const glm::mat4& transform);
+	void SetInstanceTransform(int meshId, int instanceIndex, const glm::mat4& transform);
+	void SetMeshTransform(int meshId, const glm::mat4& transform);
+	int CreateMaterial(const Material& material);
+	void SetMaterial(int materialId, const Material& material);
+	void SetMeshMaterial(int meshId, int materialId);
+	int CreateTexture(uint32_t width, uint32_t height, const void* pixels);
+	void ClearInstances(int meshId);
+	void SetDirtyTracking(bool enabled);
+	void SetIndirectDraw(bool enabled);
+	void SetGpuCulling(bool enabled);
+	void SetViewProjection(const glm::mat4& newViewProjection);
+	void SetPipelineCachePath(const std::string& path);
+	void SetVertexFormat(VertexFormat format);
+	void SetMeshOptimization(bool enabled);
+	void SetLodGeneration(bool enabled);
+	void SetLodErrorThreshold(float pixels);
+	void SetDepthPrepass(bool enabled);
+	void SetPresentMode(VkPresentModeKHR mode);
+	void SetFrameLimit(double targetFrameTime);
+	void SetAsyncPipelines(bool enabled);
+	void SetTextureBudget(VkDeviceSize bytes);
+	void SetTextureUploadLimit(VkDeviceSize bytes);
+
+	bool ReadbackImage(std::vector<uint8_t>& pixels);
+	VkExtent2D GetRenderExtent();
+	VkPhysicalDeviceProperties GetDeviceProperties();
+	const FrameTimings& GetLastFrameTimings();
+	FramePacingStatistics GetFramePacingStatistics();
+	TextureStreamingStatistics GetTextureStreamingStatistics();
+	MemoryStatistics GetMemoryStatistics();
+	void LogMemoryStatistics();
+	GpuProfiler& GetGpuProfiler();
+
 private:
 	GLFWwindow* window;
+	bool headless = false;
 
 	int currentFrame = 0;
+	uint64_t frameNumber = 0;		// Total frames drawn
+
+	// Timings of last Draw call
+	FrameTimings lastFrameTimings;
+
+	// - Frame Pacing
+	VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;	// Used if surface supports it, otherwise FIFO
+	FrameLimiter frameLimiter;						// Holds Draw calls to a target frame time (off by default)
+
+	// GPU timestamp and pipeline statistics queries recorded into each command buffer
+	GpuProfiler gpuProfiler;
+	bool pipelineStatisticsSupported = false;
+
+	// - Indirect Drawing
+	bool indirectDrawEnabled = true;					// Draw whole mesh list with one indirect draw (when device supports it)
+	bool multiDrawIndirectSupported = false;
+	bool drawIndirectCountSupported = false;
+	std::vector<VkBuffer> indirectBuffers;				// Per frame in flight: draw commands, followed by draw count
+	std::vector<Allocation> indirectBufferAllocations;
+	bool drawIndirectFirstInstanceSupported = false;
+
+	// - Instancing
+	std::vector<VkBuffer> instanceBuffers;				// Per frame in flight: transforms of every instance drawn, bound at vertex binding 1
+	std::vector<Allocation> instanceBufferAllocations;
+
+	// - GPU Culling
+	bool gpuCullingEnabled = true;						// Cull meshes against frustum in a compute pass that fills the indirect buffer
+	glm::vec4 frustumPlanes[6];							// Planes of view frustum, pointing inwards
+	std::vector<VkBuffer> cullObjectBuffers;			// Per frame in flight: bounding sphere and draw of every object to test
+	std::vector<Allocation> cullObjectBufferAllocations;
+
+	// - Level of Detail
+	bool lodGeneration = true;							// Generate simplified LODs of meshes as they are added
+	float lodErrorThreshold = DEFAULT_LOD_ERROR_THRESHOLD;	// Most pixels a LOD's error may cover on screen
+	glm::mat4 viewProjection = glm::mat4(1.0f);			// Camera LODs are selected for
+	std::vector<uint8_t> instanceLods;					// Scratch: LOD picked for each instance of the mesh being listed
+	std::vector<uint32_t> drawInstanceSources;			// Instance (of its mesh) each slot of the instance buffer was written from
+
+	// What LOD selection needs of the camera, worked out from view-projection once per recording
+	struct LodProjection
+	{
+		glm::vec4 depthRow;				// Row of view-projection giving clip w (view depth for perspective, constant for orthographic)
+		float depthRowLength;			// How fast w changes with distance, to reach nearest point of a bounding sphere
+		float allowedErrorScale;		// Error (world units) allowed at w = 1 (0 = always full detail)
+		float pixelsPerUnit;			// Pixels one world unit covers at w = 1 (also sizes textures are requested at)
+	};
 
 	// Scene Objects
-	std::vector<Mesh> meshList;
+	std::vector<Mesh> meshList;				// Indexed by mesh id (removed meshes leave a free slot)
+	std::vector<bool> meshActive;			// Slot holds a live mesh
+	std::vector<bool> meshVisible;			// Mesh is drawn
+	std::vector<int> freeMeshIds;
+	std::vector<std::vector<glm::mat4>> meshInstances;	// Instance transforms of each mesh (none = drawn once, untransformed)
+	std::vector<glm::mat4> meshTransforms;				// Transform of each mesh, applied on top of its instances' transforms
+	std::vector<uint32_t> meshMaterials;				// Material of each mesh (0 = default material)
+
+	// - Materials
+	std::vector<Material> materials;					// Material table, copied to a frame's material buffer when it changes
+	uint64_t materialsVersion = 0;						// Bumped whenever material table changes
+	std::vector<uint64_t> frameMaterialsVersion;		// Material table version each frame's material buffer holds
+	std::vector<VkBuffer> materialBuffers;				// Per frame in flight, read through bindless storage buffer array
+	std::vector<Allocation> materialBufferAllocations;
+	std::vector<uint32_t> materialBufferIndices;		// Bindless index of each frame's material buffer
+	std::vector<uint64_t> frameResidencyVersion;		// Texture residency version each frame's material buffer resolved textures at
+
+	// - Textures
+	TextureStreamer textureStreamer;					// Streams texture mips in and out within memory budget
+	VkDeviceSize textureUploadLimit = DEFAULT_TEXTURE_UPLOAD_LIMIT;	// Texel bytes streamed to textures per frame
+	bool memoryBudgetSupported = false;					// VK_EXT_memory_budget enabled, so texture budget follows what device reports
+
+	// A mesh to draw this frame, and where its instances are in the frame's instance buffer
+	struct DrawItem
+	{
+		uint32_t meshId;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		uint32_t drawGroup;				// Index type group (see DRAW_GROUP_INDEX_TYPES)
+		uint32_t lod;					// Level of detail all of the draw's instances use
+	};
+
+	// Draw list is sorted by group, so each group's draws are contiguous (and so are their indirect commands)
+	struct DrawGroups
+	{
+		uint32_t firstDraw[DRAW_GROUP_COUNT];
+		uint32_t drawCount[DRAW_GROUP_COUNT];
+	};
+
+	// Removed meshes wait until frames that may still use their buffers have finished
+	struct MeshDeletion
+	{
+		Mesh mesh;
+		uint64_t frameNumber;			// Frame the mesh was removed on
+	};
+	std::vector<MeshDeletion> pendingMeshDeletions;
+
+	// - Dirty Tracking
+	bool dirtyTracking = true;						// Reuse a frame's previous recording if nothing has changed
+	uint64_t sceneVersion = 0;						// Bumped whenever anything that affects recording changes
+	std::vector<uint64_t> recordedSceneVersion;		// Scene version each recording slot's command buffer was last recorded at
 
 	// Vulkan Components
 	// - Main
@@ -44,23 +195,64 @@ private:
 	} mainDevice;
 	VkQueue graphicsQueue;
 	VkQueue presentationQueue;
+	VkQueue transferQueue;
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapchain;
 
+	// - Memory
+	DeviceAllocator allocator;
+	UploadManager uploadManager;
+	GeometryPool geometryPool;			// Shared vertex/index buffers all meshes live in
+	UniformAllocator uniformAllocator;	// Per frame uniform data, bump allocated while recording
+	VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;	// Requested format of vertices on GPU
+	VertexLayoutInfo vertexLayout;						// Layout actually used (falls back to float if device can't read requested one)
+	bool meshOptimization = false;						// Reorder mesh triangles and vertices for vertex cache, overdraw and fetch when added
+
 	std::vector<SwapchainImage> swapchainImages;
+	std::vector<Allocation> offscreenImageAllocations;		// Memory of offscreen images used in place of swapchain images (headless only)
+	std::vector<VkImage> depthBufferImages;					// One per swapchain image, so frames in flight never share a depth buffer
+	std::vector<VkImageView> depthBufferImageViews;
+	std::vector<Allocation> depthBufferImageAllocations;
+	uint32_t lastRenderedImage = 0;
 	std::vector<VkFramebuffer> swapchainFramebuffers;
-	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VkCommandBuffer> commandBuffers;		// One per frame in flight and swapchain image (see GetRecordingSlot), re-recorded when needed
+
+	// - Descriptors
+	VkDescriptorSetLayout cullSetLayout;
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> cullDescriptorSets;	// Per frame in flight
+	VkDescriptorSetLayout uniformSetLayout;
+	VkDescriptorSet uniformDescriptorSet;				// Dynamic uniform buffer of uniform allocator (shared by all frames, picked by dynamic offset)
+	BindlessDescriptors bindlessDescriptors;			// Global set of every buffer and texture shaders reach by index (set 1)
 
 	// - Pipeline
-	VkPipeline graphicsPipeline;
+	// Pipelines in use are picked from pipeline compiler each frame, and are null until compiled
+	VkPipeline graphicsPipeline = VK_NULL_HANDLE;		// Colour pipeline (mesh draws are skipped while null)
 	VkPipelineLayout pipelineLayout;
 	VkRenderPass renderPass;
+	VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;	// Position only pipeline laying down depth before colour pass (null unless pre-pass enabled and ready)
+	bool depthPrepass = false;							// Draw scene depth first, so colour pass only shades the visible surface of each pixel
+	VkPipeline cullPipeline = VK_NULL_HANDLE;			// Frustum culling compute pipeline (null if cull shader couldn't be loaded or hasn't compiled)
+	VkPipelineLayout cullPipelineLayout;
+	PipelineCache pipelineCache;						// Compiled pipelines kept on disk between runs
+	std::string pipelineCachePath = DEFAULT_PIPELINE_CACHE_PATH;	// Empty to not load or save cache
+	PipelineCompiler pipelineCompiler;					// Compiles pipelines on worker threads into pipeline cache
+	PipelineHandle graphicsPipelineHandle = INVALID_PIPELINE_HANDLE;
+	PipelineHandle depthPrepassPipelineHandle = INVALID_PIPELINE_HANDLE;
+	PipelineHandle fallbackPipelineHandle = INVALID_PIPELINE_HANDLE;	// Plain colour pipeline, drawn alone until pre-pass pipelines are ready
+	PipelineHandle cullPipelineHandle = INVALID_PIPELINE_HANDLE;
+	bool asyncPipelines = true;							// Start drawing before pipelines have compiled (headless always waits)
+	bool pipelinesReady = false;						// Every submitted pipeline has finished compiling
+	std::chrono::steady_clock::time_point pipelineSubmitTime;
 
 	// - Pool
-	VkCommandPool graphicsCommandPool;
+	VkCommandPool graphicsCommandPool;					// Long lived/one off command buffers
+	std::vector<VkCommandPool> recordingCommandPools;	// Transient pool per recording slot, reset before re-recording
+	ParallelRecorder parallelRecorder;		// Worker threads recording mesh draws into secondary command buffers
 
 	// - Utility
 	VkFormat swapchainImageFormat;
+	VkFormat depthFormat;
 	VkExtent2D swapchainExtent;
 
 	// Synchronisation
@@ -69,21 +261,57 @@ private:
 	std::vector<VkFence> drawFences;
 
 	// Vulkan Functions
+	int InitVulkan();
+	void DrawHeadless(VkCommandBuffer textureUploadBuffer);
+
 	// - Create Functions
 	void CreateInstance();
 	void CreateDebugMessenger();
 	void CreateLogicalDevice();
+	void ChooseVertexLayout();
 	void CreateSurface();
 	void CreateSwapchain();
+	void CreateOffscreenImages();
+	void CreateDepthBufferImages();
 	void CreateRenderPass();
+	void CreateDescriptorSetLayout();
+	void CreatePipelineCache();
+	void CreatePipelineCompiler();
 	void CreateGraphicsPipeline();
+	void CreateComputePipeline();
 	void CreateFramebuffers();
 	void CreateCommandPool();
+	void CreateUploadManager();
+	void CreateGeometryPool();
+	void CreateIndirectBuffers();
+	void CreateInstanceBuffers();
+	void CreateUniformAllocator();
+	void CreateMaterialBuffers();
+	void CreateTextureStreamer();
+	void CreateDescriptorPool();
+	void CreateDescriptorSets();
 	void CreateCommandBuffers();
+	void CreateGpuProfiler();
+	void CreateParallelRecorder();
 	void CreateSynchronisation();
 
 	// - Record Functions
-	void RecordCommands();
+	void RecordCommands(uint32_t frame, uint32_t imageIndex);
+	std::vector<DrawItem> BuildDrawList(uint32_t frame, DrawGroups* drawGroups, bool bakeMeshTransforms);
+	LodProjection GetLodProjection();
+	uint32_t SelectLod(Mesh& mesh, const glm::mat4& transform, const LodProjection& projection);
+	float GetProjectedSize(Mesh& mesh, const glm::mat4& transform, const LodProjection& projection);
+	glm::vec4 GetDrawBoundingSphere(const DrawItem& drawItem);
+	void RecordCulling(VkCommandBuffer commandBuffer, uint32_t frame, const std::vector<DrawItem>& drawList, const DrawGroups& drawGroups);
+	void WriteIndirectCommands(uint32_t frame, const std::vector<DrawItem>& drawList, const DrawGroups& drawGroups);
+	void RecordIndirectDraws(VkCommandBuffer commandBuffer, uint32_t frame, const DrawGroups& drawGroups, VkPipeline pipeline, uint32_t frameUniformOffset);
+	uint32_t GetRecordingSlot(uint32_t frame, uint32_t imageIndex);
+	void UpdateCommandBuffer(uint32_t frame, uint32_t imageIndex);
+	bool UpdatePipelines();
+	void ProcessMeshDeletions(bool force);
+	void UpdateMaterialBuffer(uint32_t frame);
+	int CreateMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const MeshBounds* knownBounds);
+	int InsertMesh(const Mesh& mesh);
 
 	// - Debug Functions
 	VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger);
@@ -92,12 +320,15 @@ private:
 	// - Get Functions
 	void GetPhysicalDevice();
 	std::vector<const char*> GetRequiredExtensions();
+	std::vector<const char*> GetRequiredDeviceExtensions();
 
 	// - Support Functions
 	// -- Checker Functions
 	bool CheckInstanceExtensionSupport(std::vector<const char*>* checkExtensions);
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+	bool CheckDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
 	bool CheckDeviceSuitable(VkPhysicalDevice device);
+	bool CheckDescriptorIndexingSupport(VkPhysicalDevice device);
 	bool CheckValidationLayerSupport();
 
 	// -- Getter Functions
@@ -108,9 +339,11 @@ private:
 	VkSurfaceFormatKHR ChooseBestSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats);
 	VkPresentModeKHR ChooseBestPresentationMode(const std::vector<VkPresentModeKHR> presentationModes);
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
+	VkFormat ChooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags);
 
 	// -- Create Functions
+	VkImage CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags,
+		VkMemoryPropertyFlags propFlags, MemoryTag tag, Allocation* imageAllocation);
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	VkShaderModule CreateShaderModule(const std::vector<char>& code);
 };
 
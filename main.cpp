@@ -10,12 +10,328 @@
 #include <stdexcept>
 #include <vector>
 #include <string>
+#include <fstream>
 
 #include "VulkanRenderer.h"
+#include "Benchmark.h"
 
 GLFWwindow* window;
 VulkanRenderer vulkanRenderer;
 
+// Options taken from the command line
+struct AppOptions
+{
+	bool headless = false;			// --headless         : Render offscreen without a window (e.g. CI with a software ICD)
+	int frames = 1;					// --frames N         : Number of frames to render in headless mode
+	std::string outputFile;			// --output file.ppm  : Read back last headless frame and write it as a PPM image
+	uint32_t width = 800;			// --width W
+	uint32_t height = 600;			// --height H
+	int benchFrames = 0;			// --bench-frames N   : Measure N frames then exit, reporting timings as JSON
+	int warmupFrames = 0;			// --warmup M         : Frames to run before measuring starts
+	std::string benchOutputFile;	// --bench-output file: Write benchmark JSON to file instead of stdout
+	bool gpuProfile = false;		// --gpu-profile      : Log GPU scope timings and pipeline statistics
+	bool alwaysRecord = false;		// --always-record    : Re-record command buffers every frame, even if scene hasn't changed
+	bool noIndirect = false;		// --no-indirect      : Use a draw call per mesh instead of one indirect draw
+	bool noGpuCull = false;			// --no-gpu-cull      : Skip frustum culling compute pass (indirect draws written by CPU)
+	VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
+									// --vertex-format F  : Format vertices are stored in on GPU (float, half, snorm16)
+	std::vector<std::string> meshFiles;	// --mesh file.mesh   : Load a binary mesh file into the scene (can be repeated)
+	std::string pipelineCacheFile = DEFAULT_PIPELINE_CACHE_PATH;
+									// --pipeline-cache F : File compiled pipelines are kept in between runs
+									// --no-pipeline-cache: Compile every pipeline from scratch
+	bool optimizeMeshes = false;	// --optimize-meshes  : Reorder meshes for vertex cache, overdraw and fetch as they are added
+	bool noLod = false;				// --no-lod           : Don't generate simplified LODs, every mesh is drawn at full detail
+	float lodError = DEFAULT_LOD_ERROR_THRESHOLD;
+									// --lod-error P      : Pixels a LOD's error may cover on screen before a finer LOD is used
+	bool depthPrepass = false;		// --depth-prepass    : Draw scene depth first, so colour pass shades each pixel once
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+									// --present-mode M   : immediate, mailbox, fifo or fifo-relaxed (falls back to fifo)
+	double targetFrameTime = 0.0;	// --fps N            : Limit frame rate to N frames per second
+									// --frame-time MS    : Limit frame rate to one frame every MS milliseconds
+	double textureBudget = 0.0;		// --texture-budget MB: Most memory streamed textures may use (default: what device budget allows)
+	double textureUploadLimit = DEFAULT_TEXTURE_UPLOAD_LIMIT / 1024.0;
+									// --texture-upload KB: Texture data streamed to GPU per frame
+	bool memoryStats = false;		// --memory-stats     : Log device memory statistics at end of run
+	int memoryStatsInterval = 0;	// --memory-stats-interval N: Also log them every N frames (implies --memory-stats)
+	bool syncPipelines = false;		// --sync-pipelines   : Wait for every pipeline to compile at startup instead of drawing without them
+};
+
+const int GPU_PROFILE_LOG_INTERVAL = 120;	// Frames between GPU profiler log outputs
+
+bool ParsePresentMode(const std::string& name, VkPresentModeKHR* mode)
+{
+	if (name == "immediate")			{ *mode = VK_PRESENT_MODE_IMMEDIATE_KHR; }
+	else if (name == "mailbox")			{ *mode = VK_PRESENT_MODE_MAILBOX_KHR; }
+	else if (name == "fifo")			{ *mode = VK_PRESENT_MODE_FIFO_KHR; }
+	else if (name == "fifo-relaxed")	{ *mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR; }
+	else								{ return false; }
+
+	return true;
+}
+
+AppOptions ParseOptions(int argc, char** argv)
+{
+	AppOptions options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--headless")
+		{
+			options.headless = true;
+		}
+		else if (arg == "--frames" && hasValue)
+		{
+			options.frames = std::stoi(argv[++i]);
+		}
+		else if (arg == "--output" && hasValue)
+		{
+			options.outputFile = argv[++i];
+		}
+		else if (arg == "--width" && hasValue)
+		{
+			options.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--height" && hasValue)
+		{
+			options.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--bench-frames" && hasValue)
+		{
+			options.benchFrames = std::stoi(argv[++i]);
+		}
+		else if (arg == "--warmup" && hasValue)
+		{
+			options.warmupFrames = std::stoi(argv[++i]);
+		}
+		else if (arg == "--bench-output" && hasValue)
+		{
+			options.benchOutputFile = argv[++i];
+		}
+		else if (arg == "--gpu-profile")
+		{
+			options.gpuProfile = true;
+		}
+		else if (arg == "--always-record")
+		{
+			options.alwaysRecord = true;
+		}
+		else if (arg == "--no-indirect")
+		{
+			options.noIndirect = true;
+		}
+		else if (arg == "--no-gpu-cull")
+		{
+			options.noGpuCull = true;
+		}
+		else if (arg == "--vertex-format" && hasValue)
+		{
+			std::string name = argv[++i];
+			if (!ParseVertexFormat(name, &options.vertexFormat))
+			{
+				std::cerr << "Unknown vertex format: " << name << std::endl;
+			}
+		}
+		else if (arg == "--mesh" && hasValue)
+		{
+			options.meshFiles.push_back(argv[++i]);
+		}
+		else if (arg == "--pipeline-cache" && hasValue)
+		{
+			options.pipelineCacheFile = argv[++i];
+		}
+		else if (arg == "--no-pipeline-cache")
+		{
+			options.pipelineCacheFile.clear();
+		}
+		else if (arg == "--optimize-meshes")
+		{
+			options.optimizeMeshes = true;
+		}
+		else if (arg == "--no-lod")
+		{
+			options.noLod = true;
+		}
+		else if (arg == "--lod-error" && hasValue)
+		{
+			options.lodError = std::stof(argv[++i]);
+		}
+		else if (arg == "--depth-prepass")
+		{
+			options.depthPrepass = true;
+		}
+		else if (arg == "--present-mode" && hasValue)
+		{
+			std::string name = argv[++i];
+			if (!ParsePresentMode(name, &options.presentMode))
+			{
+				std::cerr << "Unknown present mode: " << name << std::endl;
+			}
+		}
+		else if (arg == "--fps" && hasValue)
+		{
+			double fps = std::stod(argv[++i]);
+			options.targetFrameTime = fps > 0.0 ? 1000.0 / fps : 0.0;
+		}
+		else if (arg == "--frame-time" && hasValue)
+		{
+			options.targetFrameTime = std::stod(argv[++i]);
+		}
+		else if (arg == "--texture-budget" && hasValue)
+		{
+			options.textureBudget = std::stod(argv[++i]);
+		}
+		else if (arg == "--texture-upload" && hasValue)
+		{
+			options.textureUploadLimit = std::stod(argv[++i]);
+		}
+		else if (arg == "--memory-stats")
+		{
+			options.memoryStats = true;
+		}
+		else if (arg == "--memory-stats-interval" && hasValue)
+		{
+			options.memoryStatsInterval = std::stoi(argv[++i]);
+			options.memoryStats = true;
+		}
+		else if (arg == "--sync-pipelines")
+		{
+			options.syncPipelines = true;
+		}
+		else
+		{
+			std::cerr << "Unknown option: " << arg << std::endl;
+		}
+	}
+
+	return options;
+}
+
+bool WritePPM(const std::string& filename, const std::vector<uint8_t>& rgbaPixels, uint32_t width, uint32_t height)
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	// Binary PPM header, then RGB data (alpha dropped)
+	file << "P6\n" << width << " " << height << "\n255\n";
+	for (size_t i = 0; i < rgbaPixels.size(); i += 4)
+	{
+		file.write(reinterpret_cast<const char*>(&rgbaPixels[i]), 3);
+	}
+
+	return true;
+}
+
+bool ReportBenchmark(const AppOptions& options, Benchmark& benchmark)
+{
+	std::string json = benchmark.ToJson(vulkanRenderer.GetDeviceProperties());
+
+	if (options.benchOutputFile.empty())
+	{
+		std::cout << json;
+		return true;
+	}
+
+	std::ofstream file(options.benchOutputFile);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to write " << options.benchOutputFile << std::endl;
+		return false;
+	}
+	file << json;
+
+	return true;
+}
+
+bool LoadMeshes(const AppOptions& options)
+{
+	for (const auto& meshFile : options.meshFiles)
+	{
+		try
+		{
+			vulkanRenderer.LoadMesh(meshFile);
+		}
+		catch (const std::runtime_error& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int RunHeadless(const AppOptions& options)
+{
+	// Create Vulkan Renderer instance without a window
+	if (vulkanRenderer.InitHeadless(options.width, options.height) == EXIT_FAILURE)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if (!LoadMeshes(options))
+	{
+		vulkanRenderer.Cleanup();
+		return EXIT_FAILURE;
+	}
+
+	// In benchmark mode, run exactly as many frames as needed for the measurement
+	Benchmark benchmark;
+	benchmark.Init(options.benchFrames, options.warmupFrames);
+	int frameCount = options.benchFrames > 0 ? options.benchFrames + options.warmupFrames : options.frames;
+
+	for (int i = 0; i < frameCount; i++)
+	{
+		if (vulkanRenderer.Draw() == EXIT_FAILURE)
+		{
+			vulkanRenderer.Cleanup();
+			return EXIT_FAILURE;
+		}
+		benchmark.AddFrame(vulkanRenderer.GetLastFrameTimings());
+
+		if (options.memoryStatsInterval > 0 && (i + 1) % options.memoryStatsInterval == 0)
+		{
+			vulkanRenderer.LogMemoryStatistics();
+		}
+	}
+
+	if (options.gpuProfile)
+	{
+		vulkanRenderer.GetGpuProfiler().LogResults();
+	}
+
+	if (options.memoryStats)
+	{
+		vulkanRenderer.LogMemoryStatistics();
+	}
+
+	int exitCode = 0;
+	if (options.benchFrames > 0 && !ReportBenchmark(options, benchmark))
+	{
+		exitCode = EXIT_FAILURE;
+	}
+
+	if (!options.outputFile.empty())
+	{
+		std::vector<uint8_t> pixels;
+		VkExtent2D extent = vulkanRenderer.GetRenderExtent();
+		if (!vulkanRenderer.ReadbackImage(pixels) || !WritePPM(options.outputFile, pixels, extent.width, extent.height))
+		{
+			std::cerr << "Failed to write " << options.outputFile << std::endl;
+			exitCode = EXIT_FAILURE;
+		}
+	}
+
+	vulkanRenderer.Cleanup();
+
+	return exitCode;
+}
+
 void InitWindow(std::string wName = "Vulkan", const int width = 800, const int height = 600)
 {
 	// Initialise GLFW
@@ -28,10 +344,31 @@ void InitWindow(std::string wName = "Vulkan", const int width = 800, const int h
 	window = glfwCreateWindow(width, height, wName.c_str(), nullptr, nullptr);
 }
 
-int main()
+int main(int argc, char** argv)
 {
+	AppOptions options = ParseOptions(argc, argv);
+	vulkanRenderer.SetDirtyTracking(!options.alwaysRecord);
+	vulkanRenderer.SetIndirectDraw(!options.noIndirect);
+	vulkanRenderer.SetGpuCulling(!options.noGpuCull);
+	vulkanRenderer.SetPipelineCachePath(options.pipelineCacheFile);
+	vulkanRenderer.SetVertexFormat(options.vertexFormat);
+	vulkanRenderer.SetMeshOptimization(options.optimizeMeshes);
+	vulkanRenderer.SetLodGeneration(!options.noLod);
+	vulkanRenderer.SetLodErrorThreshold(options.lodError);
+	vulkanRenderer.SetDepthPrepass(options.depthPrepass);
+	vulkanRenderer.SetPresentMode(options.presentMode);
+	vulkanRenderer.SetFrameLimit(options.targetFrameTime);
+	vulkanRenderer.SetAsyncPipelines(!options.syncPipelines);
+	vulkanRenderer.SetTextureBudget(static_cast<VkDeviceSize>(options.textureBudget * 1024.0 * 1024.0));
+	vulkanRenderer.SetTextureUploadLimit(static_cast<VkDeviceSize>(options.textureUploadLimit * 1024.0));
+
+	if (options.headless)
+	{
+		return RunHeadless(options);
+	}
+
 	// Create Window
-	InitWindow("Vulkan", 800, 600);
+	InitWindow("Vulkan", options.width, options.height);
 
 	// Create Vulkan Renderer instance
 	if (vulkanRenderer.Init(window) == EXIT_FAILURE)
@@ -39,11 +376,72 @@ int main()
 		return EXIT_FAILURE;
 	}
 
-	// Loop until closed
+	if (!LoadMeshes(options))
+	{
+		vulkanRenderer.Cleanup();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return EXIT_FAILURE;
+	}
+
+	Benchmark benchmark;
+	benchmark.Init(options.benchFrames, options.warmupFrames);
+	bool benchmarking = options.benchFrames > 0;
+
+	int frameNumber = 0;
+
+	// Loop until closed (or benchmark has all its frames)
 	while (!glfwWindowShouldClose(window))
 	{
 		glfwPollEvents();
-		vulkanRenderer.Draw();
+
+		// Stops if a pipeline still compiling when Init returned has failed
+		if (vulkanRenderer.Draw() == EXIT_FAILURE)
+		{
+			vulkanRenderer.Cleanup();
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return EXIT_FAILURE;
+		}
+
+		frameNumber++;
+		if (options.gpuProfile && frameNumber % GPU_PROFILE_LOG_INTERVAL == 0)
+		{
+			vulkanRenderer.GetGpuProfiler().LogResults();
+		}
+
+		if (options.memoryStatsInterval > 0 && frameNumber % options.memoryStatsInterval == 0)
+		{
+			vulkanRenderer.LogMemoryStatistics();
+		}
+
+		if (benchmarking)
+		{
+			benchmark.AddFrame(vulkanRenderer.GetLastFrameTimings());
+			if (benchmark.IsComplete())
+			{
+				break;
+			}
+		}
+	}
+
+	int exitCode = 0;
+	if (benchmarking && !ReportBenchmark(options, benchmark))
+	{
+		exitCode = EXIT_FAILURE;
+	}
+
+	// How evenly frames were delivered over the whole run (benchmark JSON already reports it)
+	if (!benchmarking)
+	{
+		FramePacingStatistics pacing = vulkanRenderer.GetFramePacingStatistics();
+		printf("Frame pacing: %llu frames, target %.3f ms, mean interval %.3f ms, jitter %.3f ms, worst deviation %.3f ms\n",
+			static_cast<unsigned long long>(pacing.frameCount), pacing.targetFrameTime, pacing.meanFrameInterval, pacing.jitter, pacing.worstDeviation);
+	}
+
+	if (options.memoryStats)
+	{
+		vulkanRenderer.LogMemoryStatistics();
 	}
 
 	vulkanRenderer.Cleanup();
@@ -52,5 +450,5 @@ int main()
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
-	return 0;
+	return exitCode;
 }
\ No newline at end of file